@@ -0,0 +1,127 @@
+/*
+ * Bump allocator used by HashMap to own its links and key strings.
+ */
+
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+/**
+ * Initializes an empty arena. No memory is reserved until the first
+ * allocation.
+ * @param arena
+ */
+void arenaInit(Arena* arena)
+{
+    assert(arena != NULL);
+    arena->blocks = NULL;
+    arena->cursor = NULL;
+    arena->end = NULL;
+    arena->reserved = 0;
+}
+
+/**
+ * Frees every block owned by the arena and resets it to empty.
+ * @param arena
+ */
+void arenaCleanUp(Arena* arena)
+{
+    assert(arena != NULL);
+    while (arena->blocks != NULL) {
+        ArenaBlock* delMe = arena->blocks;
+        arena->blocks = delMe->next;
+        free(delMe);
+    }
+    arenaInit(arena);
+}
+
+/**
+ * Returns memory for size bytes aligned to align, starting a new block when
+ * the current one is full. Requests bigger than a block get a block of their
+ * own.
+ * @param arena
+ * @param size Number of bytes.
+ * @param align Alignment, a power of two.
+ * @return Pointer into the arena, valid until arenaCleanUp.
+ */
+void* arenaAlloc(Arena* arena, size_t size, size_t align)
+{
+    assert(arena != NULL && (align & (align - 1)) == 0);
+
+    uintptr_t p = ((uintptr_t) arena->cursor + (align - 1)) & ~(uintptr_t) (align - 1);
+    if (arena->cursor == NULL || p + size > (uintptr_t) arena->end) {
+        // header is padded so the block body is aligned for any type
+        size_t header = (sizeof(ArenaBlock) + 15) & ~(size_t) 15;
+        size_t body = size + align > ARENA_BLOCK_SIZE ? size + align : ARENA_BLOCK_SIZE;
+        ArenaBlock* block = malloc(header + body);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        block->size = header + body;
+        arena->blocks = block;
+        arena->reserved += block->size;
+        arena->cursor = (char*) block + header;
+        arena->end = arena->cursor + body;
+        p = ((uintptr_t) arena->cursor + (align - 1)) & ~(uintptr_t) (align - 1);
+    }
+    arena->cursor = (char*) (p + size);
+    return (void*) p;
+}
+
+/**
+ * Copies length bytes of str into the arena and null terminates the copy.
+ * @param arena
+ * @param str
+ * @param length Number of characters to copy.
+ * @return Arena-owned copy of the string.
+ */
+char* arenaStrdup(Arena* arena, const char* str, size_t length)
+{
+    char* copy = arenaAlloc(arena, length + 1, 1);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/**
+ * Moves every block of other into arena, which then owns and frees them;
+ * other is left empty. Lets threads fill arenas of their own and hand the
+ * results to one owner. The blocks go behind arena's current block, so
+ * arena keeps allocating where it left off.
+ * @param arena
+ * @param other
+ */
+void arenaAdopt(Arena* arena, Arena* other)
+{
+    assert(arena != NULL && other != NULL && arena != other);
+    if (other->blocks == NULL) {
+        return;
+    }
+    if (arena->blocks == NULL) {
+        *arena = *other;
+        arenaInit(other);
+        return;
+    }
+    ArenaBlock* last = other->blocks;
+    while (last->next != NULL) {
+        last = last->next;
+    }
+    last->next = arena->blocks->next;
+    arena->blocks->next = other->blocks;
+    arena->reserved += other->reserved;
+    arenaInit(other);
+}
+
+/**
+ * Returns the number of bytes the arena has taken from malloc.
+ * @param arena
+ * @return Reserved bytes.
+ */
+size_t arenaReserved(Arena* arena)
+{
+    assert(arena != NULL);
+    return arena->reserved;
+}
@@ -0,0 +1,41 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+/*
+ * Bump allocator used by HashMap to own its links and key strings.
+ * Allocations are carved out of large blocks and are only released all at
+ * once, when the arena is cleaned up.
+ */
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct Arena Arena;
+typedef struct ArenaBlock ArenaBlock;
+
+struct ArenaBlock
+{
+    ArenaBlock* next;
+    size_t size;
+};
+
+struct Arena
+{
+    // Most recently allocated block; older blocks follow through next.
+    ArenaBlock* blocks;
+    // Bump pointer and end of the free space in the current block.
+    char* cursor;
+    char* end;
+    // Total bytes requested from malloc for blocks.
+    size_t reserved;
+};
+
+void arenaInit(Arena* arena);
+void arenaCleanUp(Arena* arena);
+void* arenaAlloc(Arena* arena, size_t size, size_t align);
+char* arenaStrdup(Arena* arena, const char* str, size_t length);
+void arenaAdopt(Arena* arena, Arena* other);
+size_t arenaReserved(Arena* arena);
+
+#endif
@@ -0,0 +1,885 @@
+/*
+ * Benchmark suite with machine-readable output.
+ *
+ * Usage: benchSuite [--dictionary path] [--hashes 1,2,3,4]
+ *                   [--backends dp,myers,simd,symspell,dawg,bktree,bktree+radius2]
+ *                   [--structures frozen,dawg,concurrent] [--queries N] [--lookups N] [--repeat N]
+ *                   [--seed N] [--load-threads N] [--readers N] [--suggestions N] [--out path]
+ *
+ * Runs each workload once per hash function, distance backend or dictionary
+ * structure and writes one JSON document:
+ *   load      loadDictionary into a fresh map, repeated; median time. Run
+ *             again with loadDictionaryParallel on --load-threads threads
+ *             (default one per CPU) as variant <hash>+parallel<N>
+ *   lookupHit hashMapContainsKey on dictionary words in random order; with
+ *             --structures, also on the frozen map and the DAWG
+ *   lookupMiss the same words with a letter appended
+ *   insert    hashMapPut of every word into a map that starts small and
+ *             resizes, all at once and as variant <hash>+incremental
+ *   suggest   --suggestions closest words (default 5) for a corpus of
+ *             misspellings generated from the dictionary with 1 or 2 random
+ *             edits, reproducible from the seed. bktree searches the BK-tree
+ *             with no distance limit and bktree+radius2 only within
+ *             distance 2; their nodesVisited is the mean number of words
+ *             scored per query, against the dictionary size for a full scan
+ *   concurrentLookup  --lookups dictionary words looked up by each of
+ *             --readers threads (default 4) while one more thread keeps
+ *             adding and removing words, on a HashMap behind a mutex and on
+ *             the concurrent map
+ *
+ * Each result has throughput, latency percentiles (timed per operation in a
+ * separate pass, so timer overhead does not skew throughput), allocations
+ * per operation and the process's peak RSS so far. Lookup results also give
+ * the structure's bytes per word. Allocations are counted by wrapping malloc
+ * and friends, which needs glibc; elsewhere they are null.
+ *
+ * hashFunction1 and hashFunction2 spread the full dictionary over so few home
+ * slots that probe runs grow to thousands of slots and a single load takes
+ * minutes, so they are not in the default set. Compare them on a smaller
+ * dictionary, e.g. head -20000 dictionary.txt.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "hashMap.h"
+#include "dictionary.h"
+#include "distance.h"
+#include "candidateStore.h"
+#include "symSpell.h"
+#include "dawg.h"
+#include "searchPool.h"
+#include "bkTree.h"
+#include "frozenMap.h"
+#include "concurrentMap.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define SUITE_QUERIES 200
+#define SUITE_LOOKUPS 1000000
+#define SUITE_REPEAT 5
+#define SUITE_SEED 20200307
+#define SUITE_READERS 4
+// Distance limit of the bktree+radius2 backend.
+#define SUITE_BKTREE_RADIUS 2
+
+typedef struct NamedHash NamedHash;
+typedef struct Latencies Latencies;
+typedef struct Suite Suite;
+typedef struct LookupTarget LookupTarget;
+typedef struct ConcurrentBench ConcurrentBench;
+typedef struct SuggestBackend SuggestBackend;
+
+struct NamedHash
+{
+    const char* name;
+    HashFunction function;
+};
+
+static const NamedHash hashFunctions[] = {
+    { "hashFunction1", hashFunction1 },
+    { "hashFunction2", hashFunction2 },
+    { "hashFunction3", hashFunction3 },
+    { "hashFunction4", hashFunction4 }
+};
+
+static const char* backendNames[] = { "dp", "myers", "simd", "symspell", "dawg", "bktree", "bktree+radius2" };
+
+/*
+ * Per-operation times of one workload, in nanoseconds.
+ */
+struct Latencies
+{
+    long long* samples;
+    int count;
+};
+
+/*
+ * Words and settings shared by every workload, and where results go.
+ */
+struct Suite
+{
+    const char* dictionaryPath;
+    // Dictionary words in a shuffled order, and the same words with "q" appended.
+    char** words;
+    char** misses;
+    int wordCount;
+    CandidateStore* store;
+    // Misspellings for the suggest workload.
+    char** queries;
+    int queryCount;
+    int lookupCount;
+    int repeat;
+    // Threads for the parallel load.
+    int loadThreads;
+    // Lookup threads in the concurrent workload.
+    int readers;
+    // Words kept per suggest query.
+    int suggestionCount;
+    unsigned long long seed;
+    FILE* out;
+    int resultCount;
+};
+
+/*
+ * A dictionary the lookup workloads run against: a hash map, a frozen map or
+ * a DAWG, whichever is set, and its size in memory.
+ */
+struct LookupTarget
+{
+    const char* name;
+    HashMap* map;
+    FrozenMap* frozen;
+    Dawg* dawg;
+    size_t bytes;
+};
+
+/*
+ * One suggest backend, set up by benchSuggestions: the scan kernel and
+ * whichever index answers ahead of the scan.
+ */
+struct SuggestBackend
+{
+    DistanceBackend kernel;
+    SymSpellIndex* symSpell;
+    Dawg* dawg;
+    BkTree* tree;
+    // Largest distance the tree search reports.
+    int maxDistance;
+};
+
+/*
+ * Shared state of one concurrentLookup run. Lookups and writes go to
+ * concurrent when it is set, otherwise to map with lock held.
+ */
+struct ConcurrentBench
+{
+    Suite* suite;
+    HashMap* map;
+    pthread_mutex_t lock;
+    ConcurrentMap* concurrent;
+    atomic_int readersLeft;
+    atomic_long found;
+};
+
+#ifdef __GLIBC__
+// Count every allocation by wrapping glibc's allocator, which calls made from
+// inside libc (strdup, fopen) go through as well.
+#define SUITE_COUNTS_ALLOCATIONS 1
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* pointer, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* pointer);
+
+static atomic_long allocationCount;
+
+void* malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size)
+{
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    void* memory = __libc_memalign(alignment, size);
+    if (memory == NULL) {
+        return ENOMEM;
+    }
+    *pointer = memory;
+    return 0;
+}
+
+void free(void* pointer)
+{
+    __libc_free(pointer);
+}
+
+static long allocations(void)
+{
+    return atomic_load_explicit(&allocationCount, memory_order_relaxed);
+}
+#else
+#define SUITE_COUNTS_ALLOCATIONS 0
+
+static long allocations(void)
+{
+    return 0;
+}
+#endif
+
+/**
+ * Returns the current time in nanoseconds.
+ */
+static long long nowNanos(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Returns the next number of a 64-bit xorshift sequence.
+ */
+static unsigned long long nextRandom(unsigned long long* state)
+{
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * Orders latencies, for qsort.
+ */
+static int compareLatencies(const void* a, const void* b)
+{
+    long long x = *(const long long*) a;
+    long long y = *(const long long*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Returns the process's peak resident set size so far, in kilobytes.
+ */
+static long peakRssKb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * Writes one result object. latencies may be NULL for workloads that are only
+ * timed as a whole.
+ * @param suite
+ * @param workload
+ * @param variant Hash function or backend name.
+ * @param ops Operations in the timed run.
+ * @param seconds Duration of the timed run.
+ * @param allocated Allocations made during the timed run.
+ * @param latencies
+ * @param bytesPerWord Memory of the structure under test per word, or
+ * negative for workloads that do not measure one.
+ * @param nodesVisited Mean words scored per suggest query, or negative when
+ * the backend does not count them.
+ */
+static void writeResult(Suite* suite, const char* workload, const char* variant, long ops, double seconds,
+                        long allocated, Latencies* latencies, double bytesPerWord, double nodesVisited)
+{
+    FILE* out = suite->out;
+    fprintf(out, "%s\n    {\"workload\": \"%s\", \"variant\": \"%s\", \"ops\": %ld, \"seconds\": %.6f, "
+            "\"opsPerSecond\": %.1f, ", (suite->resultCount++ > 0) ? "," : "", workload, variant, ops, seconds,
+            ops / seconds);
+    if (latencies != NULL) {
+        long long* s = latencies->samples;
+        int n = latencies->count;
+        qsort(s, n, sizeof(long long), compareLatencies);
+        fprintf(out, "\"latencyNs\": {\"p50\": %lld, \"p99\": %lld, \"p999\": %lld, \"max\": %lld}, ",
+                s[n / 2], s[(int) (n * 0.99)], s[(int) (n * 0.999)], s[n - 1]);
+    }
+    else {
+        fprintf(out, "\"latencyNs\": null, ");
+    }
+    if (SUITE_COUNTS_ALLOCATIONS) {
+        fprintf(out, "\"allocsPerOp\": %.4f, ", (double) allocated / ops);
+    }
+    else {
+        fprintf(out, "\"allocsPerOp\": null, ");
+    }
+    if (bytesPerWord >= 0) {
+        fprintf(out, "\"bytesPerWord\": %.1f, ", bytesPerWord);
+    }
+    else {
+        fprintf(out, "\"bytesPerWord\": null, ");
+    }
+    if (nodesVisited >= 0) {
+        fprintf(out, "\"nodesVisited\": %.1f, ", nodesVisited);
+    }
+    else {
+        fprintf(out, "\"nodesVisited\": null, ");
+    }
+    fprintf(out, "\"peakRssKb\": %ld}", peakRssKb());
+    fflush(out);
+    fprintf(stderr, "%-10s %-14s %12.0f ops/s\n", workload, variant, ops / seconds);
+}
+
+/**
+ * Times loading the dictionary into a fresh map, suite->repeat times, and
+ * reports the median load: loadDictionary when threadCount is 0, otherwise
+ * loadDictionaryParallel on threadCount threads.
+ */
+static void benchLoad(Suite* suite, const NamedHash* hash, int threadCount)
+{
+    double* times = malloc(sizeof(double) * suite->repeat);
+    long allocated = 0;
+    int size = 0;
+    for (int r = 0; r < suite->repeat; r++) {
+        long before = allocations();
+        long long start = nowNanos();
+        HashMap* map = hashMapNewWithHash(1000, hash->function);
+        if (threadCount > 0) {
+            loadDictionaryParallel(suite->dictionaryPath, map, threadCount);
+        }
+        else {
+            FILE* file = fopen(suite->dictionaryPath, "r");
+            loadDictionary(file, map);
+            fclose(file);
+        }
+        times[r] = (nowNanos() - start) / 1e9;
+        allocated = allocations() - before;
+        size = hashMapSize(map);
+        hashMapDelete(map);
+    }
+    // insertion sort; repeat is small
+    for (int i = 1; i < suite->repeat; i++) {
+        for (int j = i; j > 0 && times[j] < times[j - 1]; j--) {
+            double t = times[j];
+            times[j] = times[j - 1];
+            times[j - 1] = t;
+        }
+    }
+    char variant[64];
+    if (threadCount > 0) {
+        snprintf(variant, sizeof(variant), "%s+parallel%d", hash->name, threadCount);
+    }
+    else {
+        snprintf(variant, sizeof(variant), "%s", hash->name);
+    }
+    writeResult(suite, "load", variant, size, times[suite->repeat / 2], allocated, NULL, -1, -1);
+    free(times);
+}
+
+/**
+ * Looks a word up in whichever structure the target holds.
+ * @return 1 if the word is found, 0 otherwise.
+ */
+static int targetContainsKey(LookupTarget* target, const char* word)
+{
+    if (target->frozen != NULL) {
+        return frozenMapContainsKey(target->frozen, word);
+    }
+    if (target->dawg != NULL) {
+        return dawgContainsKey(target->dawg, word);
+    }
+    return hashMapContainsKey(target->map, word);
+}
+
+/**
+ * Times lookupCount lookups in the target of words picked at random from
+ * probes, untimed per call for throughput and then timed per call.
+ */
+static void benchLookups(Suite* suite, LookupTarget* target, char** probes, const char* workload)
+{
+    unsigned long long state = suite->seed;
+    long found = 0;
+    long before = allocations();
+    long long start = nowNanos();
+    for (int i = 0; i < suite->lookupCount; i++) {
+        found += targetContainsKey(target, probes[nextRandom(&state) % suite->wordCount]);
+    }
+    double seconds = (nowNanos() - start) / 1e9;
+    long allocated = allocations() - before;
+
+    Latencies latencies;
+    latencies.count = suite->lookupCount;
+    latencies.samples = malloc(sizeof(long long) * latencies.count);
+    state = suite->seed;
+    for (int i = 0; i < suite->lookupCount; i++) {
+        const char* word = probes[nextRandom(&state) % suite->wordCount];
+        long long t = nowNanos();
+        found += targetContainsKey(target, word);
+        latencies.samples[i] = nowNanos() - t;
+    }
+    writeResult(suite, workload, target->name, suite->lookupCount, seconds, allocated, &latencies,
+                (double) target->bytes / suite->wordCount, -1);
+    free(latencies.samples);
+    // keep the lookups from being optimized out
+    if (found < 0) {
+        printf("%ld\n", found);
+    }
+}
+
+/**
+ * Times hashMapPut of every word into a map that starts at the default
+ * capacity, so the run includes every resize, untimed per call for
+ * throughput and then timed per call. The tail latencies show what a
+ * resize costs the put that triggers it in the given mode.
+ */
+static void benchInserts(Suite* suite, const NamedHash* hash, HashResizeMode mode)
+{
+    long before = allocations();
+    long long start = nowNanos();
+    HashMap* map = hashMapNewWithHash(1000, hash->function);
+    hashMapSetResizeMode(map, mode);
+    for (int i = 0; i < suite->wordCount; i++) {
+        hashMapPut(map, suite->words[i], -1);
+    }
+    double seconds = (nowNanos() - start) / 1e9;
+    long allocated = allocations() - before;
+    hashMapDelete(map);
+
+    Latencies latencies;
+    latencies.count = suite->wordCount;
+    latencies.samples = malloc(sizeof(long long) * latencies.count);
+    map = hashMapNewWithHash(1000, hash->function);
+    hashMapSetResizeMode(map, mode);
+    for (int i = 0; i < suite->wordCount; i++) {
+        long long t = nowNanos();
+        hashMapPut(map, suite->words[i], -1);
+        latencies.samples[i] = nowNanos() - t;
+    }
+    hashMapDelete(map);
+    char variant[64];
+    snprintf(variant, sizeof(variant), (mode == HASH_RESIZE_INCREMENTAL) ? "%s+incremental" : "%s", hash->name);
+    writeResult(suite, "insert", variant, suite->wordCount, seconds, allocated, &latencies, -1, -1);
+    free(latencies.samples);
+}
+
+/**
+ * Fills suite->queries with misspellings: dictionary words with 1 or 2 random
+ * substitutions, insertions, deletions or transpositions.
+ */
+static void generateQueries(Suite* suite)
+{
+    unsigned long long state = suite->seed ^ 0x5bd1e995ULL;
+    suite->queries = malloc(sizeof(char*) * suite->queryCount);
+    for (int q = 0; q < suite->queryCount; q++) {
+        const char* source = suite->words[nextRandom(&state) % suite->wordCount];
+        char word[DISTANCE_MAX_WORD + 3];
+        int length = strlen(source);
+        if (length > DISTANCE_MAX_WORD) {
+            length = DISTANCE_MAX_WORD;
+        }
+        memcpy(word, source, length);
+        int edits = 1 + (int) (nextRandom(&state) % 2);
+        for (int e = 0; e < edits; e++) {
+            int at = (int) (nextRandom(&state) % length);
+            char letter = (char) ('a' + nextRandom(&state) % 26);
+            switch (nextRandom(&state) % 4) {
+            case 0:
+                word[at] = letter;
+                break;
+            case 1:
+                if (length < DISTANCE_MAX_WORD) {
+                    memmove(word + at + 1, word + at, length - at);
+                    word[at] = letter;
+                    length++;
+                }
+                break;
+            case 2:
+                if (length > 1) {
+                    memmove(word + at, word + at + 1, length - at - 1);
+                    length--;
+                }
+                break;
+            default:
+                if (at + 1 < length) {
+                    char c = word[at];
+                    word[at] = word[at + 1];
+                    word[at + 1] = c;
+                }
+                break;
+            }
+        }
+        word[length] = '\0';
+        suite->queries[q] = malloc(length + 1);
+        memcpy(suite->queries[q], word, length + 1);
+    }
+}
+
+/**
+ * Finds the suggestions for one word the way the backend does.
+ * @return Words scored: the BK-tree nodes visited, or every word for a full
+ * scan. -1 for the deletion index and the DAWG, which do not count theirs.
+ */
+static int suggestWord(Suite* suite, SuggestBackend* backend, const char* word)
+{
+    int length = strlen(word);
+    TopK table;
+    topKInit(&table, suite->suggestionCount);
+    DistanceQuery query;
+    distanceQueryInit(&query, backend->kernel, word, length);
+    int answered = (backend->symSpell != NULL && symSpellSearch(backend->symSpell, suite->store, &query, &table)) ||
+                   (backend->dawg != NULL && dawgSuggest(backend->dawg, word, length, DAWG_DEFAULT_DISTANCE, &table));
+    if (backend->tree != NULL) {
+        return bkTreeQuery(backend->tree, &query, backend->maxDistance, &table);
+    }
+    if (backend->symSpell != NULL || backend->dawg != NULL) {
+        if (!answered) {
+            candidateStoreScan(suite->store, &query, &table);
+        }
+        return -1;
+    }
+    candidateStoreScan(suite->store, &query, &table);
+    return suite->store->size;
+}
+
+/**
+ * Times suggestions for every generated misspelling with one backend: a full
+ * candidate store scan with the dp, myers or simd kernel, the deletion index
+ * or the DAWG answering what they can and the SIMD scan the rest, as in
+ * spellChecker, or a BK-tree search with no distance limit or within
+ * SUITE_BKTREE_RADIUS. Index build time is not included. The queries run
+ * untimed per call for throughput and then timed per call.
+ */
+static void benchSuggestions(Suite* suite, const char* name)
+{
+    SuggestBackend backend = { .kernel = DISTANCE_SIMD };
+    if (strcmp(name, "dp") == 0) {
+        backend.kernel = DISTANCE_DP;
+    }
+    else if (strcmp(name, "myers") == 0) {
+        backend.kernel = DISTANCE_MYERS;
+    }
+    else if (strcmp(name, "symspell") == 0) {
+        backend.symSpell = symSpellBuild(suite->store, SYMSPELL_DEFAULT_DISTANCE, SYMSPELL_DEFAULT_MAX_BYTES, 1);
+    }
+    else if (strcmp(name, "dawg") == 0) {
+        backend.dawg = dawgBuild(suite->store);
+    }
+    else if (strncmp(name, "bktree", 6) == 0) {
+        backend.tree = bkTreeBuild(suite->store);
+        backend.maxDistance = (strcmp(name, "bktree") == 0) ? DISTANCE_MAX_WORD : SUITE_BKTREE_RADIUS;
+    }
+
+    long visited = 0;
+    long before = allocations();
+    long long start = nowNanos();
+    for (int q = 0; q < suite->queryCount; q++) {
+        int scored = suggestWord(suite, &backend, suite->queries[q]);
+        // stays -1 for backends that do not count
+        visited = (scored < 0 || visited < 0) ? -1 : visited + scored;
+    }
+    double seconds = (nowNanos() - start) / 1e9;
+    long allocated = allocations() - before;
+
+    Latencies latencies;
+    latencies.count = suite->queryCount;
+    latencies.samples = malloc(sizeof(long long) * latencies.count);
+    for (int q = 0; q < suite->queryCount; q++) {
+        long long t = nowNanos();
+        suggestWord(suite, &backend, suite->queries[q]);
+        latencies.samples[q] = nowNanos() - t;
+    }
+    writeResult(suite, "suggest", name, suite->queryCount, seconds, allocated, &latencies, -1,
+                visited >= 0 ? (double) visited / suite->queryCount : -1);
+    free(latencies.samples);
+    bkTreeDelete(backend.tree);
+    dawgDelete(backend.dawg);
+    symSpellDelete(backend.symSpell);
+}
+
+/**
+ * Reader thread of the concurrentLookup workload: looks up lookupCount
+ * dictionary words picked at random.
+ */
+static void* concurrentReader(void* arg)
+{
+    ConcurrentBench* bench = arg;
+    Suite* suite = bench->suite;
+    ConcurrentReader* reader = (bench->concurrent != NULL) ? concurrentMapReaderNew(bench->concurrent) : NULL;
+    // each thread draws its own sequence
+    unsigned long long state = suite->seed ^ (unsigned long long) (uintptr_t) &reader;
+    long found = 0;
+    for (int i = 0; i < suite->lookupCount; i++) {
+        const char* word = suite->words[nextRandom(&state) % suite->wordCount];
+        if (reader != NULL) {
+            found += concurrentMapContainsKey(reader, word);
+        }
+        else {
+            pthread_mutex_lock(&bench->lock);
+            found += hashMapContainsKey(bench->map, word);
+            pthread_mutex_unlock(&bench->lock);
+        }
+    }
+    concurrentMapReaderDelete(reader);
+    atomic_fetch_add(&bench->found, found);
+    atomic_fetch_sub(&bench->readersLeft, 1);
+    return NULL;
+}
+
+/**
+ * Times suite->readers reader threads against one writer that adds and
+ * removes words of a user dictionary until the readers are done. Latency is
+ * not sampled; the lock makes per-call times mostly a measure of waiting.
+ */
+static void benchConcurrentLookups(Suite* suite, ConcurrentBench* bench, const char* variant)
+{
+    pthread_t* readers = malloc(sizeof(pthread_t) * suite->readers);
+    atomic_init(&bench->readersLeft, suite->readers);
+    atomic_init(&bench->found, 0);
+    long before = allocations();
+    long long start = nowNanos();
+    for (int i = 0; i < suite->readers; i++) {
+        pthread_create(&readers[i], NULL, concurrentReader, bench);
+    }
+    char word[32];
+    long writes = 0;
+    while (atomic_load(&bench->readersLeft) > 0) {
+        snprintf(word, sizeof(word), "userword%ld", writes % 1000);
+        int removing = (writes / 1000) % 2;
+        if (bench->concurrent != NULL) {
+            if (removing) {
+                concurrentMapRemove(bench->concurrent, word);
+            }
+            else {
+                concurrentMapPut(bench->concurrent, word, 1);
+            }
+        }
+        else {
+            pthread_mutex_lock(&bench->lock);
+            if (removing) {
+                hashMapRemove(bench->map, word);
+            }
+            else {
+                hashMapPut(bench->map, word, 1);
+            }
+            pthread_mutex_unlock(&bench->lock);
+        }
+        writes++;
+    }
+    for (int i = 0; i < suite->readers; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    double seconds = (nowNanos() - start) / 1e9;
+    long allocated = allocations() - before;
+    long ops = (long) suite->readers * suite->lookupCount;
+    writeResult(suite, "concurrentLookup", variant, ops, seconds, allocated, NULL, -1, -1);
+    fprintf(stderr, "           %ld writes alongside, %ld of %ld lookups found\n", writes, atomic_load(&bench->found), ops);
+    free(readers);
+}
+
+/**
+ * Tells whether name is one of the comma-separated entries of list.
+ */
+static int listed(const char* list, const char* name)
+{
+    size_t length = strlen(name);
+    for (const char* p = list; *p != '\0';) {
+        const char* end = strchr(p, ',');
+        size_t entry = (end != NULL) ? (size_t) (end - p) : strlen(p);
+        if (entry == length && strncmp(p, name, length) == 0) {
+            return 1;
+        }
+        p += entry + (end != NULL);
+    }
+    return 0;
+}
+
+int main(int argc, const char** argv)
+{
+    Suite suite;
+    memset(&suite, 0, sizeof(suite));
+    suite.dictionaryPath = "dictionary.txt";
+    suite.queryCount = SUITE_QUERIES;
+    suite.lookupCount = SUITE_LOOKUPS;
+    suite.repeat = SUITE_REPEAT;
+    suite.seed = SUITE_SEED;
+    suite.loadThreads = searchPoolDefaultThreads();
+    suite.readers = SUITE_READERS;
+    suite.suggestionCount = SUGGESTION_COUNT;
+    suite.out = stdout;
+    const char* hashList = "3,4";
+    const char* backendList = "dp,myers,simd,symspell,dawg,bktree,bktree+radius2";
+    const char* structureList = "frozen,dawg,concurrent";
+    const char* outPath = NULL;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--dictionary") == 0) {
+            suite.dictionaryPath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--hashes") == 0) {
+            hashList = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--backends") == 0) {
+            backendList = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--structures") == 0) {
+            structureList = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--queries") == 0) {
+            suite.queryCount = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--lookups") == 0) {
+            suite.lookupCount = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--repeat") == 0) {
+            suite.repeat = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0) {
+            suite.seed = strtoull(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--load-threads") == 0) {
+            suite.loadThreads = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--readers") == 0) {
+            suite.readers = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--suggestions") == 0) {
+            suite.suggestionCount = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--out") == 0) {
+            outPath = argv[i + 1];
+        }
+    }
+    if (suite.queryCount < 1 || suite.lookupCount < 1 || suite.repeat < 1 || suite.seed == 0 ||
+        suite.loadThreads < 1 || suite.readers < 1) {
+        fprintf(stderr, "--queries, --lookups, --repeat, --seed, --load-threads and --readers must be positive\n");
+        return 1;
+    }
+    if (suite.suggestionCount < 1 || suite.suggestionCount > TOPK_MAX) {
+        fprintf(stderr, "--suggestions must be between 1 and %d\n", TOPK_MAX);
+        return 1;
+    }
+
+    FILE* file = fopen(suite.dictionaryPath, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open %s\n", suite.dictionaryPath);
+        return 1;
+    }
+    HashMap* map = hashMapNew(1000);
+    loadDictionary(file, map);
+    fclose(file);
+    if (hashMapSize(map) == 0) {
+        fprintf(stderr, "No words in %s\n", suite.dictionaryPath);
+        return 1;
+    }
+
+    // every distinct word, shuffled so inserts do not arrive in hash order
+    suite.wordCount = hashMapSize(map);
+    suite.words = malloc(sizeof(char*) * suite.wordCount);
+    suite.misses = malloc(sizeof(char*) * suite.wordCount);
+    suite.store = candidateStoreNew();
+    int n = 0;
+    for (int i = 0; i < map->capacity; i++) {
+        HashLink* link = map->table[i].link;
+        if (link != NULL) {
+            suite.words[n++] = link->key;
+        }
+    }
+    unsigned long long state = suite.seed;
+    for (int i = suite.wordCount - 1; i > 0; i--) {
+        int j = (int) (nextRandom(&state) % (i + 1));
+        char* t = suite.words[i];
+        suite.words[i] = suite.words[j];
+        suite.words[j] = t;
+    }
+    for (int i = 0; i < suite.wordCount; i++) {
+        int length = strlen(suite.words[i]);
+        suite.misses[i] = malloc(length + 2);
+        memcpy(suite.misses[i], suite.words[i], length);
+        memcpy(suite.misses[i] + length, "q", 2);
+        candidateStoreAdd(suite.store, suite.words[i], length, *hashMapGet(map, suite.words[i]));
+    }
+    candidateStoreFinish(suite.store);
+    generateQueries(&suite);
+
+    if (outPath != NULL) {
+        suite.out = fopen(outPath, "w");
+        if (suite.out == NULL) {
+            fprintf(stderr, "Could not open %s\n", outPath);
+            return 1;
+        }
+    }
+    fprintf(suite.out, "{\n  \"dictionary\": \"%s\", \"words\": %d, \"seed\": %llu, \"kernel\": \"%s\",\n"
+            "  \"results\": [", suite.dictionaryPath, suite.wordCount, suite.seed, candidateStoreKernelName());
+
+    int hashCount = sizeof(hashFunctions) / sizeof(hashFunctions[0]);
+    for (int h = 0; h < hashCount; h++) {
+        char number[4];
+        snprintf(number, sizeof(number), "%d", h + 1);
+        if (!listed(hashList, number)) {
+            continue;
+        }
+        benchLoad(&suite, &hashFunctions[h], 0);
+        benchLoad(&suite, &hashFunctions[h], suite.loadThreads);
+        HashMap* hashed = hashMapNewWithHash(1000, hashFunctions[h].function);
+        for (int i = 0; i < suite.wordCount; i++) {
+            hashMapPut(hashed, suite.words[i], -1);
+        }
+        LookupTarget target = { .name = hashFunctions[h].name, .map = hashed, .bytes = hashMapMemoryUsage(hashed) };
+        benchLookups(&suite, &target, suite.words, "lookupHit");
+        benchLookups(&suite, &target, suite.misses, "lookupMiss");
+        hashMapDelete(hashed);
+        benchInserts(&suite, &hashFunctions[h], HASH_RESIZE_AT_ONCE);
+        benchInserts(&suite, &hashFunctions[h], HASH_RESIZE_INCREMENTAL);
+    }
+    if (listed(structureList, "frozen")) {
+        FrozenMap* frozen = frozenMapBuild(map);
+        LookupTarget target = { .name = "frozen", .frozen = frozen, .bytes = frozenMapMemoryUsage(frozen) };
+        benchLookups(&suite, &target, suite.words, "lookupHit");
+        benchLookups(&suite, &target, suite.misses, "lookupMiss");
+        frozenMapDelete(frozen);
+    }
+    if (listed(structureList, "dawg")) {
+        // the DAWG reads its words from the candidate store, which is left out here
+        Dawg* dawg = dawgBuild(suite.store);
+        LookupTarget target = { .name = "dawg", .dawg = dawg, .bytes = dawgMemoryUsage(dawg) };
+        benchLookups(&suite, &target, suite.words, "lookupHit");
+        benchLookups(&suite, &target, suite.misses, "lookupMiss");
+        dawgDelete(dawg);
+    }
+    int backendCount = sizeof(backendNames) / sizeof(backendNames[0]);
+    for (int b = 0; b < backendCount; b++) {
+        if (listed(backendList, backendNames[b])) {
+            benchSuggestions(&suite, backendNames[b]);
+        }
+    }
+    if (listed(structureList, "concurrent")) {
+        // the writer edits map, which nothing reads after this
+        ConcurrentMap* concurrent = concurrentMapNew(suite.wordCount);
+        for (int i = 0; i < suite.wordCount; i++) {
+            concurrentMapPut(concurrent, suite.words[i], -1);
+        }
+        ConcurrentBench bench = { .suite = &suite, .map = map };
+        pthread_mutex_init(&bench.lock, NULL);
+        benchConcurrentLookups(&suite, &bench, "mutex");
+        bench.concurrent = concurrent;
+        benchConcurrentLookups(&suite, &bench, "concurrentMap");
+        pthread_mutex_destroy(&bench.lock);
+        concurrentMapDelete(concurrent);
+    }
+    fprintf(suite.out, "\n  ]\n}\n");
+
+    if (outPath != NULL) {
+        fclose(suite.out);
+    }
+    for (int i = 0; i < suite.queryCount; i++) {
+        free(suite.queries[i]);
+    }
+    for (int i = 0; i < suite.wordCount; i++) {
+        free(suite.misses[i]);
+    }
+    free(suite.queries);
+    free(suite.misses);
+    free(suite.words);
+    candidateStoreDelete(suite.store);
+    hashMapDelete(map);
+    return 0;
+}
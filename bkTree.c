@@ -0,0 +1,400 @@
+/*
+ * BK-tree over the dictionary, keyed on Levenshtein distance.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bkTree.h"
+#include "dictImage.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct BuildNode BuildNode;
+
+/*
+ * Node of the tree while it is being built, in insertion order.
+ */
+struct BuildNode
+{
+    int id;
+    int distance;
+    int firstChild;
+    int nextSibling;
+};
+
+/**
+ * Exact distance between a prepared word and another word.
+ */
+static int exactDistance(DistanceQuery* query, const char* word, int length)
+{
+    return distanceQueryScore(query, word, length, length + query->length);
+}
+
+/**
+ * Returns the byte offsets of each array in a tree block of the given shape.
+ */
+static size_t layoutTree(int nodeCount, uint32_t poolSize, size_t* offsets, size_t* distances,
+                         size_t* frequencies, size_t* pool)
+{
+    size_t firstChild = sizeof(BkTreeHeader) + sizeof(uint32_t) * nodeCount;
+    *offsets = sizeof(BkTreeHeader);
+    *distances = firstChild + sizeof(uint32_t) * (nodeCount + 1);
+    *frequencies = *distances + sizeof(uint16_t) * nodeCount;
+    *pool = *distances + ((3 * (size_t) nodeCount + 3) & ~(size_t) 3);
+    return *pool + poolSize;
+}
+
+/**
+ * Points a tree's arrays into its memory block.
+ */
+static void attachTree(BkTree* tree)
+{
+    const BkTreeHeader* header = tree->memory;
+    size_t offsets, distances, frequencies, pool;
+    layoutTree(header->nodeCount, header->poolSize, &offsets, &distances, &frequencies, &pool);
+    tree->nodeCount = header->nodeCount;
+    tree->poolSize = header->poolSize;
+    tree->wordOffsets = (const uint32_t*) ((const char*) tree->memory + offsets);
+    tree->firstChild = tree->wordOffsets + tree->nodeCount;
+    tree->parentDistance = (const uint16_t*) ((const char*) tree->memory + distances);
+    tree->frequencies = (const uint8_t*) tree->memory + frequencies;
+    tree->pool = (const char*) tree->memory + pool;
+    tree->fingerprint = header->fingerprint;
+}
+
+/**
+ * Sorts a run of child nodes by their distance to the parent. Siblings all
+ * sit at different distances, so runs are short; insertion sort needs no
+ * comparator context.
+ */
+static void sortChildren(const BuildNode* nodes, int* children, int count)
+{
+    for (int i = 1; i < count; i++) {
+        int child = children[i];
+        int j = i;
+        while (j > 0 && nodes[children[j - 1]].distance > nodes[child].distance) {
+            children[j] = children[j - 1];
+            j--;
+        }
+        children[j] = child;
+    }
+}
+
+/**
+ * Identifies the words and frequency classes of a finished candidate store,
+ * whatever order they were added in, so a saved tree can tell whether it was
+ * built from the same dictionary.
+ * @param store
+ * @return Sum of the FNV-1a hashes of each word and its frequency class.
+ */
+uint64_t bkTreeFingerprint(CandidateStore* store)
+{
+    assert(store != NULL);
+    uint64_t fingerprint = store->size;
+    for (int id = 0; id < store->size; id++) {
+        const char* word = candidateStoreWord(store, id);
+        uint64_t hash = dictImageChecksum(word, store->lengths[id]);
+        hash = (hash ^ store->frequencies[id]) * 0x100000001b3ULL;
+        fingerprint += hash;
+    }
+    return fingerprint;
+}
+
+/**
+ * Builds a BK-tree over every word in a finished candidate store. Each word is
+ * inserted by walking down from the root along the child at its distance
+ * from each node until no such child exists. The tree is then renumbered
+ * breadth first into flat arrays.
+ * @param store
+ * @return The tree, or NULL if the store is empty or two words are more than
+ * UINT16_MAX edits apart, which an edge cannot record.
+ */
+BkTree* bkTreeBuild(CandidateStore* store)
+{
+    assert(store != NULL);
+    if (store->size == 0) {
+        return NULL;
+    }
+
+    BuildNode* nodes = malloc(sizeof(BuildNode) * store->size);
+    int count = 1;
+    nodes[0].id = 0;
+    nodes[0].distance = 0;
+    nodes[0].firstChild = -1;
+    nodes[0].nextSibling = -1;
+    uint32_t poolSize = store->lengths[0] + 1;
+
+    DistanceQuery query;
+    for (int id = 1; id < store->size; id++) {
+        const char* word = candidateStoreWord(store, id);
+        int length = store->lengths[id];
+        int prepared = distanceQueryInit(&query, DISTANCE_MYERS, word, length) == 0;
+        int cur = 0;
+        while (1) {
+            const char* other = candidateStoreWord(store, nodes[cur].id);
+            int d = prepared ? exactDistance(&query, other, store->lengths[nodes[cur].id]) : levDistance(word, other);
+            if (d == 0) {
+                break;
+            }
+            if (d > UINT16_MAX) {
+                // edges are stored in 16 bits, and a clamped one would break
+                // the distinct sorted distances queries prune on
+                free(nodes);
+                return NULL;
+            }
+            int child = nodes[cur].firstChild;
+            while (child >= 0 && nodes[child].distance != d) {
+                child = nodes[child].nextSibling;
+            }
+            if (child >= 0) {
+                cur = child;
+                continue;
+            }
+            // no child at this distance yet, so the word becomes one
+            nodes[count].id = id;
+            nodes[count].distance = d;
+            nodes[count].firstChild = -1;
+            nodes[count].nextSibling = nodes[cur].firstChild;
+            nodes[cur].firstChild = count;
+            poolSize += length + 1;
+            count++;
+            break;
+        }
+    }
+
+    // renumber breadth first so each node's children are contiguous and sorted
+    int* order = malloc(sizeof(int) * count);
+    int* childStart = malloc(sizeof(int) * (count + 1));
+    int tail = 1;
+    order[0] = 0;
+    for (int head = 0; head < count; head++) {
+        childStart[head] = tail;
+        for (int child = nodes[order[head]].firstChild; child >= 0; child = nodes[child].nextSibling) {
+            order[tail++] = child;
+        }
+        sortChildren(nodes, order + childStart[head], tail - childStart[head]);
+    }
+    childStart[count] = tail;
+
+    size_t offsets, distances, frequencyOffset, pool;
+    size_t length = layoutTree(count, poolSize, &offsets, &distances, &frequencyOffset, &pool);
+    BkTree* tree = calloc(1, sizeof(BkTree));
+    tree->memory = calloc(1, length);
+    tree->memoryLength = length;
+    BkTreeHeader* header = tree->memory;
+    memcpy(header->magic, BK_TREE_MAGIC, sizeof(header->magic));
+    header->version = BK_TREE_VERSION;
+    header->headerSize = sizeof(BkTreeHeader);
+    header->nodeCount = count;
+    header->poolSize = poolSize;
+    header->fingerprint = bkTreeFingerprint(store);
+
+    uint32_t* wordOffsets = (uint32_t*) ((char*) tree->memory + offsets);
+    uint32_t* firstChild = wordOffsets + count;
+    uint16_t* parentDistance = (uint16_t*) ((char*) tree->memory + distances);
+    uint8_t* frequencies = (uint8_t*) tree->memory + frequencyOffset;
+    char* words = (char*) tree->memory + pool;
+    uint32_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        const BuildNode* node = &nodes[order[i]];
+        wordOffsets[i] = offset;
+        firstChild[i] = childStart[i];
+        parentDistance[i] = (uint16_t) node->distance;
+        frequencies[i] = store->frequencies[node->id];
+        memcpy(words + offset, candidateStoreWord(store, node->id), store->lengths[node->id] + 1);
+        offset += store->lengths[node->id] + 1;
+    }
+    firstChild[count] = childStart[count];
+    header->checksum = dictImageChecksum((char*) tree->memory + sizeof(BkTreeHeader), length - sizeof(BkTreeHeader));
+    attachTree(tree);
+
+    free(childStart);
+    free(order);
+    free(nodes);
+    return tree;
+}
+
+/**
+ * Frees a built tree or unmaps a loaded one.
+ * @param tree
+ */
+void bkTreeDelete(BkTree* tree)
+{
+    if (tree == NULL) {
+        return;
+    }
+    if (tree->mapped) {
+        munmap(tree->memory, tree->memoryLength);
+    }
+    else {
+        free(tree->memory);
+    }
+    free(tree);
+}
+
+/**
+ * Writes the tree to a file, through path.tmp and a rename.
+ * @param tree
+ * @param path
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int bkTreeSave(BkTree* tree, const char* path)
+{
+    assert((tree != NULL) && (path != NULL));
+
+    size_t tmpLength = strlen(path) + 5;
+    char* tmpPath = malloc(tmpLength);
+    snprintf(tmpPath, tmpLength, "%s.tmp", path);
+    FILE* file = fopen(tmpPath, "wb");
+    int ret = -1;
+    if (file != NULL) {
+        size_t written = fwrite(tree->memory, 1, tree->memoryLength, file);
+        if (fclose(file) == 0 && written == tree->memoryLength && rename(tmpPath, path) == 0) {
+            ret = 0;
+        }
+        else {
+            remove(tmpPath);
+        }
+    }
+    free(tmpPath);
+    return ret;
+}
+
+/**
+ * Maps a tree saved by bkTreeSave and checks its header and checksum.
+ * @param path
+ * @return The tree, or NULL if the file is missing, damaged or from another
+ * version.
+ */
+BkTree* bkTreeLoad(const char* path)
+{
+    assert(path != NULL);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(BkTreeHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    const BkTreeHeader* header = base;
+    size_t offsets, distances, frequencies, pool;
+    int valid = memcmp(header->magic, BK_TREE_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == BK_TREE_VERSION &&
+                header->headerSize == sizeof(BkTreeHeader) &&
+                header->nodeCount > 0 &&
+                layoutTree(header->nodeCount, header->poolSize, &offsets, &distances, &frequencies, &pool) ==
+                    (size_t) st.st_size &&
+                dictImageChecksum((const char*) base + sizeof(BkTreeHeader), st.st_size - sizeof(BkTreeHeader)) ==
+                    header->checksum;
+    if (!valid) {
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    BkTree* tree = calloc(1, sizeof(BkTree));
+    tree->memory = base;
+    tree->memoryLength = st.st_size;
+    tree->mapped = 1;
+    attachTree(tree);
+    return tree;
+}
+
+/**
+ * Returns the word held by a node.
+ * @param tree
+ * @param node
+ * @return Tree-owned word.
+ */
+const char* bkTreeWord(BkTree* tree, int node)
+{
+    assert((tree != NULL) && (node >= 0) && (node < tree->nodeCount));
+    return tree->pool + tree->wordOffsets[node];
+}
+
+/**
+ * Returns the length of a node's word, from the offset of the next word.
+ */
+static int wordLength(BkTree* tree, int node)
+{
+    uint32_t end = (node + 1 < tree->nodeCount) ? tree->wordOffsets[node + 1] : tree->poolSize;
+    return (int) (end - tree->wordOffsets[node]) - 1;
+}
+
+/**
+ * Returns the current search radius: the k-th best distance once k words have
+ * been found, and maxDistance until then.
+ */
+static int searchRadius(TopK* table, int maxDistance)
+{
+    int radius = topKThreshold(table, maxDistance);
+    return (radius < maxDistance) ? radius : maxDistance;
+}
+
+/**
+ * Visits a node and the children that can still hold a match.
+ * @return Number of nodes visited.
+ */
+static int queryNode(BkTree* tree, int node, DistanceQuery* query, int maxDistance, TopK* table)
+{
+    const char* word = bkTreeWord(tree, node);
+    uint32_t firstChild = tree->firstChild[node];
+    uint32_t endChild = tree->firstChild[node + 1];
+    int radius = searchRadius(table, maxDistance);
+    // beyond radius plus the largest edge, no child can be in range, so the
+    // distance only has to be exact up to there
+    int farthest = (endChild > firstChild) ? tree->parentDistance[endChild - 1] : 0;
+    int d = distanceQueryScore(query, word, wordLength(tree, node), radius + farthest);
+    if (d > radius + farthest) {
+        return 1;
+    }
+    if (d <= radius) {
+        topKOffer(table, word, d, tree->frequencies[node]);
+        radius = searchRadius(table, maxDistance);
+    }
+
+    // children are sorted by edge distance; only [d - radius, d + radius] can hold a match
+    int visited = 1;
+    for (uint32_t child = firstChild; child < endChild; child++) {
+        int edge = tree->parentDistance[child];
+        if (edge < d - radius) {
+            continue;
+        }
+        if (edge > d + radius) {
+            break;
+        }
+        visited += queryNode(tree, child, query, maxDistance, table);
+        radius = searchRadius(table, maxDistance);
+    }
+    return visited;
+}
+
+/**
+ * Finds the table->k closest words within maxDistance of the query. The
+ * search radius starts at maxDistance and shrinks to the k-th best distance
+ * once k words have been found.
+ * @param tree
+ * @param query Prepared query.
+ * @param maxDistance Largest distance to report.
+ * @param table Suggestion table to update.
+ * @return Number of nodes whose distance was computed.
+ */
+int bkTreeQuery(BkTree* tree, DistanceQuery* query, int maxDistance, TopK* table)
+{
+    assert((tree != NULL) && (query != NULL) && (table != NULL));
+    return queryNode(tree, 0, query, maxDistance, table);
+}
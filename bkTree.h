@@ -0,0 +1,74 @@
+#ifndef BK_TREE_H
+#define BK_TREE_H
+
+/*
+ * BK-tree over the dictionary, keyed on Levenshtein distance.
+ *
+ * Every child of a node sits at a distinct distance from it. For a query at
+ * distance d from a node, the triangle inequality means only children whose
+ * edge distance is within the search radius of d can hold a match, so most
+ * subtrees are never visited.
+ *
+ * Nodes are numbered breadth first, so a node's children are a contiguous run
+ * of nodes sorted by edge distance. The tree is then just a few flat arrays:
+ * word offsets, each node's first child, and each node's distance to its
+ * parent. The same arrays are written to disk and mapped back as they are.
+ *
+ * File layout (native byte order, offsets from the start of the file):
+ *   BkTreeHeader
+ *   wordOffsets     nodeCount uint32
+ *   firstChild      nodeCount + 1 uint32
+ *   parentDistance  nodeCount uint16
+ *   frequencies     nodeCount uint8 frequency classes, padded to 4 bytes
+ *   string pool     poolSize bytes of null-terminated words
+ */
+
+#include "candidateStore.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define BK_TREE_MAGIC "SPELLBKT"
+#define BK_TREE_VERSION 4
+
+typedef struct BkTree BkTree;
+typedef struct BkTreeHeader BkTreeHeader;
+
+struct BkTreeHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t nodeCount;
+    uint32_t poolSize;
+    // bkTreeFingerprint of the store the tree was built from.
+    uint64_t fingerprint;
+    // 64-bit FNV-1a over every byte after the header.
+    uint64_t checksum;
+};
+
+struct BkTree
+{
+    int nodeCount;
+    const uint32_t* wordOffsets;
+    // Children of node i are nodes firstChild[i] .. firstChild[i + 1] - 1.
+    const uint32_t* firstChild;
+    const uint16_t* parentDistance;
+    const uint8_t* frequencies;
+    const char* pool;
+    uint32_t poolSize;
+    uint64_t fingerprint;
+    // Either one malloc'd block or a read-only file mapping.
+    void* memory;
+    size_t memoryLength;
+    int mapped;
+};
+
+uint64_t bkTreeFingerprint(CandidateStore* store);
+BkTree* bkTreeBuild(CandidateStore* store);
+void bkTreeDelete(BkTree* tree);
+int bkTreeSave(BkTree* tree, const char* path);
+BkTree* bkTreeLoad(const char* path);
+const char* bkTreeWord(BkTree* tree, int node);
+int bkTreeQuery(BkTree* tree, DistanceQuery* query, int maxDistance, TopK* table);
+
+#endif
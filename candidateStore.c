@@ -0,0 +1,747 @@
+/*
+ * Suggestion candidates laid out for batch scoring, and the block kernels
+ * that score them.
+ */
+
+#include "candidateStore.h"
+#include "stats.h"
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CANDIDATE_X86 1
+#endif
+
+/*
+ * Scores one block of CANDIDATE_LANES words of the given length against the
+ * query. out receives every lane's distance, or bound + 1 for lanes beyond
+ * the bound.
+ */
+typedef void (*BlockKernel)(const unsigned char* chars, int length, const char* query, int queryLength,
+                            int bound, uint16_t* out);
+
+/**
+ * Creates an empty store. Add words with candidateStoreAdd, then call
+ * candidateStoreFinish before scanning.
+ * @return The allocated store.
+ */
+CandidateStore* candidateStoreNew(void)
+{
+    CandidateStore* store = calloc(1, sizeof(CandidateStore));
+    store->capacity = 1024;
+    store->offsets = malloc(sizeof(int) * store->capacity);
+    store->lengths = malloc(sizeof(int) * store->capacity);
+    store->frequencies = malloc(store->capacity);
+    store->signatures = malloc(sizeof(uint64_t) * store->capacity);
+    store->poolCapacity = 16 * 1024;
+    store->pool = malloc(store->poolCapacity);
+    return store;
+}
+
+/**
+ * Frees the store and every buffer it owns.
+ * @param store
+ */
+void candidateStoreDelete(CandidateStore* store)
+{
+    if (store == NULL) {
+        return;
+    }
+    for (int n = 0; n <= CANDIDATE_MAX_LENGTH; n++) {
+        free(store->buckets[n].chars);
+        free(store->buckets[n].ids);
+        free(store->buckets[n].signatures);
+        free(store->buckets[n].any);
+        free(store->buckets[n].all);
+    }
+    free(store->longIds);
+    free(store->offsets);
+    free(store->lengths);
+    free(store->frequencies);
+    free(store->signatures);
+    free(store->pool);
+    free(store);
+}
+
+/**
+ * Copies a word into the store's pool. Its id is the number of words added
+ * before it.
+ * @param store
+ * @param word
+ * @param length Length of word.
+ * @param frequency Frequency class of word, 0 if unknown.
+ */
+void candidateStoreAdd(CandidateStore* store, const char* word, int length, int frequency)
+{
+    assert((store != NULL) && (word != NULL));
+    assert((frequency >= 0) && (frequency <= FREQUENCY_CLASS_MAX));
+
+    if (store->size == store->capacity) {
+        store->capacity *= 2;
+        store->offsets = realloc(store->offsets, sizeof(int) * store->capacity);
+        store->lengths = realloc(store->lengths, sizeof(int) * store->capacity);
+        store->frequencies = realloc(store->frequencies, store->capacity);
+        store->signatures = realloc(store->signatures, sizeof(uint64_t) * store->capacity);
+    }
+    while (store->poolSize + length + 1 > store->poolCapacity) {
+        store->poolCapacity *= 2;
+        store->pool = realloc(store->pool, store->poolCapacity);
+    }
+    memcpy(store->pool + store->poolSize, word, length);
+    store->pool[store->poolSize + length] = '\0';
+    store->offsets[store->size] = store->poolSize;
+    store->lengths[store->size] = length;
+    store->frequencies[store->size] = (unsigned char) frequency;
+    store->signatures[store->size] = distanceSignature(word, length);
+    if (frequency > store->maxFrequency) {
+        store->maxFrequency = frequency;
+    }
+    store->poolSize += length + 1;
+    store->size++;
+}
+
+/*
+ * Where a word goes in its bucket: by falling frequency class, then by
+ * signature, then by id.
+ */
+typedef struct CandidateOrder
+{
+    uint64_t signature;
+    int frequency;
+    int id;
+} CandidateOrder;
+
+/**
+ * qsort comparison for CandidateOrder.
+ */
+static int compareOrder(const void* left, const void* right)
+{
+    const CandidateOrder* a = left;
+    const CandidateOrder* b = right;
+    if (a->frequency != b->frequency) {
+        return b->frequency - a->frequency;
+    }
+    if (a->signature != b->signature) {
+        return (a->signature < b->signature) ? 1 : -1;
+    }
+    return a->id - b->id;
+}
+
+/**
+ * Builds the blocked length buckets from the words added so far. Within a
+ * bucket words are ordered by falling frequency class, and words of the same
+ * class by signature, so the words of a block tend to hold the same common
+ * letters and the block's signature bound stays tight.
+ * @param store
+ */
+void candidateStoreFinish(CandidateStore* store)
+{
+    assert(store != NULL);
+
+    // count words per bucket
+    int counts[CANDIDATE_MAX_LENGTH + 1] = { 0 };
+    store->longCount = 0;
+    for (int id = 0; id < store->size; id++) {
+        if (store->lengths[id] <= CANDIDATE_MAX_LENGTH) {
+            counts[store->lengths[id]]++;
+        }
+        else {
+            store->longCount++;
+        }
+    }
+
+    // allocate zeroed blocks so padding lanes never match a query character
+    for (int n = 0; n <= CANDIDATE_MAX_LENGTH; n++) {
+        CandidateBucket* bucket = &store->buckets[n];
+        free(bucket->chars);
+        free(bucket->ids);
+        free(bucket->signatures);
+        free(bucket->any);
+        free(bucket->all);
+        bucket->count = 0;
+        bucket->blockCount = (counts[n] + CANDIDATE_LANES - 1) / CANDIDATE_LANES;
+        bucket->chars = calloc((size_t) bucket->blockCount * CANDIDATE_LANES * (n > 0 ? n : 1), 1);
+        bucket->ids = malloc(sizeof(int) * bucket->blockCount * CANDIDATE_LANES);
+        for (int i = 0; i < bucket->blockCount * CANDIDATE_LANES; i++) {
+            bucket->ids[i] = -1;
+        }
+        bucket->signatures = calloc((size_t) bucket->blockCount * CANDIDATE_LANES + 1, sizeof(uint64_t));
+        bucket->any = malloc(sizeof(uint64_t) * (bucket->blockCount > 0 ? bucket->blockCount : 1));
+        bucket->all = malloc(sizeof(uint64_t) * (bucket->blockCount > 0 ? bucket->blockCount : 1));
+    }
+    free(store->longIds);
+    store->longIds = malloc(sizeof(int) * (store->longCount > 0 ? store->longCount : 1));
+    store->longCount = 0;
+
+    CandidateOrder* order = malloc(sizeof(CandidateOrder) * (store->size > 0 ? store->size : 1));
+    for (int id = 0; id < store->size; id++) {
+        order[id].signature = store->signatures[id];
+        order[id].frequency = store->frequencies[id];
+        order[id].id = id;
+    }
+    qsort(order, store->size, sizeof(CandidateOrder), compareOrder);
+
+    // transpose each word into its block
+    for (int i = 0; i < store->size; i++) {
+        int id = order[i].id;
+        int n = store->lengths[id];
+        if (n > CANDIDATE_MAX_LENGTH) {
+            store->longIds[store->longCount++] = id;
+            continue;
+        }
+        CandidateBucket* bucket = &store->buckets[n];
+        int block = bucket->count / CANDIDATE_LANES;
+        int lane = bucket->count % CANDIDATE_LANES;
+        unsigned char* chars = bucket->chars + (size_t) block * n * CANDIDATE_LANES;
+        const char* word = store->pool + store->offsets[id];
+        for (int c = 0; c < n; c++) {
+            chars[c * CANDIDATE_LANES + lane] = (unsigned char) word[c];
+        }
+        uint64_t signature = store->signatures[id];
+        bucket->any[block] = (lane == 0) ? signature : bucket->any[block] | signature;
+        bucket->all[block] = (lane == 0) ? signature : bucket->all[block] & signature;
+        bucket->signatures[bucket->count] = signature;
+        bucket->ids[bucket->count++] = id;
+    }
+    free(order);
+}
+
+/**
+ * Returns the word with the given id.
+ * @param store
+ * @param id
+ * @return Store-owned word.
+ */
+const char* candidateStoreWord(CandidateStore* store, int id)
+{
+    assert((store != NULL) && (id >= 0) && (id < store->size));
+    return store->pool + store->offsets[id];
+}
+
+/**
+ * Portable block kernel: the same lane-parallel recurrence as the SIMD
+ * kernels written as plain loops, for machines without them.
+ */
+static void blockScoreScalar(const unsigned char* chars, int length, const char* query, int queryLength,
+                             int bound, uint16_t* out)
+{
+    int rowA[CANDIDATE_MAX_LENGTH + 1][CANDIDATE_LANES];
+    int rowB[CANDIDATE_MAX_LENGTH + 1][CANDIDATE_LANES];
+    int (*prev)[CANDIDATE_LANES] = rowA;
+    int (*cur)[CANDIDATE_LANES] = rowB;
+
+    for (int j = 0; j <= length; j++) {
+        for (int l = 0; l < CANDIDATE_LANES; l++) {
+            prev[j][l] = j;
+        }
+    }
+    STATS_ADD(distanceCalls, 1);
+    for (int i = 1; i <= queryLength; i++) {
+        unsigned char q = (unsigned char) query[i - 1];
+        int rowMin = i;
+        STATS_ADD(distanceCells, length * CANDIDATE_LANES);
+        for (int l = 0; l < CANDIDATE_LANES; l++) {
+            cur[0][l] = i;
+        }
+        for (int j = 1; j <= length; j++) {
+            const unsigned char* w = chars + (j - 1) * CANDIDATE_LANES;
+            for (int l = 0; l < CANDIDATE_LANES; l++) {
+                int best = prev[j - 1][l] + (w[l] != q);
+                int side = (prev[j][l] < cur[j - 1][l] ? prev[j][l] : cur[j - 1][l]) + 1;
+                cur[j][l] = best < side ? best : side;
+                if (cur[j][l] < rowMin) {
+                    rowMin = cur[j][l];
+                }
+            }
+        }
+        if (rowMin > bound) {
+            for (int l = 0; l < CANDIDATE_LANES; l++) {
+                out[l] = (uint16_t) (bound + 1);
+            }
+            STATS_ADD(distanceEarlyExits, 1);
+            return;
+        }
+        int (*temp)[CANDIDATE_LANES] = prev;
+        prev = cur;
+        cur = temp;
+    }
+    for (int l = 0; l < CANDIDATE_LANES; l++) {
+        out[l] = (uint16_t) (prev[length][l] <= bound ? prev[length][l] : bound + 1);
+    }
+}
+
+#ifdef CANDIDATE_X86
+
+/**
+ * AVX2 block kernel: all sixteen lanes of a block in one 16 x int16 vector.
+ * Word characters are widened once per block; each query row then costs one
+ * compare, two adds and two mins per word column.
+ */
+__attribute__((target("avx2")))
+static void blockScoreAvx2(const unsigned char* chars, int length, const char* query, int queryLength,
+                           int bound, uint16_t* out)
+{
+    __m256i word[CANDIDATE_MAX_LENGTH];
+    __m256i rowA[CANDIDATE_MAX_LENGTH + 1];
+    __m256i rowB[CANDIDATE_MAX_LENGTH + 1];
+    __m256i* prev = rowA;
+    __m256i* cur = rowB;
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i limit = _mm256_set1_epi16((short) bound);
+
+    for (int j = 0; j < length; j++) {
+        word[j] = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (chars + j * CANDIDATE_LANES)));
+    }
+    for (int j = 0; j <= length; j++) {
+        prev[j] = _mm256_set1_epi16((short) j);
+    }
+    STATS_ADD(distanceCalls, 1);
+    for (int i = 1; i <= queryLength; i++) {
+        __m256i q = _mm256_set1_epi16((unsigned char) query[i - 1]);
+        STATS_ADD(distanceCells, length * CANDIDATE_LANES);
+        cur[0] = _mm256_set1_epi16((short) i);
+        __m256i rowMin = cur[0];
+        for (int j = 1; j <= length; j++) {
+            // equal characters give -1, cancelling the substitution cost
+            __m256i eq = _mm256_cmpeq_epi16(word[j - 1], q);
+            __m256i best = _mm256_add_epi16(_mm256_add_epi16(prev[j - 1], one), eq);
+            __m256i side = _mm256_add_epi16(_mm256_min_epi16(prev[j], cur[j - 1]), one);
+            cur[j] = _mm256_min_epi16(best, side);
+            rowMin = _mm256_min_epi16(rowMin, cur[j]);
+        }
+        // stop once every lane is past the bound
+        if ((unsigned) _mm256_movemask_epi8(_mm256_cmpgt_epi16(rowMin, limit)) == 0xFFFFFFFFu) {
+            for (int l = 0; l < CANDIDATE_LANES; l++) {
+                out[l] = (uint16_t) (bound + 1);
+            }
+            STATS_ADD(distanceEarlyExits, 1);
+            return;
+        }
+        __m256i* temp = prev;
+        prev = cur;
+        cur = temp;
+    }
+    _mm256_storeu_si256((__m256i*) out, _mm256_min_epi16(prev[length], _mm256_add_epi16(limit, one)));
+}
+
+/**
+ * SSE4.1 block kernel: the same recurrence on 8 x int16 vectors, each block
+ * scored as two halves held side by side.
+ */
+__attribute__((target("sse4.1")))
+static void blockScoreSse(const unsigned char* chars, int length, const char* query, int queryLength,
+                          int bound, uint16_t* out)
+{
+    __m128i word[CANDIDATE_MAX_LENGTH][2];
+    __m128i rowA[CANDIDATE_MAX_LENGTH + 1][2];
+    __m128i rowB[CANDIDATE_MAX_LENGTH + 1][2];
+    __m128i (*prev)[2] = rowA;
+    __m128i (*cur)[2] = rowB;
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i limit = _mm_set1_epi16((short) bound);
+
+    for (int j = 0; j < length; j++) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*) (chars + j * CANDIDATE_LANES));
+        word[j][0] = _mm_cvtepu8_epi16(bytes);
+        word[j][1] = _mm_cvtepu8_epi16(_mm_srli_si128(bytes, 8));
+    }
+    for (int j = 0; j <= length; j++) {
+        prev[j][0] = prev[j][1] = _mm_set1_epi16((short) j);
+    }
+    STATS_ADD(distanceCalls, 1);
+    for (int i = 1; i <= queryLength; i++) {
+        __m128i q = _mm_set1_epi16((unsigned char) query[i - 1]);
+        STATS_ADD(distanceCells, length * CANDIDATE_LANES);
+        cur[0][0] = cur[0][1] = _mm_set1_epi16((short) i);
+        __m128i rowMin = cur[0][0];
+        for (int j = 1; j <= length; j++) {
+            for (int h = 0; h < 2; h++) {
+                __m128i eq = _mm_cmpeq_epi16(word[j - 1][h], q);
+                __m128i best = _mm_add_epi16(_mm_add_epi16(prev[j - 1][h], one), eq);
+                __m128i side = _mm_add_epi16(_mm_min_epi16(prev[j][h], cur[j - 1][h]), one);
+                cur[j][h] = _mm_min_epi16(best, side);
+                rowMin = _mm_min_epi16(rowMin, cur[j][h]);
+            }
+        }
+        if (_mm_movemask_epi8(_mm_cmpgt_epi16(rowMin, limit)) == 0xFFFF) {
+            for (int l = 0; l < CANDIDATE_LANES; l++) {
+                out[l] = (uint16_t) (bound + 1);
+            }
+            STATS_ADD(distanceEarlyExits, 1);
+            return;
+        }
+        __m128i (*temp)[2] = prev;
+        prev = cur;
+        cur = temp;
+    }
+    __m128i over = _mm_add_epi16(limit, one);
+    _mm_storeu_si128((__m128i*) out, _mm_min_epi16(prev[length][0], over));
+    _mm_storeu_si128((__m128i*) (out + 8), _mm_min_epi16(prev[length][1], over));
+}
+
+#endif
+
+static BlockKernel selectedKernel = blockScoreScalar;
+static const char* selectedKernelName = "scalar";
+static pthread_once_t kernelOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Picks the widest block kernel the CPU supports. Run once through
+ * pthread_once, since scans may start on several threads at the same time.
+ */
+static void detectKernel(void)
+{
+#ifdef CANDIDATE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        selectedKernel = blockScoreAvx2;
+        selectedKernelName = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse4.1")) {
+        selectedKernel = blockScoreSse;
+        selectedKernelName = "sse4.1";
+    }
+#endif
+}
+
+/**
+ * Returns the block kernel for this CPU.
+ * @param name Set to the kernel's name if not NULL.
+ * @return The block kernel.
+ */
+static BlockKernel selectKernel(const char** name)
+{
+    pthread_once(&kernelOnce, detectKernel);
+    if (name != NULL) {
+        *name = selectedKernelName;
+    }
+    return selectedKernel;
+}
+
+/**
+ * Returns the name of the block kernel selected for this CPU.
+ * @return "avx2", "sse4.1" or "scalar".
+ */
+const char* candidateStoreKernelName(void)
+{
+    const char* name;
+    selectKernel(&name);
+    return name;
+}
+
+/**
+ * Returns the bound for the next candidate, whose frequency class is at most
+ * frequency: the table's own bound, tightened by the one other scans of the
+ * same query have published.
+ */
+static int scanBound(TopK* table, int fallback, int frequency, atomic_int* sharedBound)
+{
+    int bound = topKFrequencyThreshold(table, fallback, frequency);
+    if (sharedBound != NULL) {
+        int shared = atomic_load_explicit(sharedBound, memory_order_relaxed);
+        if (shared < bound) {
+            bound = shared;
+        }
+    }
+    return bound;
+}
+
+/**
+ * Offers a candidate to the table and, once the table is full, publishes its
+ * bound so concurrent scans can prune with it too.
+ */
+static void offer(TopK* table, const char* word, int distance, int frequency, atomic_int* sharedBound)
+{
+    if (topKOffer(table, word, distance, frequency) && sharedBound != NULL && topKFull(table)) {
+        int bound = topKThreshold(table, INT_MAX);
+        int shared = atomic_load_explicit(sharedBound, memory_order_relaxed);
+        while (bound < shared &&
+               !atomic_compare_exchange_weak_explicit(sharedBound, &shared, bound,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+        }
+    }
+}
+
+/**
+ * Counts the set bits of x. Written out rather than left to
+ * __builtin_popcountll, which without -mpopcnt is a library call.
+ */
+static inline int bitCount(uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (int) ((x * 0x0101010101010101ull) >> 56);
+}
+
+/**
+ * Returns a lower bound on the number of character-changing edits between
+ * a query and any word whose signature holds every bit of all and no bit
+ * outside any; for a single word both are its signature. Each set bit of
+ * the query missing from the word needs an insertion or substitution to
+ * supply it, and each set bit of the word missing from the query needs a
+ * deletion or substitution to drop it; one substitution can do one of each.
+ * Transpositions change neither, so the bound holds for OSA too.
+ * @param query Signature of the query.
+ * @param any Union of the candidates' signatures.
+ * @param all Intersection of the candidates' signatures.
+ * @return Lower bound on the edits, not weighted by any cost model.
+ */
+static inline int signatureBound(uint64_t query, uint64_t any, uint64_t all)
+{
+    int missing = bitCount(query & ~any);
+    int extra = bitCount(all & ~query);
+    return (missing > extra) ? missing : extra;
+}
+
+/**
+ * Returns 1 if the query hides the word with the given id from scans.
+ */
+static int hidden(const DistanceQuery* query, int id)
+{
+    if (query->hiddenCount == 0) {
+        return 0;
+    }
+    int lo = 0;
+    int hi = query->hiddenCount - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (query->hiddenIds[mid] == id) {
+            return 1;
+        }
+        if (query->hiddenIds[mid] < id) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Returns the number of words in blocks [firstBlock, endBlock) of the bucket
+ * holding words of the given length. endBlock may lie past the last block.
+ * @param store A finished store.
+ * @param length
+ * @param firstBlock
+ * @param endBlock
+ * @return Word count.
+ */
+int candidateStoreBlockWords(CandidateStore* store, int length, int firstBlock, int endBlock)
+{
+    int count = store->buckets[length].count;
+    int end = endBlock * CANDIDATE_LANES;
+    return ((end < count) ? end : count) - firstBlock * CANDIDATE_LANES;
+}
+
+/*
+ * Words of one bucket that passed the signature filter, gathered into a
+ * block of their own so the SIMD kernel scores only them.
+ */
+typedef struct StagedBlock
+{
+    unsigned char chars[CANDIDATE_MAX_LENGTH * CANDIDATE_LANES];
+    int ids[CANDIDATE_LANES];
+    int count;
+} StagedBlock;
+
+/**
+ * Scores the staged words with the block kernel and empties the stage. Lanes
+ * past count hold zeros or stale words, whose scores are ignored.
+ */
+static void scoreStaged(CandidateStore* store, DistanceQuery* query, TopK* table, int length,
+                        StagedBlock* staged, int fallback, atomic_int* sharedBound)
+{
+    if (staged->count == 0) {
+        return;
+    }
+    uint16_t scores[CANDIDATE_LANES];
+    // staged words keep the bucket's order, so the first is the most common
+    int bound = scanBound(table, fallback, store->frequencies[staged->ids[0]], sharedBound);
+    STATS_ADD(candidatesScored, staged->count);
+    selectKernel(NULL)(staged->chars, length, query->word, query->length, bound, scores);
+    for (int l = 0; l < staged->count; l++) {
+        if (scores[l] <= bound) {
+            int id = staged->ids[l];
+            offer(table, candidateStoreWord(store, id), scores[l], store->frequencies[id], sharedBound);
+        }
+    }
+    staged->count = 0;
+}
+
+/**
+ * Scores blocks [firstBlock, endBlock) of the bucket holding words of the
+ * given length and keeps the closest words in table. A block whose
+ * signatures rule out every lane is skipped whole; otherwise each word is
+ * checked against its own signature first, and only the survivors are
+ * scored, gathered sixteen at a time into a staged block for DISTANCE_SIMD.
+ * @param store A finished store.
+ * @param query Prepared query; its scratch rows are written.
+ * @param table Suggestion table to update.
+ * @param length Bucket to scan.
+ * @param firstBlock
+ * @param endBlock
+ * @param sharedBound Bound shared with concurrent scans of the same query, or
+ * NULL when scanning alone.
+ */
+void candidateStoreScanBlocks(CandidateStore* store, DistanceQuery* query, TopK* table,
+                              int length, int firstBlock, int endBlock, atomic_int* sharedBound)
+{
+    assert((store != NULL) && (query != NULL) && (table != NULL));
+    assert((length >= 0) && (length <= CANDIDATE_MAX_LENGTH));
+
+    CandidateBucket* bucket = &store->buckets[length];
+    int m = query->length;
+    // every insertion or deletion costs indelCost, so the length difference
+    // bounds the distance from below
+    int diff = abs(length - m) * query->indelCost;
+    int fallback = (length + m) * query->indelCost;
+    uint64_t signature = query->signature;
+    int signatureCost = query->signatureCost;
+    StagedBlock staged;
+    staged.count = 0;
+    // the kernel reads every lane, including the ones a partial stage leaves unused
+    memset(staged.chars, 0, (size_t) length * CANDIDATE_LANES);
+
+    if (endBlock > bucket->blockCount) {
+        endBlock = bucket->blockCount;
+    }
+    for (int block = firstBlock; block < endBlock; block++) {
+        const int* ids = bucket->ids + block * CANDIDATE_LANES;
+        // lane 0 is the block's most common word, and no later block has a
+        // more common one, so a bound too small here ends the bucket
+        int bound = scanBound(table, fallback, store->frequencies[ids[0]], sharedBound);
+        if (bound < diff) {
+            scoreStaged(store, query, table, length, &staged, fallback, sharedBound);
+            STATS_ADD(candidatesPruned, candidateStoreBlockWords(store, length, block, endBlock));
+            return;
+        }
+        if (signatureBound(signature, bucket->any[block], bucket->all[block]) * signatureCost > bound) {
+            STATS_ADD(candidatesFiltered, candidateStoreBlockWords(store, length, block, block + 1));
+            continue;
+        }
+        const unsigned char* chars = bucket->chars + (size_t) block * length * CANDIDATE_LANES;
+        const uint64_t* signatures = bucket->signatures + block * CANDIDATE_LANES;
+        for (int l = 0; l < CANDIDATE_LANES && ids[l] >= 0; l++) {
+            int id = ids[l];
+            if (hidden(query, id)) {
+                continue;
+            }
+            if (query->backend != DISTANCE_SIMD) {
+                // the bound can tighten with every word offered
+                bound = scanBound(table, fallback, store->frequencies[id], sharedBound);
+            }
+            if (signatureBound(signature, signatures[l], signatures[l]) * signatureCost > bound) {
+                STATS_ADD(candidatesFiltered, 1);
+                continue;
+            }
+            if (query->backend != DISTANCE_SIMD) {
+                STATS_ADD(candidatesScored, 1);
+                offer(table, candidateStoreWord(store, id), distanceQueryScore(query, candidateStoreWord(store, id),
+                                                                             length, bound),
+                      store->frequencies[id], sharedBound);
+                continue;
+            }
+            for (int c = 0; c < length; c++) {
+                staged.chars[c * CANDIDATE_LANES + staged.count] = chars[c * CANDIDATE_LANES + l];
+            }
+            staged.ids[staged.count++] = id;
+            if (staged.count == CANDIDATE_LANES) {
+                scoreStaged(store, query, table, length, &staged, fallback, sharedBound);
+            }
+        }
+    }
+    scoreStaged(store, query, table, length, &staged, fallback, sharedBound);
+}
+
+/**
+ * Scores the words too long for the blocked layout.
+ * @param store A finished store.
+ * @param query Prepared query.
+ * @param table Suggestion table to update.
+ * @param sharedBound Bound shared with concurrent scans, or NULL.
+ */
+void candidateStoreScanLong(CandidateStore* store, DistanceQuery* query, TopK* table, atomic_int* sharedBound)
+{
+    assert((store != NULL) && (query != NULL) && (table != NULL));
+
+    int indelCost = query->indelCost;
+    for (int i = 0; i < store->longCount; i++) {
+        int id = store->longIds[i];
+        const char* word = candidateStoreWord(store, id);
+        int frequency = store->frequencies[id];
+        int bound = scanBound(table, (store->lengths[id] + query->length) * indelCost, frequency, sharedBound);
+        if (bound < abs(store->lengths[id] - query->length) * indelCost) {
+            STATS_ADD(candidatesPruned, 1);
+        }
+        else if (signatureBound(query->signature, store->signatures[id], store->signatures[id]) *
+                 query->signatureCost > bound) {
+            STATS_ADD(candidatesFiltered, 1);
+        }
+        else if (!hidden(query, id)) {
+            STATS_ADD(candidatesScored, 1);
+            offer(table, word, distanceQueryScore(query, word, store->lengths[id], bound), frequency, sharedBound);
+        }
+        else {
+            STATS_ADD(candidatesPruned, 1);
+        }
+    }
+}
+
+/**
+ * Returns the length of the bucket visited at the given step of a scan for a
+ * query of length queryLength: the query's own length first, then one
+ * shorter, one longer, two shorter and so on.
+ * @param queryLength
+ * @param step
+ * @return Bucket length, or -1 if that step falls outside the buckets.
+ */
+int candidateStoreScanOrder(int queryLength, int step)
+{
+    int diff = (step + 1) / 2;
+    int length = (step % 2 == 1) ? queryLength - diff : queryLength + diff;
+    return (length >= 0 && length <= CANDIDATE_MAX_LENGTH) ? length : -1;
+}
+
+/**
+ * Scores every stored word against the query and keeps the closest ones in
+ * table. Buckets are visited in order of how far their length is from the
+ * query's, so the bound tightens early and whole buckets whose length alone
+ * is too far off are skipped. With DISTANCE_SIMD the buckets are scored a
+ * block at a time; otherwise each word goes through distanceQueryScore.
+ * @param store A finished store.
+ * @param query Prepared query.
+ * @param table Suggestion table to update.
+ */
+void candidateStoreScan(CandidateStore* store, DistanceQuery* query, TopK* table)
+{
+    assert((store != NULL) && (query != NULL) && (table != NULL));
+
+    int steps = 2 * (CANDIDATE_MAX_LENGTH + query->length) + 1;
+    for (int step = 0; step < steps; step++) {
+        int length = candidateStoreScanOrder(query->length, step);
+        int lowest = (step + 1) / 2 * query->indelCost;
+        if (lowest > topKThreshold(table, lowest)) {
+#ifdef SPELL_STATS
+            // every bucket not visited yet is pruned
+            for (; step < steps; step++) {
+                length = candidateStoreScanOrder(query->length, step);
+                if (length >= 0) {
+                    STATS_ADD(candidatesPruned, store->buckets[length].count);
+                }
+            }
+#endif
+            break;
+        }
+        if (length >= 0) {
+            candidateStoreScanBlocks(store, query, table, length, 0, store->buckets[length].blockCount, NULL);
+        }
+    }
+    candidateStoreScanLong(store, query, table, NULL);
+}
@@ -0,0 +1,89 @@
+#ifndef CANDIDATE_STORE_H
+#define CANDIDATE_STORE_H
+
+/*
+ * Suggestion candidates laid out for batch scoring.
+ *
+ * Words are grouped by length. Within a length bucket they are packed into
+ * blocks of CANDIDATE_LANES words stored column-major: byte c of every word in
+ * a block sits in one contiguous run of CANDIDATE_LANES bytes. A SIMD kernel
+ * can then load character c of sixteen words with one load and run the edit
+ * distance recurrence for all of them at once. A scan reads each bucket
+ * sequentially instead of chasing a link and a key pointer per word.
+ *
+ * Within a bucket words are ordered by falling frequency class, so the first
+ * lane of a block is its most common word. Once a scan's table is full, a
+ * block whose first word is rarer than the table's last entry can only place
+ * words strictly closer than that entry, and the bound drops by one for it
+ * and every block after it.
+ *
+ * Words of the same class are ordered by character signature (see
+ * distanceSignature), and each block keeps the union and intersection of its
+ * lanes' signatures. A scan skips a block without scoring it when those
+ * alone show every lane is too far from the query.
+ */
+
+#include "distance.h"
+#include "topK.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define CANDIDATE_LANES 16
+// Longest word kept in the blocked layout; longer words are scored one by one.
+#define CANDIDATE_MAX_LENGTH 64
+
+typedef struct CandidateBucket CandidateBucket;
+typedef struct CandidateStore CandidateStore;
+
+struct CandidateBucket
+{
+    int count;
+    int blockCount;
+    // blockCount * length * CANDIDATE_LANES bytes; padding lanes hold zeros.
+    unsigned char* chars;
+    // Word id of every lane, -1 for padding.
+    int* ids;
+    // Signature of every lane, and the union and intersection of the
+    // signatures of each block's words.
+    uint64_t* signatures;
+    uint64_t* any;
+    uint64_t* all;
+};
+
+struct CandidateStore
+{
+    int size;
+    int capacity;
+    // Every word, null terminated, back to back.
+    char* pool;
+    int poolSize;
+    int poolCapacity;
+    // Pool offset and length of every word, indexed by word id.
+    int* offsets;
+    int* lengths;
+    // Frequency class of every word, indexed by word id.
+    unsigned char* frequencies;
+    int maxFrequency;
+    // Character signature of every word, indexed by word id.
+    uint64_t* signatures;
+    // buckets[n] holds the words of length n.
+    CandidateBucket buckets[CANDIDATE_MAX_LENGTH + 1];
+    // Ids of words longer than CANDIDATE_MAX_LENGTH.
+    int* longIds;
+    int longCount;
+};
+
+CandidateStore* candidateStoreNew(void);
+void candidateStoreDelete(CandidateStore* store);
+void candidateStoreAdd(CandidateStore* store, const char* word, int length, int frequency);
+void candidateStoreFinish(CandidateStore* store);
+const char* candidateStoreWord(CandidateStore* store, int id);
+void candidateStoreScan(CandidateStore* store, DistanceQuery* query, TopK* table);
+void candidateStoreScanBlocks(CandidateStore* store, DistanceQuery* query, TopK* table,
+                              int length, int firstBlock, int endBlock, atomic_int* sharedBound);
+void candidateStoreScanLong(CandidateStore* store, DistanceQuery* query, TopK* table, atomic_int* sharedBound);
+int candidateStoreScanOrder(int queryLength, int step);
+int candidateStoreBlockWords(CandidateStore* store, int length, int firstBlock, int endBlock);
+const char* candidateStoreKernelName(void);
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * Spell checking as a library, for programs that link the checker in rather
+ * than run spellChecker.
+ */
+
+#include "checker.h"
+#include "dictionary.h"
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Loads a dictionary: a prebuilt image from dictCompile if path is one,
+ * otherwise a word list read like dictionary.txt on one thread per CPU.
+ * @param path
+ * @return The checker, or NULL if the file cannot be read.
+ */
+Checker* checkerOpen(const char* path)
+{
+    assert(path != NULL);
+    Checker* checker = calloc(1, sizeof(Checker));
+    checker->image = dictImageOpen(path);
+    if (checker->image == NULL) {
+        checker->map = hashMapNew(1000);
+        if (loadDictionaryParallel(path, checker->map, 0) != 0) {
+            hashMapDelete(checker->map);
+            free(checker);
+            return NULL;
+        }
+    }
+
+    checker->store = candidateStoreNew();
+    if (checker->image != NULL) {
+        int ordinal = 0;
+        int size = dictImageSize(checker->image);
+        for (const char* word = dictImageFirstWord(checker->image); word != NULL && ordinal < size;
+             word = dictImageNextWord(checker->image, word)) {
+            candidateStoreAdd(checker->store, word, strlen(word), dictImageFrequency(checker->image, ordinal++));
+        }
+    }
+    else {
+        // walking the table directly misses links a resize has not moved yet
+        hashMapFinishResize(checker->map);
+        for (int i = 0; i < checker->map->capacity; i++) {
+            HashLink* link = checker->map->table[i].link;
+            if (link != NULL) {
+                candidateStoreAdd(checker->store, link->key, link->length, link->value);
+            }
+        }
+    }
+    candidateStoreFinish(checker->store);
+    return checker;
+}
+
+/**
+ * Frees the checker. No context may use it afterwards, and words it
+ * suggested are no longer valid.
+ * @param checker
+ */
+void checkerClose(Checker* checker)
+{
+    if (checker == NULL) {
+        return;
+    }
+    candidateStoreDelete(checker->store);
+    if (checker->map != NULL) {
+        hashMapDelete(checker->map);
+    }
+    dictImageClose(checker->image);
+    free(checker);
+}
+
+/**
+ * Sets up a context for one thread's queries against checker, scoring
+ * suggestions by Levenshtein distance with the SIMD block kernel. Change
+ * backend or model afterwards to score them another way. A context owns no
+ * memory and needs no cleanup.
+ * @param context
+ * @param checker
+ */
+void checkerContextInit(CheckerContext* context, Checker* checker)
+{
+    assert((context != NULL) && (checker != NULL));
+    context->checker = checker;
+    context->backend = DISTANCE_SIMD;
+    context->model = DISTANCE_LEVENSHTEIN;
+    context->word[0] = '\0';
+    topKInit(&context->table, SUGGESTION_COUNT);
+}
+
+/**
+ * Lowercases word into the context's buffer.
+ * @return 1 if it fit, 0 if it is longer than DISTANCE_MAX_WORD.
+ */
+static int copyWord(CheckerContext* context, const char* word, int length)
+{
+    if (length > DISTANCE_MAX_WORD) {
+        return 0;
+    }
+    for (int i = 0; i < length; i++) {
+        context->word[i] = tolower((unsigned char) word[i]);
+    }
+    context->word[length] = '\0';
+    return 1;
+}
+
+/**
+ * Returns 1 if the word, lowercased, is in the dictionary. Words longer than
+ * DISTANCE_MAX_WORD are reported as misspelled.
+ * @param context
+ * @param word Need not be null terminated.
+ * @param length
+ * @return 1 if the word is found, 0 otherwise.
+ */
+int checkerCheck(CheckerContext* context, const char* word, int length)
+{
+    assert((context != NULL) && (word != NULL || length == 0));
+    if (length <= 0 || !copyWord(context, word, length)) {
+        return 0;
+    }
+    Checker* checker = context->checker;
+    if (checker->image != NULL) {
+        return dictImageContainsKey(checker->image, context->word);
+    }
+    return hashMapContainsKey(checker->map, context->word);
+}
+
+/**
+ * Finds the k dictionary words closest to the word, lowercased, by a scan of
+ * the candidate store on the calling thread. Equally close words rank by
+ * frequency and then alphabetically. Words longer than DISTANCE_MAX_WORD get
+ * no suggestions.
+ * @param context
+ * @param word Need not be null terminated.
+ * @param length
+ * @param k Suggestions wanted, 1 to TOPK_MAX.
+ * @param out Room for k suggestions, written best first; their words point
+ * into the checker.
+ * @return Number of suggestions written, fewer than k only for a dictionary
+ * with fewer words, or -1 if k is out of range.
+ */
+int checkerSuggest(CheckerContext* context, const char* word, int length, int k, Suggestion* out)
+{
+    assert((context != NULL) && (word != NULL || length == 0) && (out != NULL));
+    if (k < 1 || k > TOPK_MAX) {
+        return -1;
+    }
+    if (length < 0 || !copyWord(context, word, length)) {
+        return 0;
+    }
+    DistanceQuery* query = &context->query;
+    distanceQueryInit(query, context->backend, context->word, length);
+    distanceQuerySetModel(query, context->model);
+    topKInit(&context->table, k);
+    candidateStoreScan(context->checker->store, query, &context->table);
+    return topKSorted(&context->table, out);
+}
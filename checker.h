@@ -0,0 +1,64 @@
+#ifndef CHECKER_H
+#define CHECKER_H
+
+/*
+ * Spell checking as a library, for programs that link the checker in rather
+ * than run spellChecker.
+ *
+ * A Checker is a loaded dictionary: its words for lookups and a candidate
+ * store for suggestions. It is built by checkerOpen and only read afterwards,
+ * so any number of threads can share one.
+ *
+ * Each thread keeps its own CheckerContext, which holds every buffer a query
+ * needs: the lowercased word, the prepared distance query with its DP rows,
+ * and the top-k heap. Contexts are plain structs set up by checkerContextInit
+ * and own no memory, so they can live on the stack or inside the caller's
+ * own per-thread state, and checkerCheck and checkerSuggest allocate nothing.
+ *
+ * Words are passed as a pointer and a length and need not be null
+ * terminated; they are lowercased into the context before lookup, as
+ * spellChecker does. Suggested words point into the checker and stay valid
+ * until checkerClose.
+ *
+ * `make libchecker.a` builds checker.c with arena.c, hashMap.c,
+ * dictionary.c, dictImage.c, distance.c, suggestion.c, topK.c,
+ * candidateStore.c and stats.c into one static library to link against;
+ * `make test` runs checkerTest over it.
+ */
+
+#include "hashMap.h"
+#include "dictImage.h"
+#include "distance.h"
+#include "topK.h"
+#include "candidateStore.h"
+
+typedef struct Checker Checker;
+typedef struct CheckerContext CheckerContext;
+
+struct Checker
+{
+    // Exactly one of map and image is non-NULL.
+    HashMap* map;
+    DictImage* image;
+    // The same words, laid out for suggestion scans.
+    CandidateStore* store;
+};
+
+struct CheckerContext
+{
+    Checker* checker;
+    DistanceBackend backend;
+    DistanceModel model;
+    // Lowercased copy of the word being checked, null terminated.
+    char word[DISTANCE_MAX_WORD + 1];
+    DistanceQuery query;
+    TopK table;
+};
+
+Checker* checkerOpen(const char* path);
+void checkerClose(Checker* checker);
+void checkerContextInit(CheckerContext* context, Checker* checker);
+int checkerCheck(CheckerContext* context, const char* word, int length);
+int checkerSuggest(CheckerContext* context, const char* word, int length, int k, Suggestion* out);
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * Tests for the checker library.
+ *
+ * Usage: checkerTest [dictionary]
+ *
+ * Loads dictionary.txt unless another word list or image is given and runs
+ * checkerCheck and checkerSuggest on words that are not null terminated.
+ * Each word is copied into a buffer of exactly its length, so a read past
+ * the end shows up under a sanitizer or valgrind. Prints each failed check
+ * and exits 1 if there were any.
+ */
+
+#include "checker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+/**
+ * Returns a heap copy of the first length bytes of text, with no terminator.
+ */
+static char* exactCopy(const char* text, int length)
+{
+    char* copy = malloc(length > 0 ? length : 1);
+    memcpy(copy, text, length);
+    return copy;
+}
+
+/**
+ * Checks a word given as the first length bytes of text.
+ */
+static int check(CheckerContext* context, const char* text, int length)
+{
+    char* word = exactCopy(text, length);
+    int correct = checkerCheck(context, word, length);
+    free(word);
+    return correct;
+}
+
+/**
+ * Suggests for a word given as the first length bytes of text.
+ */
+static int suggest(CheckerContext* context, const char* text, int length, int k, Suggestion* out)
+{
+    char* word = exactCopy(text, length);
+    int found = checkerSuggest(context, word, length, k, out);
+    free(word);
+    return found;
+}
+
+/**
+ * Returns 1 if word is among the first count suggestions.
+ */
+static int suggested(const Suggestion* out, int count, const char* word)
+{
+    for (int i = 0; i < count; i++) {
+        if (strcmp(out[i].word, word) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, const char** argv)
+{
+    const char* path = (argc > 1) ? argv[1] : "dictionary.txt";
+    Checker* checker = checkerOpen(path);
+    if (checker == NULL) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return 1;
+    }
+    CheckerContext context;
+    checkerContextInit(&context, checker);
+    Suggestion out[TOPK_MAX];
+
+    // only the first length bytes count, whatever follows them
+    EXPECT(check(&context, "helloxyz", 5) == 1);
+    EXPECT(check(&context, "HeLLo", 5) == 1);
+    EXPECT(check(&context, "helloxyz", 8) == 0);
+    EXPECT(check(&context, "hel", 3) == 0);
+
+    int found = suggest(&context, "helozzz", 4, SUGGESTION_COUNT, out);
+    EXPECT(found == SUGGESTION_COUNT);
+    EXPECT(suggested(out, found, "hello"));
+    for (int i = 1; i < found; i++) {
+        EXPECT(!suggestionRanksBefore(&out[i], &out[i - 1]));
+    }
+    EXPECT(suggest(&context, "helo", 4, TOPK_MAX, out) == TOPK_MAX);
+
+    // k out of range
+    EXPECT(suggest(&context, "helo", 4, 0, out) == -1);
+    EXPECT(suggest(&context, "helo", 4, TOPK_MAX + 1, out) == -1);
+
+    // the empty word is never correct, and its suggestions are the shortest words
+    EXPECT(check(&context, "", 0) == 0);
+    EXPECT(checkerCheck(&context, NULL, 0) == 0);
+    found = suggest(&context, "", 0, 3, out);
+    EXPECT(found == 3);
+    for (int i = 0; i < found; i++) {
+        EXPECT(out[i].distance == (int) strlen(out[i].word));
+    }
+
+    // the longest word the context holds, and one byte past it
+    char* longWord = malloc(DISTANCE_MAX_WORD + 1);
+    memset(longWord, 'a', DISTANCE_MAX_WORD + 1);
+    EXPECT(check(&context, longWord, DISTANCE_MAX_WORD) == 0);
+    EXPECT(suggest(&context, longWord, DISTANCE_MAX_WORD, 2, out) == 2);
+    EXPECT(check(&context, longWord, DISTANCE_MAX_WORD + 1) == 0);
+    EXPECT(suggest(&context, longWord, DISTANCE_MAX_WORD + 1, 2, out) == 0);
+    free(longWord);
+
+    // a word after an over-long one is read fresh
+    EXPECT(check(&context, "hello", 5) == 1);
+
+    checkerClose(checker);
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("checkerTest: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,362 @@
+/*
+ * Read-mostly string set with lock-free lookups and epoch-based reclamation.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "concurrentMap.h"
+#include "hashMap.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Left in the slot of a removed word so probe runs through it stay intact.
+static ConcurrentEntry tombstoneEntry;
+#define TOMBSTONE (&tombstoneEntry)
+
+/**
+ * Allocates an empty table with the given number of slots.
+ */
+static ConcurrentTable* tableNew(int capacity)
+{
+    ConcurrentTable* table = calloc(1, sizeof(ConcurrentTable) + sizeof(table->slots[0]) * capacity);
+    table->capacity = capacity;
+    for (int i = 0; i < capacity; i++) {
+        atomic_init(&table->slots[i], NULL);
+    }
+    return table;
+}
+
+/**
+ * Creates an empty map.
+ * @param capacity Expected number of words; the table starts large enough to
+ * hold them without a rebuild.
+ * @return New map.
+ */
+ConcurrentMap* concurrentMapNew(int capacity)
+{
+    int slots = 8;
+    while (slots * MAX_TABLE_LOAD < capacity) {
+        slots *= 2;
+    }
+    ConcurrentMap* map = calloc(1, sizeof(ConcurrentMap));
+    atomic_init(&map->table, tableNew(slots));
+    atomic_init(&map->epoch, 1);
+    pthread_mutex_init(&map->writerLock, NULL);
+    return map;
+}
+
+/**
+ * Frees the map, every word in it and everything still waiting to be
+ * reclaimed. No reader may be in a lookup.
+ * @param map
+ */
+void concurrentMapDelete(ConcurrentMap* map)
+{
+    if (map == NULL) {
+        return;
+    }
+    ConcurrentTable* table = atomic_load(&map->table);
+    for (int i = 0; i < table->capacity; i++) {
+        ConcurrentEntry* entry = atomic_load_explicit(&table->slots[i], memory_order_relaxed);
+        if (entry != NULL && entry != TOMBSTONE) {
+            free(entry);
+        }
+    }
+    free(table);
+    while (map->retired != NULL) {
+        ConcurrentRetired* next = map->retired->next;
+        free(map->retired->pointer);
+        free(map->retired);
+        map->retired = next;
+    }
+    while (map->readers != NULL) {
+        ConcurrentReader* next = map->readers->next;
+        free(map->readers);
+        map->readers = next;
+    }
+    pthread_mutex_destroy(&map->writerLock);
+    free(map);
+}
+
+/**
+ * Registers a reader. Every thread that looks words up needs its own.
+ * @param map
+ * @return Reader handle owned by the calling thread.
+ */
+ConcurrentReader* concurrentMapReaderNew(ConcurrentMap* map)
+{
+    assert(map != NULL);
+    ConcurrentReader* reader = malloc(sizeof(ConcurrentReader));
+    reader->map = map;
+    atomic_init(&reader->epoch, 0);
+    pthread_mutex_lock(&map->writerLock);
+    reader->next = map->readers;
+    map->readers = reader;
+    pthread_mutex_unlock(&map->writerLock);
+    return reader;
+}
+
+/**
+ * Unregisters and frees a reader.
+ * @param reader
+ */
+void concurrentMapReaderDelete(ConcurrentReader* reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+    ConcurrentMap* map = reader->map;
+    pthread_mutex_lock(&map->writerLock);
+    ConcurrentReader** link = &map->readers;
+    while (*link != reader) {
+        link = &(*link)->next;
+    }
+    *link = reader->next;
+    pthread_mutex_unlock(&map->writerLock);
+    free(reader);
+}
+
+/**
+ * Probes a table for a key. Safe from any thread as long as the table cannot
+ * be freed meanwhile.
+ * @return The key's entry, or NULL if it is not in the table.
+ */
+static ConcurrentEntry* findEntry(ConcurrentTable* table, const char* key, uint64_t hash)
+{
+    int mask = table->capacity - 1;
+    for (int i = (int) (hash & mask);; i = (i + 1) & mask) {
+        ConcurrentEntry* entry = atomic_load_explicit(&table->slots[i], memory_order_acquire);
+        if (entry == NULL) {
+            return NULL;
+        }
+        if (entry != TOMBSTONE && entry->hash == hash && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+}
+
+/**
+ * Looks a key up without taking any lock.
+ * @param reader The calling thread's reader.
+ * @param key
+ * @param value Set to the key's value when it is found; may be NULL.
+ * @return 1 if the key is in the map, 0 otherwise.
+ */
+int concurrentMapGet(ConcurrentReader* reader, const char* key, int* value)
+{
+    assert((reader != NULL) && (key != NULL));
+    ConcurrentMap* map = reader->map;
+    uint64_t hash = HASH_FUNCTION(key);
+
+    // announce the epoch before touching the table; the fence pairs with the
+    // one in concurrentMapReclaim so the writer either sees the announcement
+    // or this lookup sees the writer's unlink
+    atomic_store_explicit(&reader->epoch, atomic_load(&map->epoch), memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    ConcurrentTable* table = atomic_load_explicit(&map->table, memory_order_acquire);
+    ConcurrentEntry* entry = findEntry(table, key, hash);
+    if (entry != NULL && value != NULL) {
+        *value = atomic_load_explicit(&entry->value, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+    return entry != NULL;
+}
+
+/**
+ * Returns 1 if the key is in the map and 0 otherwise, without taking any lock.
+ * @param reader The calling thread's reader.
+ * @param key
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int concurrentMapContainsKey(ConcurrentReader* reader, const char* key)
+{
+    return concurrentMapGet(reader, key, NULL);
+}
+
+/**
+ * Queues a table or entry to be freed once no reader can hold it, and opens a
+ * new epoch. Called with writerLock held, after the object was unlinked.
+ */
+static void retire(ConcurrentMap* map, void* pointer)
+{
+    ConcurrentRetired* retired = malloc(sizeof(ConcurrentRetired));
+    retired->pointer = pointer;
+    retired->epoch = atomic_fetch_add(&map->epoch, 1);
+    retired->next = map->retired;
+    map->retired = retired;
+    map->retiredCount++;
+}
+
+/**
+ * Frees whatever no reader can still hold: everything retired in an epoch
+ * earlier than the oldest epoch a reader is in.
+ */
+static void reclaimLocked(ConcurrentMap* map)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    unsigned long oldest = ULONG_MAX;
+    for (ConcurrentReader* reader = map->readers; reader != NULL; reader = reader->next) {
+        unsigned long epoch = atomic_load_explicit(&reader->epoch, memory_order_acquire);
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+    ConcurrentRetired** link = &map->retired;
+    while (*link != NULL) {
+        ConcurrentRetired* retired = *link;
+        if (retired->epoch < oldest) {
+            *link = retired->next;
+            free(retired->pointer);
+            free(retired);
+            map->reclaimedCount++;
+        }
+        else {
+            link = &retired->next;
+        }
+    }
+}
+
+/**
+ * Frees retired tables and entries that no reader can still hold. Writers do
+ * this on their own after every change; this is for reclaiming the tail end
+ * once the writes stop.
+ * @param map
+ */
+void concurrentMapReclaim(ConcurrentMap* map)
+{
+    assert(map != NULL);
+    pthread_mutex_lock(&map->writerLock);
+    reclaimLocked(map);
+    pthread_mutex_unlock(&map->writerLock);
+}
+
+/**
+ * Publishes a new table holding every live entry of the current one, without
+ * tombstones, and retires the old table. The entries themselves are shared.
+ */
+static void rebuildTable(ConcurrentMap* map, int capacity)
+{
+    ConcurrentTable* old = atomic_load_explicit(&map->table, memory_order_relaxed);
+    ConcurrentTable* table = tableNew(capacity);
+    int mask = capacity - 1;
+    for (int i = 0; i < old->capacity; i++) {
+        ConcurrentEntry* entry = atomic_load_explicit(&old->slots[i], memory_order_relaxed);
+        if (entry == NULL || entry == TOMBSTONE) {
+            continue;
+        }
+        int j = (int) (entry->hash & mask);
+        while (atomic_load_explicit(&table->slots[j], memory_order_relaxed) != NULL) {
+            j = (j + 1) & mask;
+        }
+        atomic_store_explicit(&table->slots[j], entry, memory_order_relaxed);
+    }
+    atomic_store_explicit(&map->table, table, memory_order_release);
+    map->tombstones = 0;
+    retire(map, old);
+}
+
+/**
+ * Adds a key or updates its value. Readers keep running meanwhile; writers
+ * are serialized.
+ * @param map
+ * @param key
+ * @param value
+ */
+void concurrentMapPut(ConcurrentMap* map, const char* key, int value)
+{
+    assert((map != NULL) && (key != NULL));
+    uint64_t hash = HASH_FUNCTION(key);
+    pthread_mutex_lock(&map->writerLock);
+
+    ConcurrentTable* table = atomic_load_explicit(&map->table, memory_order_relaxed);
+    ConcurrentEntry* entry = findEntry(table, key, hash);
+    if (entry != NULL) {
+        atomic_store_explicit(&entry->value, value, memory_order_relaxed);
+        pthread_mutex_unlock(&map->writerLock);
+        return;
+    }
+
+    // tombstones count towards the load: readers must always reach an empty slot
+    if ((float) (map->size + map->tombstones + 1) / (float) table->capacity > MAX_TABLE_LOAD) {
+        int grow = (float) (map->size + 1) / (float) table->capacity > MAX_TABLE_LOAD / 2;
+        rebuildTable(map, grow ? table->capacity * 2 : table->capacity);
+        table = atomic_load_explicit(&map->table, memory_order_relaxed);
+    }
+
+    int length = strlen(key);
+    entry = malloc(sizeof(ConcurrentEntry) + length + 1);
+    entry->hash = hash;
+    atomic_init(&entry->value, value);
+    entry->length = length;
+    memcpy(entry->key, key, length + 1);
+
+    int mask = table->capacity - 1;
+    int i = (int) (hash & mask);
+    ConcurrentEntry* current;
+    while ((current = atomic_load_explicit(&table->slots[i], memory_order_relaxed)) != NULL &&
+           current != TOMBSTONE) {
+        i = (i + 1) & mask;
+    }
+    if (current == TOMBSTONE) {
+        map->tombstones--;
+    }
+    // release: a reader that sees the pointer sees a complete entry
+    atomic_store_explicit(&table->slots[i], entry, memory_order_release);
+    map->size++;
+
+    reclaimLocked(map);
+    pthread_mutex_unlock(&map->writerLock);
+}
+
+/**
+ * Removes a key. Its entry is freed once no reader can still be looking at it.
+ * @param map
+ * @param key
+ * @return 1 if the key was removed, 0 if it was not in the map.
+ */
+int concurrentMapRemove(ConcurrentMap* map, const char* key)
+{
+    assert((map != NULL) && (key != NULL));
+    uint64_t hash = HASH_FUNCTION(key);
+    pthread_mutex_lock(&map->writerLock);
+
+    ConcurrentTable* table = atomic_load_explicit(&map->table, memory_order_relaxed);
+    int mask = table->capacity - 1;
+    int removed = 0;
+    for (int i = (int) (hash & mask);; i = (i + 1) & mask) {
+        ConcurrentEntry* entry = atomic_load_explicit(&table->slots[i], memory_order_relaxed);
+        if (entry == NULL) {
+            break;
+        }
+        if (entry != TOMBSTONE && entry->hash == hash && strcmp(entry->key, key) == 0) {
+            atomic_store_explicit(&table->slots[i], TOMBSTONE, memory_order_release);
+            map->size--;
+            map->tombstones++;
+            retire(map, entry);
+            removed = 1;
+            break;
+        }
+    }
+
+    reclaimLocked(map);
+    pthread_mutex_unlock(&map->writerLock);
+    return removed;
+}
+
+/**
+ * Returns the number of words in the map.
+ * @param map
+ * @return Number of words.
+ */
+int concurrentMapSize(ConcurrentMap* map)
+{
+    assert(map != NULL);
+    pthread_mutex_lock(&map->writerLock);
+    int size = map->size;
+    pthread_mutex_unlock(&map->writerLock);
+    return size;
+}
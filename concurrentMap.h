@@ -0,0 +1,93 @@
+#ifndef CONCURRENT_MAP_H
+#define CONCURRENT_MAP_H
+
+/*
+ * Read-mostly string set shared between threads.
+ *
+ * Any number of reader threads look words up without taking a lock, while
+ * writers add and remove words under one writer mutex. The table is an array
+ * of atomic pointers to immutable entries, probed linearly. Readers never
+ * block and never retry, so a lookup finishes in a bounded number of steps.
+ *
+ * Writers never move an entry a reader might be looking at. A removed word
+ * leaves a tombstone in its slot. Once live words and tombstones together
+ * pass MAX_TABLE_LOAD, the writer builds a fresh table, publishes it with one
+ * atomic store and retires the old one.
+ *
+ * Retired tables and entries are freed by epoch-based reclamation. Each
+ * reader thread registers a ConcurrentReader and, for the length of a lookup,
+ * publishes the global epoch it started in. A retired object is tagged with
+ * the epoch in which it was unlinked. It is freed only once every reader in a
+ * lookup started in a later epoch, and so cannot have seen it.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+typedef struct ConcurrentEntry ConcurrentEntry;
+typedef struct ConcurrentTable ConcurrentTable;
+typedef struct ConcurrentRetired ConcurrentRetired;
+typedef struct ConcurrentReader ConcurrentReader;
+typedef struct ConcurrentMap ConcurrentMap;
+
+struct ConcurrentEntry
+{
+    uint64_t hash;
+    atomic_int value;
+    int length;
+    char key[];
+};
+
+struct ConcurrentTable
+{
+    // Always a power of two.
+    int capacity;
+    _Atomic(ConcurrentEntry*) slots[];
+};
+
+/*
+ * A table or entry waiting until no reader can still hold it.
+ */
+struct ConcurrentRetired
+{
+    void* pointer;
+    unsigned long epoch;
+    ConcurrentRetired* next;
+};
+
+struct ConcurrentReader
+{
+    ConcurrentMap* map;
+    // Epoch the current lookup started in, 0 between lookups.
+    atomic_ulong epoch;
+    ConcurrentReader* next;
+};
+
+struct ConcurrentMap
+{
+    _Atomic(ConcurrentTable*) table;
+    atomic_ulong epoch;
+    // Everything below is only touched with writerLock held.
+    pthread_mutex_t writerLock;
+    int size;
+    int tombstones;
+    ConcurrentReader* readers;
+    ConcurrentRetired* retired;
+    long retiredCount;
+    long reclaimedCount;
+};
+
+ConcurrentMap* concurrentMapNew(int capacity);
+void concurrentMapDelete(ConcurrentMap* map);
+ConcurrentReader* concurrentMapReaderNew(ConcurrentMap* map);
+void concurrentMapReaderDelete(ConcurrentReader* reader);
+
+int concurrentMapGet(ConcurrentReader* reader, const char* key, int* value);
+int concurrentMapContainsKey(ConcurrentReader* reader, const char* key);
+void concurrentMapPut(ConcurrentMap* map, const char* key, int value);
+int concurrentMapRemove(ConcurrentMap* map, const char* key);
+int concurrentMapSize(ConcurrentMap* map);
+void concurrentMapReclaim(ConcurrentMap* map);
+
+#endif
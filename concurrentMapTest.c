@@ -0,0 +1,149 @@
+/*
+ * Stress test for the concurrent map.
+ *
+ * Usage: concurrentMapTest
+ *
+ * Reader threads look up a fixed set of stable words, which are never
+ * removed, while one writer keeps adding and removing other words. The
+ * churn fills the table with tombstones and forces rebuilds, and the map
+ * starts small so it also grows. Every lookup of a stable word must succeed
+ * with its value, and a churned word that is found must carry its own value.
+ * Once the readers stop, concurrentMapReclaim must free everything that was
+ * retired. Prints each failed check and exits 1 if there were any.
+ */
+
+#include "concurrentMap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_READERS 4
+#define TEST_STABLE 2000
+#define TEST_CHURN 500
+#define TEST_ROUNDS 200
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+/*
+ * State shared by the readers and the writer.
+ */
+typedef struct Stress
+{
+    ConcurrentMap* map;
+    char stable[TEST_STABLE][16];
+    char churn[TEST_CHURN][16];
+    atomic_int writing;
+    atomic_long lookups;
+    atomic_long missing;
+    atomic_long wrongValues;
+} Stress;
+
+/**
+ * Reader thread: sweeps the stable words, and probes the churned ones, until
+ * the writer is done.
+ */
+static void* readerRun(void* arg)
+{
+    Stress* stress = arg;
+    ConcurrentReader* reader = concurrentMapReaderNew(stress->map);
+    long lookups = 0;
+    long missing = 0;
+    long wrongValues = 0;
+    do {
+        for (int i = 0; i < TEST_STABLE; i++) {
+            int value;
+            if (!concurrentMapGet(reader, stress->stable[i], &value)) {
+                missing++;
+            }
+            else if (value != i) {
+                wrongValues++;
+            }
+        }
+        for (int i = 0; i < TEST_CHURN; i++) {
+            int value;
+            // may or may not be there, but never with another word's value
+            if (concurrentMapGet(reader, stress->churn[i], &value) && value != TEST_STABLE + i) {
+                wrongValues++;
+            }
+        }
+        lookups += TEST_STABLE + TEST_CHURN;
+    } while (atomic_load(&stress->writing));
+    concurrentMapReaderDelete(reader);
+    atomic_fetch_add(&stress->lookups, lookups);
+    atomic_fetch_add(&stress->missing, missing);
+    atomic_fetch_add(&stress->wrongValues, wrongValues);
+    return NULL;
+}
+
+int main(void)
+{
+    Stress* stress = calloc(1, sizeof(Stress));
+    stress->map = concurrentMapNew(16);
+    for (int i = 0; i < TEST_STABLE; i++) {
+        snprintf(stress->stable[i], sizeof(stress->stable[i]), "stable%d", i);
+        concurrentMapPut(stress->map, stress->stable[i], i);
+    }
+    for (int i = 0; i < TEST_CHURN; i++) {
+        snprintf(stress->churn[i], sizeof(stress->churn[i]), "churn%d", i);
+    }
+    atomic_init(&stress->writing, 1);
+
+    pthread_t readers[TEST_READERS];
+    for (int i = 0; i < TEST_READERS; i++) {
+        pthread_create(&readers[i], NULL, readerRun, stress);
+    }
+    long removed = 0;
+    for (int round = 0; round < TEST_ROUNDS; round++) {
+        for (int i = 0; i < TEST_CHURN; i++) {
+            concurrentMapPut(stress->map, stress->churn[i], TEST_STABLE + i);
+        }
+        // rewriting a stable word's value in place must not disturb readers
+        concurrentMapPut(stress->map, stress->stable[round % TEST_STABLE], round % TEST_STABLE);
+        for (int i = 0; i < TEST_CHURN; i++) {
+            removed += concurrentMapRemove(stress->map, stress->churn[i]);
+        }
+    }
+    atomic_store(&stress->writing, 0);
+    for (int i = 0; i < TEST_READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+
+    EXPECT(atomic_load(&stress->lookups) > 0);
+    EXPECT(atomic_load(&stress->missing) == 0);
+    EXPECT(atomic_load(&stress->wrongValues) == 0);
+    EXPECT(removed == (long) TEST_ROUNDS * TEST_CHURN);
+    EXPECT(concurrentMapSize(stress->map) == TEST_STABLE);
+    // every removed entry was retired, and so was each table a rebuild replaced
+    EXPECT(stress->map->retiredCount > removed);
+
+    concurrentMapReclaim(stress->map);
+    EXPECT(stress->map->reclaimedCount == stress->map->retiredCount);
+    EXPECT(stress->map->retired == NULL);
+
+    ConcurrentReader* reader = concurrentMapReaderNew(stress->map);
+    for (int i = 0; i < TEST_STABLE; i++) {
+        EXPECT(concurrentMapContainsKey(reader, stress->stable[i]));
+    }
+    for (int i = 0; i < TEST_CHURN; i++) {
+        EXPECT(!concurrentMapContainsKey(reader, stress->churn[i]));
+    }
+    concurrentMapReaderDelete(reader);
+
+    long lookups = atomic_load(&stress->lookups);
+    concurrentMapDelete(stress->map);
+    free(stress);
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("concurrentMapTest: %ld lookups during %d put/remove rounds, all checks passed\n", lookups, TEST_ROUNDS);
+    return 0;
+}
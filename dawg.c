@@ -0,0 +1,606 @@
+/*
+ * Dictionary as a minimal acyclic automaton, with edit-distance search.
+ */
+
+#include "dawg.h"
+#include "stats.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct BuildEdge BuildEdge;
+typedef struct BuildState BuildState;
+typedef struct Builder Builder;
+typedef struct SearchState SearchState;
+
+struct BuildEdge
+{
+    unsigned char label;
+    int target;
+};
+
+/*
+ * State of the automaton while it is being built.
+ */
+struct BuildState
+{
+    int final;
+    int edgeCount;
+    int edgeCapacity;
+    BuildEdge* edges;
+};
+
+/*
+ * States built so far plus the register of minimized states, an open
+ * addressing table of state indices keyed on each state's edges.
+ */
+struct Builder
+{
+    BuildState* states;
+    int count;
+    int capacity;
+    int* registry;
+    int registryCapacity;
+    int registrySize;
+};
+
+/*
+ * Everything a search carries down the automaton.
+ */
+struct SearchState
+{
+    Dawg* dawg;
+    const char* word;
+    int length;
+    int maxDistance;
+    // Ties can be pruned only while every suggestion came from this search,
+    // which visits words in sorted order, and only once no word can be more
+    // common than the last one kept.
+    int pruneTies;
+    TopK* table;
+    // Row of the distance table for each depth, length + 1 entries each.
+    int* rows;
+    long visited;
+};
+
+/*
+ * A word and its id, sorted together so the comparison needs no context.
+ */
+typedef struct SortedWord
+{
+    const char* word;
+    int id;
+} SortedWord;
+
+/**
+ * Orders words alphabetically, for qsort.
+ */
+static int compareWords(const void* a, const void* b)
+{
+    return strcmp(((const SortedWord*) a)->word, ((const SortedWord*) b)->word);
+}
+
+/**
+ * Appends a state with no edges and returns its index.
+ */
+static int newState(Builder* builder)
+{
+    if (builder->count == builder->capacity) {
+        builder->capacity *= 2;
+        builder->states = realloc(builder->states, sizeof(BuildState) * builder->capacity);
+    }
+    BuildState* state = &builder->states[builder->count];
+    memset(state, 0, sizeof(BuildState));
+    return builder->count++;
+}
+
+/**
+ * Adds an edge after the state's existing ones. Words arrive sorted, so
+ * labels arrive in increasing order.
+ */
+static void addEdge(Builder* builder, int from, unsigned char label, int target)
+{
+    BuildState* state = &builder->states[from];
+    if (state->edgeCount == state->edgeCapacity) {
+        state->edgeCapacity = (state->edgeCapacity == 0) ? 2 : state->edgeCapacity * 2;
+        state->edges = realloc(state->edges, sizeof(BuildEdge) * state->edgeCapacity);
+    }
+    state->edges[state->edgeCount].label = label;
+    state->edges[state->edgeCount].target = target;
+    state->edgeCount++;
+}
+
+/**
+ * Hashes a state by its final flag and edges, whose targets are already
+ * minimized.
+ */
+static uint64_t hashState(BuildState* state)
+{
+    uint64_t r = 14695981039346656037ULL ^ (uint64_t) state->final;
+    for (int i = 0; i < state->edgeCount; i++) {
+        r = (r ^ state->edges[i].label) * 1099511628211ULL;
+        r = (r ^ (uint64_t) state->edges[i].target) * 1099511628211ULL;
+    }
+    return r ^ (r >> 29);
+}
+
+/**
+ * Tells whether two states accept exactly the same suffixes.
+ */
+static int equalStates(BuildState* a, BuildState* b)
+{
+    if (a->final != b->final || a->edgeCount != b->edgeCount) {
+        return 0;
+    }
+    for (int i = 0; i < a->edgeCount; i++) {
+        if (a->edges[i].label != b->edges[i].label || a->edges[i].target != b->edges[i].target) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Returns the registered state equivalent to the given one, registering the
+ * state itself if there is none yet.
+ */
+static int registerState(Builder* builder, int index)
+{
+    if (2 * (builder->registrySize + 1) > builder->registryCapacity) {
+        int* old = builder->registry;
+        int oldCapacity = builder->registryCapacity;
+        builder->registryCapacity *= 2;
+        builder->registry = malloc(sizeof(int) * builder->registryCapacity);
+        memset(builder->registry, -1, sizeof(int) * builder->registryCapacity);
+        for (int i = 0; i < oldCapacity; i++) {
+            if (old[i] >= 0) {
+                int j = (int) (hashState(&builder->states[old[i]]) & (builder->registryCapacity - 1));
+                while (builder->registry[j] >= 0) {
+                    j = (j + 1) & (builder->registryCapacity - 1);
+                }
+                builder->registry[j] = old[i];
+            }
+        }
+        free(old);
+    }
+
+    BuildState* state = &builder->states[index];
+    int mask = builder->registryCapacity - 1;
+    int i = (int) (hashState(state) & mask);
+    while (builder->registry[i] >= 0) {
+        if (equalStates(&builder->states[builder->registry[i]], state)) {
+            return builder->registry[i];
+        }
+        i = (i + 1) & mask;
+    }
+    builder->registry[i] = index;
+    builder->registrySize++;
+    return index;
+}
+
+/**
+ * Minimizes the state reached by the last edge of a state: it is replaced by
+ * an equivalent registered state if there is one, or registered itself.
+ */
+static void replaceOrRegister(Builder* builder, int parent)
+{
+    BuildState* state = &builder->states[parent];
+    BuildEdge* edge = &state->edges[state->edgeCount - 1];
+    int child = edge->target;
+    int canonical = registerState(builder, child);
+    if (canonical != child) {
+        // the child was the newest state, and nothing else points at it
+        edge->target = canonical;
+        free(builder->states[child].edges);
+        builder->states[child].edges = NULL;
+        builder->states[child].edgeCount = 0;
+    }
+}
+
+/**
+ * Counts the words accepted from a state, memoized in counts (-1 = unknown).
+ */
+static int countWords(Builder* builder, int index, int* counts)
+{
+    if (counts[index] >= 0) {
+        return counts[index];
+    }
+    BuildState* state = &builder->states[index];
+    int total = 0;
+    for (int i = 0; i < state->edgeCount; i++) {
+        int target = state->edges[i].target;
+        total += builder->states[target].final + countWords(builder, target, counts);
+    }
+    counts[index] = total;
+    return total;
+}
+
+/**
+ * Builds the minimal automaton accepting every word in a finished candidate
+ * store, using the incremental construction for sorted input (Daciuk et al.):
+ * each word's suffix is added as fresh states, and the previous word's states
+ * that the new word no longer shares are minimized against the register.
+ * @param store
+ * @return The automaton, or NULL if the store is empty or the automaton has
+ * more edges than the packed format can address.
+ */
+Dawg* dawgBuild(CandidateStore* store)
+{
+    assert(store != NULL);
+    if (store->size == 0) {
+        return NULL;
+    }
+
+    SortedWord* sorted = malloc(sizeof(SortedWord) * store->size);
+    int longest = 0;
+    for (int i = 0; i < store->size; i++) {
+        sorted[i].word = candidateStoreWord(store, i);
+        sorted[i].id = i;
+        if (store->lengths[i] > longest) {
+            longest = store->lengths[i];
+        }
+    }
+    qsort(sorted, store->size, sizeof(SortedWord), compareWords);
+    int* ids = malloc(sizeof(int) * store->size);
+    for (int i = 0; i < store->size; i++) {
+        ids[i] = sorted[i].id;
+    }
+    free(sorted);
+
+    Builder builder;
+    builder.capacity = 1024;
+    builder.count = 0;
+    builder.states = malloc(sizeof(BuildState) * builder.capacity);
+    builder.registryCapacity = 1024;
+    builder.registrySize = 0;
+    builder.registry = malloc(sizeof(int) * builder.registryCapacity);
+    memset(builder.registry, -1, sizeof(int) * builder.registryCapacity);
+
+    // path[i] is the state after the first i characters of the previous word
+    int* path = malloc(sizeof(int) * (longest + 1));
+    path[0] = newState(&builder);
+    const char* previous = "";
+    int previousLength = 0;
+    int wordCount = 0;
+    for (int n = 0; n < store->size; n++) {
+        const char* word = candidateStoreWord(store, ids[n]);
+        int length = store->lengths[ids[n]];
+        int prefix = 0;
+        while (prefix < length && prefix < previousLength && word[prefix] == previous[prefix]) {
+            prefix++;
+        }
+        if (length == 0 || (prefix == length && prefix == previousLength)) {
+            continue;
+        }
+        for (int i = previousLength; i > prefix; i--) {
+            replaceOrRegister(&builder, path[i - 1]);
+        }
+        for (int i = prefix; i < length; i++) {
+            int state = newState(&builder);
+            addEdge(&builder, path[i], (unsigned char) word[i], state);
+            path[i + 1] = state;
+        }
+        builder.states[path[length]].final = 1;
+        ids[wordCount++] = ids[n];
+        previous = word;
+        previousLength = length;
+    }
+    for (int i = previousLength; i > 0; i--) {
+        replaceOrRegister(&builder, path[i - 1]);
+    }
+    free(path);
+
+    // give every reachable state with edges a run, breadth first from the root
+    int* runs = malloc(sizeof(int) * builder.count);
+    int* queue = malloc(sizeof(int) * builder.count);
+    for (int i = 0; i < builder.count; i++) {
+        runs[i] = -1;
+    }
+    int head = 0;
+    int tail = 0;
+    int edgeCount = 0;
+    queue[tail++] = 0;
+    runs[0] = 0;
+    edgeCount = builder.states[0].edgeCount;
+    while (head < tail) {
+        BuildState* state = &builder.states[queue[head++]];
+        for (int i = 0; i < state->edgeCount; i++) {
+            int target = state->edges[i].target;
+            if (runs[target] >= 0) {
+                continue;
+            }
+            if (builder.states[target].edgeCount == 0) {
+                runs[target] = 0;
+            }
+            else {
+                runs[target] = edgeCount;
+                edgeCount += builder.states[target].edgeCount;
+            }
+            queue[tail++] = target;
+        }
+    }
+
+    Dawg* dawg = NULL;
+    if ((uint32_t) edgeCount < DAWG_MAX_EDGES) {
+        int* counts = malloc(sizeof(int) * builder.count);
+        for (int i = 0; i < builder.count; i++) {
+            counts[i] = -1;
+        }
+        dawg = calloc(1, sizeof(Dawg));
+        dawg->edges = malloc(sizeof(uint32_t) * edgeCount);
+        dawg->rankBase = malloc(sizeof(uint32_t) * edgeCount);
+        dawg->edgeCount = edgeCount;
+        dawg->stateCount = tail;
+        dawg->words = ids;
+        dawg->wordCount = wordCount;
+        dawg->longest = longest;
+        dawg->store = store;
+        for (int q = 0; q < tail; q++) {
+            BuildState* state = &builder.states[queue[q]];
+            uint32_t rank = 0;
+            for (int i = 0; i < state->edgeCount; i++) {
+                int target = state->edges[i].target;
+                int final = builder.states[target].final;
+                uint32_t edge = state->edges[i].label | ((uint32_t) runs[target] << DAWG_TARGET_SHIFT);
+                edge |= final ? DAWG_FINAL : 0;
+                edge |= (i == state->edgeCount - 1) ? DAWG_LAST : 0;
+                dawg->edges[runs[queue[q]] + i] = edge;
+                dawg->rankBase[runs[queue[q]] + i] = rank;
+                rank += final + countWords(&builder, target, counts);
+            }
+        }
+        free(counts);
+    }
+    else {
+        free(ids);
+    }
+
+    free(queue);
+    free(runs);
+    for (int i = 0; i < builder.count; i++) {
+        free(builder.states[i].edges);
+    }
+    free(builder.states);
+    free(builder.registry);
+    return dawg;
+}
+
+/**
+ * Frees the automaton. The candidate store it refers to is left alone.
+ * @param dawg
+ */
+void dawgDelete(Dawg* dawg)
+{
+    if (dawg == NULL) {
+        return;
+    }
+    free(dawg->edges);
+    free(dawg->rankBase);
+    free(dawg->words);
+    free(dawg);
+}
+
+/**
+ * Returns the position of a word in sorted order, by walking its path.
+ * @param dawg
+ * @param word
+ * @return Rank of the word, or -1 if it is not in the automaton.
+ */
+int dawgRank(Dawg* dawg, const char* word)
+{
+    assert((dawg != NULL) && (word != NULL));
+    if (word[0] == '\0') {
+        return -1;
+    }
+    uint32_t run = 0;
+    int rank = 0;
+    for (int i = 0;; i++) {
+        unsigned char c = word[i];
+        uint32_t e = run;
+        while ((dawg->edges[e] & DAWG_LABEL_MASK) != c) {
+            if (dawg->edges[e] & DAWG_LAST) {
+                return -1;
+            }
+            e++;
+        }
+        uint32_t edge = dawg->edges[e];
+        rank += dawg->rankBase[e];
+        if (word[i + 1] == '\0') {
+            return (edge & DAWG_FINAL) ? rank : -1;
+        }
+        rank += (edge & DAWG_FINAL) != 0;
+        run = edge >> DAWG_TARGET_SHIFT;
+        if (run == 0) {
+            return -1;
+        }
+    }
+}
+
+/**
+ * Returns 1 if the word is in the automaton and 0 otherwise.
+ * @param dawg
+ * @param word
+ * @return 1 if the word is found, 0 otherwise.
+ */
+int dawgContainsKey(Dawg* dawg, const char* word)
+{
+    return dawgRank(dawg, word) >= 0;
+}
+
+/**
+ * Returns the word at a position in sorted order.
+ * @param dawg
+ * @param rank Position below wordCount.
+ * @return Word owned by the candidate store.
+ */
+const char* dawgWord(Dawg* dawg, int rank)
+{
+    assert((dawg != NULL) && (rank >= 0) && (rank < dawg->wordCount));
+    return candidateStoreWord(dawg->store, dawg->words[rank]);
+}
+
+/**
+ * Returns the number of bytes the automaton holds, not counting the candidate
+ * store its words are read from.
+ * @param dawg
+ * @return Bytes allocated.
+ */
+size_t dawgMemoryUsage(Dawg* dawg)
+{
+    assert(dawg != NULL);
+    return sizeof(Dawg) + sizeof(uint32_t) * 2 * (size_t) dawg->edgeCount + sizeof(int) * (size_t) dawg->wordCount;
+}
+
+/**
+ * Returns the largest distance a word may have and still get into the table.
+ */
+static int searchBound(SearchState* search)
+{
+    int bound = topKThreshold(search->table, search->maxDistance);
+    return (bound < search->maxDistance) ? bound : search->maxDistance;
+}
+
+/**
+ * Scores every edge of a run against the row of its parent state, offers the
+ * words that end there and descends into the targets that can still hold a
+ * suggestion.
+ * @param search
+ * @param run First edge of the run.
+ * @param depth Depth of the run's state; its row is rows[depth].
+ * @param rank Rank of the first word below the run's state.
+ */
+static void searchRun(SearchState* search, uint32_t run, int depth, int rank)
+{
+    Dawg* dawg = search->dawg;
+    int m = search->length;
+    const char* word = search->word;
+    const int* parent = search->rows + depth * (m + 1);
+    int* row = search->rows + (depth + 1) * (m + 1);
+    int limit = searchBound(search);
+
+    for (uint32_t e = run;; e++) {
+        uint32_t edge = dawg->edges[e];
+        char c = (char) (edge & DAWG_LABEL_MASK);
+        search->visited++;
+
+        // cells more than limit off the diagonal exceed limit, so only the band
+        // is computed; the cells just outside it hold limit + 1 for the next row
+        int low = (depth + 1 > limit) ? depth + 1 - limit : 0;
+        int high = (depth + 1 + limit < m) ? depth + 1 + limit : m;
+        int rowMin = limit + 1;
+        if (low > 0) {
+            row[low - 1] = limit + 1;
+        }
+        for (int j = low; j <= high; j++) {
+            int best = depth + 1;
+            if (j > 0) {
+                best = parent[j - 1] + (word[j - 1] != c);
+                if (parent[j] + 1 < best) {
+                    best = parent[j] + 1;
+                }
+                if (row[j - 1] + 1 < best) {
+                    best = row[j - 1] + 1;
+                }
+            }
+            row[j] = best;
+            if (best < rowMin) {
+                rowMin = best;
+            }
+        }
+        if (high < m) {
+            row[high + 1] = limit + 1;
+        }
+        STATS_ADD(distanceCells, high - low + 1);
+
+        int wordRank = rank + dawg->rankBase[e];
+        int final = (edge & DAWG_FINAL) != 0;
+        if (final && high == m && low <= m && row[m] <= limit) {
+            int id = dawg->words[wordRank];
+            topKOffer(search->table, candidateStoreWord(dawg->store, id), row[m], dawg->store->frequencies[id]);
+            limit = searchBound(search);
+        }
+
+        // every word below has a distance of at least rowMin; once the table is
+        // full a later word needs a strictly smaller distance than the last one,
+        // unless it can still win the tie on frequency
+        uint32_t target = edge >> DAWG_TARGET_SHIFT;
+        const Suggestion* last = topKLast(search->table);
+        int full = last != NULL && last->frequency >= dawg->store->maxFrequency;
+        int hopeless = rowMin > limit || (search->pruneTies && full && rowMin >= limit);
+        if (target != 0 && !hopeless) {
+            searchRun(search, target, depth + 1, wordRank + final);
+            limit = searchBound(search);
+        }
+        if (edge & DAWG_LAST) {
+            break;
+        }
+    }
+}
+
+/**
+ * Adds the closest words within maxDistance of a word to a suggestion table,
+ * walking the automaton with one distance table row per depth.
+ *
+ * Until the table fills, nothing bounds the walk but maxDistance, and the
+ * first words found in sorted order are rarely close. So an empty table is
+ * filled by walks at limits 1, 2, 3... instead, each cheap while the limit is
+ * small, stopping at the first limit that yields a full table: every word
+ * left out is then farther than every word in it.
+ * @param dawg
+ * @param word
+ * @param length Length of word, at most DISTANCE_MAX_WORD.
+ * @param maxDistance Largest distance to report.
+ * @param table Suggestion table to update.
+ * @return Number of edges scored.
+ */
+long dawgSearch(Dawg* dawg, const char* word, int length, int maxDistance, TopK* table)
+{
+    assert((dawg != NULL) && (word != NULL) && (table != NULL));
+    SearchState search;
+    search.dawg = dawg;
+    search.word = word;
+    search.length = length;
+    search.pruneTies = table->count == 0;
+    search.table = table;
+    search.rows = malloc(sizeof(int) * (dawg->longest + 1) * (length + 1));
+    search.visited = 0;
+    for (int j = 0; j <= length; j++) {
+        search.rows[j] = j;
+    }
+    STATS_ADD(distanceCalls, 1);
+    int limit = search.pruneTies ? 1 : maxDistance;
+    for (;; limit++) {
+        search.maxDistance = (limit < maxDistance) ? limit : maxDistance;
+        searchRun(&search, 0, 0, 0);
+        if (search.maxDistance == maxDistance || topKFull(table)) {
+            break;
+        }
+        topKInit(table, table->k);
+    }
+    free(search.rows);
+    return search.visited;
+}
+
+/**
+ * Fills table with the closest words within maxDistance of a word. When that
+ * yields a full table it is exactly what a full scan would return. Otherwise
+ * table is left untouched and the caller has to fall back to a scan for the
+ * farther words.
+ * @param dawg
+ * @param word
+ * @param length Length of word, at most DISTANCE_MAX_WORD.
+ * @param maxDistance Largest distance to search.
+ * @param table Suggestion table to update.
+ * @return 1 if table was filled, 0 if a full scan is still needed.
+ */
+int dawgSuggest(Dawg* dawg, const char* word, int length, int maxDistance, TopK* table)
+{
+    TopK found;
+    topKInit(&found, table->k);
+    dawgSearch(dawg, word, length, maxDistance, &found);
+    if (!topKFull(&found)) {
+        return 0;
+    }
+    topKMerge(table, &found);
+    return 1;
+}
@@ -0,0 +1,68 @@
+#ifndef DAWG_H
+#define DAWG_H
+
+/*
+ * Dictionary as a minimal acyclic automaton (DAWG).
+ *
+ * Words sharing a prefix share the path that spells it, and words sharing a
+ * suffix share the states after it, so the automaton has far fewer edges
+ * than the dictionary has characters.
+ *
+ * The automaton is packed into one array of 32-bit edges. The outgoing
+ * edges of a state are a run of consecutive entries sorted by label, and the
+ * root's run starts at index 0. Each edge holds:
+ *   bits  0-7   label byte
+ *   bit   8     the word spelled by the path so far ends on this edge
+ *   bit   9     last edge of its run
+ *   bits 10-31  index of the target state's run, 0 for a state with no edges
+ *
+ * Beside each edge is the number of words in the runs before it among its
+ * siblings. Summing these along a path numbers every word by its position in
+ * sorted order, which maps a word found by a search back to its string in the
+ * candidate store.
+ *
+ * dawgSearch walks the automaton depth first and keeps one row of the edit
+ * distance table per depth. Every word sharing a prefix reuses the rows
+ * computed for that prefix, and a branch is dropped once no word below it can
+ * make the suggestion table. dawgSuggest bounds the walk to a small distance,
+ * where it is cheap, and leaves farther words to a scan.
+ */
+
+#include "candidateStore.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define DAWG_LABEL_MASK 0xffu
+#define DAWG_FINAL 0x100u
+#define DAWG_LAST 0x200u
+#define DAWG_TARGET_SHIFT 10
+// Largest edge array the 22-bit target field can address.
+#define DAWG_MAX_EDGES (1u << (32 - DAWG_TARGET_SHIFT))
+#define DAWG_DEFAULT_DISTANCE 2
+
+typedef struct Dawg Dawg;
+
+struct Dawg
+{
+    uint32_t* edges;
+    // Words in the runs of earlier siblings of each edge.
+    uint32_t* rankBase;
+    int edgeCount;
+    int stateCount;
+    // Candidate store id of every word, in sorted order.
+    int* words;
+    int wordCount;
+    int longest;
+    CandidateStore* store;
+};
+
+Dawg* dawgBuild(CandidateStore* store);
+void dawgDelete(Dawg* dawg);
+int dawgRank(Dawg* dawg, const char* word);
+int dawgContainsKey(Dawg* dawg, const char* word);
+const char* dawgWord(Dawg* dawg, int rank);
+size_t dawgMemoryUsage(Dawg* dawg);
+long dawgSearch(Dawg* dawg, const char* word, int length, int maxDistance, TopK* table);
+int dawgSuggest(Dawg* dawg, const char* word, int length, int maxDistance, TopK* table);
+
+#endif
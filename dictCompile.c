@@ -0,0 +1,54 @@
+/*
+ * Offline compiler for dictionary images.
+ *
+ * Usage: dictCompile [dictionary.txt [dictionary.img]]
+ *
+ * Reads a word list the same way spellChecker does and writes a binary image
+ * that spellChecker --image (or any dictImageOpen caller) maps at startup.
+ */
+
+#include "hashMap.h"
+#include "dictionary.h"
+#include "dictImage.h"
+#include <stdio.h>
+#include <time.h>
+
+int main(int argc, const char** argv)
+{
+    const char* textPath = (argc > 1) ? argv[1] : "dictionary.txt";
+    const char* imagePath = (argc > 2) ? argv[2] : "dictionary.img";
+
+    HashMap* map = hashMapNew(1000);
+    if (loadDictionaryParallel(textPath, map, 0) != 0) {
+        fprintf(stderr, "Could not open %s\n", textPath);
+        hashMapDelete(map);
+        return 1;
+    }
+
+    if (dictImageWrite(map, imagePath) != 0) {
+        fprintf(stderr, "Could not write %s\n", imagePath);
+        hashMapDelete(map);
+        return 1;
+    }
+
+    // read the image back and check it answers for every word
+    clock_t timer = clock();
+    DictImage* image = dictImageOpen(imagePath);
+    timer = clock() - timer;
+    int ok = image != NULL && dictImageVerify(image) && dictImageSize(image) == hashMapSize(map);
+    for (int i = 0; ok && i < map->capacity; i++) {
+        if (map->table[i].link != NULL && !dictImageContainsKey(image, map->table[i].link->key)) {
+            ok = 0;
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Image %s failed verification\n", imagePath);
+    }
+    else {
+        printf("Wrote %s: %d words, %zu bytes, opened in %f seconds\n", imagePath,
+               dictImageSize(image), image->length, (float)timer / (float)CLOCKS_PER_SEC);
+    }
+    dictImageClose(image);
+    hashMapDelete(map);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,291 @@
+/*
+ * Prebuilt binary dictionary image: writer, mmap loader and lookups.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "dictImage.h"
+#include "suggestion.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * 64-bit FNV-1a over a byte range, used as the image checksum and by other
+ * on-disk formats.
+ * @param data
+ * @param length
+ * @return Checksum of the range.
+ */
+uint64_t dictImageChecksum(const void* data, size_t length)
+{
+    const unsigned char* bytes = data;
+    uint64_t r = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        r ^= bytes[i];
+        r *= 1099511628211ULL;
+    }
+    return r;
+}
+
+/**
+ * Writes every key in the map to an image file. The image is first written to
+ * path.tmp and renamed into place, so readers never map a partial file.
+ * @param map
+ * @param path
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int dictImageWrite(HashMap* map, const char* path)
+{
+    assert((map != NULL) && (path != NULL));
+    hashMapFinishResize(map);
+
+    // size the pool and an index at half load so misses end quickly
+    uint64_t poolSize = 0;
+    for (int i = 0; i < map->capacity; i++) {
+        if (map->table[i].link != NULL) {
+            poolSize += map->table[i].link->length + 1;
+        }
+    }
+    if (poolSize >= UINT32_MAX) {
+        return -1;
+    }
+    uint32_t slotCount = 8;
+    while (slotCount < 2 * (uint32_t) map->size) {
+        slotCount *= 2;
+    }
+
+    DictImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DICT_IMAGE_MAGIC, sizeof(header.magic));
+    header.version = DICT_IMAGE_VERSION;
+    header.headerSize = sizeof(DictImageHeader);
+    header.hashFunction = 3;
+    header.wordCount = map->size;
+    header.slotCount = slotCount;
+    header.poolOffset = sizeof(DictImageHeader);
+    header.poolSize = poolSize;
+    // keep the index 8-byte aligned after the pool
+    header.indexOffset = (header.poolOffset + poolSize + 7) & ~(uint64_t) 7;
+    header.frequencyOffset = header.indexOffset + sizeof(DictImageSlot) * (uint64_t) slotCount;
+
+    size_t length = header.frequencyOffset + (size_t) map->size;
+    unsigned char* image = calloc(1, length);
+    if (image == NULL) {
+        return -1;
+    }
+    char* pool = (char*) image + header.poolOffset;
+    DictImageSlot* index = (DictImageSlot*) (image + header.indexOffset);
+    uint8_t* frequencies = image + header.frequencyOffset;
+
+    // copy each word into the pool, place it in the index and keep its
+    // frequency class, the map's value
+    uint32_t offset = 0;
+    uint32_t ordinal = 0;
+    uint32_t mask = slotCount - 1;
+    for (int i = 0; i < map->capacity; i++) {
+        HashLink* link = map->table[i].link;
+        if (link == NULL) {
+            continue;
+        }
+        // the image index is always on hashFunction3, whatever the map used
+        uint64_t hash = hashFunction3(link->key);
+        uint32_t s = (uint32_t) hash & mask;
+        while (index[s].offset != 0) {
+            s = (s + 1) & mask;
+        }
+        index[s].tag = (uint32_t) (hash >> 32);
+        index[s].offset = offset + 1;
+        memcpy(pool + offset, link->key, link->length + 1);
+        offset += link->length + 1;
+        int frequency = link->value < 0 ? 0 : link->value;
+        frequencies[ordinal++] = (uint8_t) (frequency < FREQUENCY_CLASS_MAX ? frequency : FREQUENCY_CLASS_MAX);
+    }
+    header.checksum = dictImageChecksum(image + sizeof(DictImageHeader), length - sizeof(DictImageHeader));
+    memcpy(image, &header, sizeof(header));
+
+    // write beside the target and rename over it
+    size_t tmpLength = strlen(path) + 5;
+    char* tmpPath = malloc(tmpLength);
+    snprintf(tmpPath, tmpLength, "%s.tmp", path);
+    FILE* file = fopen(tmpPath, "wb");
+    int ret = -1;
+    if (file != NULL) {
+        size_t written = fwrite(image, 1, length, file);
+        if (fclose(file) == 0 && written == length && rename(tmpPath, path) == 0) {
+            ret = 0;
+        }
+        else {
+            remove(tmpPath);
+        }
+    }
+    free(tmpPath);
+    free(image);
+    return ret;
+}
+
+/**
+ * Maps an image file read-only and checks its header. Only the header is
+ * read here; use dictImageVerify to check the checksum as well.
+ * @param path
+ * @return The opened image, or NULL if the file is missing or not a valid
+ * image of this version.
+ */
+DictImage* dictImageOpen(const char* path)
+{
+    assert(path != NULL);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(DictImageHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file alive on its own
+    close(fd);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    const DictImageHeader* header = base;
+    size_t length = st.st_size;
+    int valid = memcmp(header->magic, DICT_IMAGE_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == DICT_IMAGE_VERSION &&
+                header->headerSize == sizeof(DictImageHeader) &&
+                header->hashFunction == 3 &&
+                header->slotCount != 0 && (header->slotCount & (header->slotCount - 1)) == 0 &&
+                header->wordCount < header->slotCount &&
+                header->poolOffset + header->poolSize <= header->indexOffset &&
+                header->indexOffset % 8 == 0 &&
+                header->indexOffset + sizeof(DictImageSlot) * (uint64_t) header->slotCount == header->frequencyOffset &&
+                header->frequencyOffset + header->wordCount == length &&
+                (header->poolSize == 0 || ((const char*) base)[header->poolOffset + header->poolSize - 1] == '\0');
+    if (!valid) {
+        munmap(base, length);
+        return NULL;
+    }
+
+    DictImage* image = malloc(sizeof(DictImage));
+    image->base = base;
+    image->length = length;
+    image->header = header;
+    image->pool = (const char*) base + header->poolOffset;
+    image->index = (const DictImageSlot*) ((const unsigned char*) base + header->indexOffset);
+    image->frequencies = (const uint8_t*) base + header->frequencyOffset;
+    return image;
+}
+
+/**
+ * Unmaps an image opened with dictImageOpen and frees the handle.
+ * @param image
+ */
+void dictImageClose(DictImage* image)
+{
+    if (image == NULL) {
+        return;
+    }
+    munmap((void*) image->base, image->length);
+    free(image);
+}
+
+/**
+ * Recomputes the image checksum. This touches every page of the image, so it
+ * is kept out of dictImageOpen.
+ * @param image
+ * @return 1 if the checksum matches, 0 otherwise.
+ */
+int dictImageVerify(DictImage* image)
+{
+    assert(image != NULL);
+    return dictImageChecksum(image->base + sizeof(DictImageHeader), image->length - sizeof(DictImageHeader)) ==
+           image->header->checksum;
+}
+
+/**
+ * Returns 1 if the word is in the image and 0 otherwise. Works directly on the
+ * mapped index and pool; nothing is allocated.
+ * @param image
+ * @param key
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int dictImageContainsKey(DictImage* image, const char* key)
+{
+    assert((image != NULL) && (key != NULL));
+
+    uint64_t hash = hashFunction3(key);
+    uint32_t tag = (uint32_t) (hash >> 32);
+    uint32_t mask = image->header->slotCount - 1;
+    uint32_t s = (uint32_t) hash & mask;
+    // a sound image always has an empty slot to stop at; the cap keeps a
+    // corrupt one with none from looping forever
+    for (uint32_t probes = 0; probes < image->header->slotCount && image->index[s].offset != 0; probes++) {
+        if (image->index[s].tag == tag &&
+            image->index[s].offset <= image->header->poolSize &&
+            strcmp(image->pool + image->index[s].offset - 1, key) == 0) {
+            return 1;
+        }
+        s = (s + 1) & mask;
+    }
+    return 0;
+}
+
+/**
+ * Returns the number of words in the image.
+ * @param image
+ * @return Number of words.
+ */
+int dictImageSize(DictImage* image)
+{
+    assert(image != NULL);
+    return (int) image->header->wordCount;
+}
+
+/**
+ * Returns the first word of the string pool, or NULL if the image is empty.
+ * Together with dictImageNextWord this walks every word in pool order.
+ * @param image
+ * @return First word.
+ */
+const char* dictImageFirstWord(DictImage* image)
+{
+    assert(image != NULL);
+    return image->header->poolSize > 0 ? image->pool : NULL;
+}
+
+/**
+ * Returns the word following the given one in the string pool, or NULL after
+ * the last word. The pool is not checked against wordCount when the image is
+ * opened, so a walk that also reads frequencies must stop after
+ * dictImageSize words as well.
+ * @param image
+ * @param word A word returned by dictImageFirstWord or dictImageNextWord.
+ * @return Next word or NULL.
+ */
+const char* dictImageNextWord(DictImage* image, const char* word)
+{
+    assert((image != NULL) && (word != NULL));
+    const char* next = word + strlen(word) + 1;
+    return next < image->pool + image->header->poolSize ? next : NULL;
+}
+
+/**
+ * Returns the frequency class of a word, given its position in pool order:
+ * 0 for the word dictImageFirstWord returns, 1 for the next and so on.
+ * @param image
+ * @param ordinal
+ * @return Frequency class, 0 if the word was listed without a count.
+ */
+int dictImageFrequency(DictImage* image, int ordinal)
+{
+    assert((image != NULL) && (ordinal >= 0) && ((uint32_t) ordinal < image->header->wordCount));
+    return image->frequencies[ordinal];
+}
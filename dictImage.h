@@ -0,0 +1,80 @@
+#ifndef DICT_IMAGE_H
+#define DICT_IMAGE_H
+
+/*
+ * Prebuilt binary dictionary image.
+ *
+ * dictCompile turns a word list into an image file once; programs then map
+ * it read-only with dictImageOpen and look words up in place. The mapping is
+ * shared, so every process using the same image shares one copy in the page
+ * cache, and opening it costs a few system calls instead of a text parse.
+ *
+ * Layout (native byte order, all offsets relative to the start of the file):
+ *   DictImageHeader
+ *   string pool   wordCount null-terminated words, back to back
+ *   index         slotCount DictImageSlots, open addressing on hashFunction3
+ *   frequencies   wordCount bytes, the frequency class of each word in pool order
+ * The checksum is 64-bit FNV-1a over every byte after the header.
+ */
+
+#include "hashMap.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define DICT_IMAGE_MAGIC "SPELLDIC"
+#define DICT_IMAGE_VERSION 2
+
+typedef struct DictImage DictImage;
+typedef struct DictImageHeader DictImageHeader;
+typedef struct DictImageSlot DictImageSlot;
+
+struct DictImageHeader
+{
+    char magic[8];
+    uint32_t version;
+    // Size of this header, so readers can skip fields added later.
+    uint32_t headerSize;
+    // 3 for hashFunction3; images built on another hash are rejected.
+    uint32_t hashFunction;
+    uint32_t wordCount;
+    // Number of index slots, a power of two.
+    uint32_t slotCount;
+    uint32_t reserved;
+    uint64_t poolOffset;
+    uint64_t poolSize;
+    uint64_t indexOffset;
+    uint64_t frequencyOffset;
+    uint64_t checksum;
+};
+
+struct DictImageSlot
+{
+    // Upper half of the key's hash, as in HashSlot.
+    uint32_t tag;
+    // Offset of the word in the string pool plus one; zero marks an empty slot.
+    uint32_t offset;
+};
+
+struct DictImage
+{
+    // Whole file as mapped.
+    const unsigned char* base;
+    size_t length;
+    const DictImageHeader* header;
+    const char* pool;
+    const DictImageSlot* index;
+    const uint8_t* frequencies;
+};
+
+uint64_t dictImageChecksum(const void* data, size_t length);
+int dictImageWrite(HashMap* map, const char* path);
+DictImage* dictImageOpen(const char* path);
+void dictImageClose(DictImage* image);
+int dictImageVerify(DictImage* image);
+int dictImageContainsKey(DictImage* image, const char* key);
+int dictImageSize(DictImage* image);
+const char* dictImageFirstWord(DictImage* image);
+const char* dictImageNextWord(DictImage* image, const char* word);
+int dictImageFrequency(DictImage* image, int ordinal);
+
+#endif
@@ -0,0 +1,321 @@
+/*
+ * A shared base dictionary with small per-tenant overlays.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "dictOverlay.h"
+#include "dictionary.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Indexes the words of a finished candidate store so overlays can find them
+ * by name. The store is not copied and must outlive the base.
+ * @param store A finished store of distinct words.
+ * @return The base.
+ */
+DictBase* dictBaseNew(CandidateStore* store)
+{
+    assert(store != NULL);
+    DictBase* base = malloc(sizeof(DictBase));
+    base->store = store;
+    base->ids = hashMapNew(store->size > 0 ? store->size : 1);
+
+    char** words = malloc(sizeof(char*) * (store->size > 0 ? store->size : 1));
+    int* ids = malloc(sizeof(int) * (store->size > 0 ? store->size : 1));
+    for (int id = 0; id < store->size; id++) {
+        words[id] = store->pool + store->offsets[id];
+        ids[id] = id;
+    }
+    hashMapPutAll(base->ids, words, ids, store->size, 1);
+    free(words);
+    free(ids);
+    return base;
+}
+
+/**
+ * Frees the base's index. Every overlay on it must be deleted first.
+ * @param base
+ */
+void dictBaseDelete(DictBase* base)
+{
+    if (base == NULL) {
+        return;
+    }
+    hashMapDelete(base->ids);
+    free(base);
+}
+
+/**
+ * Returns the candidate store id of a base word.
+ * @param base
+ * @param word
+ * @return The id, or -1 if the base does not have the word.
+ */
+int dictBaseId(DictBase* base, const char* word)
+{
+    int* id = hashMapGet(base->ids, word);
+    return (id == NULL) ? -1 : *id;
+}
+
+/**
+ * Creates an overlay with no changes, showing exactly the base.
+ * @param base
+ * @return The overlay.
+ */
+DictOverlay* dictOverlayNew(DictBase* base)
+{
+    assert(base != NULL);
+    DictOverlay* overlay = calloc(1, sizeof(DictOverlay));
+    overlay->base = base;
+    overlay->added = hashMapNew(16);
+    return overlay;
+}
+
+/**
+ * Frees the overlay. The base is left alone.
+ * @param overlay
+ */
+void dictOverlayDelete(DictOverlay* overlay)
+{
+    if (overlay == NULL) {
+        return;
+    }
+    hashMapDelete(overlay->added);
+    candidateStoreDelete(overlay->store);
+    free(overlay->hiddenIds);
+    free(overlay);
+}
+
+/**
+ * Returns the position of id in the overlay's hidden ids, or where it would
+ * be inserted if it is not there; found is set to whether it is.
+ */
+static int hiddenPosition(DictOverlay* overlay, int id, int* found)
+{
+    int lo = 0;
+    int hi = overlay->hiddenCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (overlay->hiddenIds[mid] < id) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    *found = (lo < overlay->hiddenCount && overlay->hiddenIds[lo] == id);
+    return lo;
+}
+
+/**
+ * Adds a word for this overlay only. A base word the overlay had removed is
+ * shown again, with the frequency class the base gives it; a base word that
+ * is already shown is left as it is.
+ * @param overlay
+ * @param word
+ * @param frequency Frequency class of the word.
+ */
+void dictOverlayAdd(DictOverlay* overlay, const char* word, int frequency)
+{
+    int id = dictBaseId(overlay->base, word);
+    if (id < 0) {
+        hashMapPut(overlay->added, word, frequency);
+        return;
+    }
+    int found;
+    int at = hiddenPosition(overlay, id, &found);
+    if (found) {
+        memmove(overlay->hiddenIds + at, overlay->hiddenIds + at + 1,
+                sizeof(int) * (overlay->hiddenCount - at - 1));
+        overlay->hiddenCount--;
+    }
+}
+
+/**
+ * Removes a word for this overlay only, whether the overlay added it or the
+ * base has it. Removing a word that is not shown does nothing.
+ * @param overlay
+ * @param word
+ */
+void dictOverlayRemove(DictOverlay* overlay, const char* word)
+{
+    hashMapRemove(overlay->added, word);
+    int id = dictBaseId(overlay->base, word);
+    if (id < 0) {
+        return;
+    }
+    int found;
+    int at = hiddenPosition(overlay, id, &found);
+    if (found) {
+        return;
+    }
+    if (overlay->hiddenCount == overlay->hiddenCapacity) {
+        overlay->hiddenCapacity = overlay->hiddenCapacity * 2 + 16;
+        overlay->hiddenIds = realloc(overlay->hiddenIds, sizeof(int) * overlay->hiddenCapacity);
+    }
+    memmove(overlay->hiddenIds + at + 1, overlay->hiddenIds + at, sizeof(int) * (overlay->hiddenCount - at));
+    overlay->hiddenIds[at] = id;
+    overlay->hiddenCount++;
+}
+
+/**
+ * Applies a tenant word list to the overlay. Each line holds one word, read
+ * like a dictionary line ("word" or "word 1234") and added, or a word with a
+ * leading '-', which is removed. Lines are applied in order, so a later line
+ * wins over an earlier one for the same word; blank lines are skipped.
+ * @param overlay
+ * @param path
+ * @return Number of lines applied, or -1 if the file cannot be read.
+ */
+int dictOverlayLoad(DictOverlay* overlay, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    char* line = NULL;
+    size_t lineCapacity = 0;
+    int applied = 0;
+    while (getline(&line, &lineCapacity, file) != -1) {
+        char* p = line;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        int removing = (*p == '-');
+        if (removing) {
+            p++;
+        }
+        char* word = p;
+        while (isWordCharacter((unsigned char) *p)) {
+            p++;
+        }
+        if (p == word) {
+            continue;
+        }
+        char after = *p;
+        *p++ = '\0';
+        if (removing) {
+            dictOverlayRemove(overlay, word);
+        }
+        else {
+            int frequency = 0;
+            if (after == ' ' || after == '\t') {
+                char* end;
+                unsigned long long count = strtoull(p, &end, 10);
+                if (end != p) {
+                    frequency = frequencyClass(count);
+                }
+            }
+            dictOverlayAdd(overlay, word, frequency);
+        }
+        applied++;
+    }
+    free(line);
+    fclose(file);
+    return applied;
+}
+
+/**
+ * Returns 1 if the word is in the dictionary as this overlay shows it.
+ * @param overlay
+ * @param word
+ * @return 1 if the word is found, 0 otherwise.
+ */
+int dictOverlayContainsKey(DictOverlay* overlay, const char* word)
+{
+    if (hashMapSize(overlay->added) > 0 && hashMapContainsKey(overlay->added, word)) {
+        return 1;
+    }
+    int id = dictBaseId(overlay->base, word);
+    if (id < 0) {
+        return 0;
+    }
+    int found;
+    hiddenPosition(overlay, id, &found);
+    return !found;
+}
+
+/**
+ * Returns the bytes a candidate store has allocated.
+ */
+static size_t storeMemoryUsage(CandidateStore* store)
+{
+    if (store == NULL) {
+        return 0;
+    }
+    size_t bytes = sizeof(CandidateStore) + store->poolCapacity + (size_t) store->capacity * (2 * sizeof(int) + 1);
+    for (int n = 0; n <= CANDIDATE_MAX_LENGTH; n++) {
+        bytes += (size_t) store->buckets[n].blockCount * CANDIDATE_LANES * (n + sizeof(int));
+    }
+    return bytes + sizeof(int) * store->longCount;
+}
+
+/**
+ * Returns the bytes this overlay holds on top of its base.
+ * @param overlay
+ * @return Memory usage in bytes.
+ */
+size_t dictOverlayMemoryUsage(DictOverlay* overlay)
+{
+    return sizeof(DictOverlay) + hashMapMemoryUsage(overlay->added) + storeMemoryUsage(overlay->store) +
+           sizeof(int) * overlay->hiddenCapacity;
+}
+
+/**
+ * Rebuilds the candidate store of the added words if they changed since it
+ * was built.
+ */
+static void refreshStore(DictOverlay* overlay)
+{
+    HashMap* added = overlay->added;
+    if (overlay->store != NULL && overlay->storeVersion == added->version) {
+        return;
+    }
+    candidateStoreDelete(overlay->store);
+    overlay->store = candidateStoreNew();
+    hashMapFinishResize(added);
+    for (int i = 0; i < added->capacity; i++) {
+        HashLink* link = added->table[i].link;
+        if (link != NULL) {
+            candidateStoreAdd(overlay->store, link->key, link->length, link->value);
+        }
+    }
+    candidateStoreFinish(overlay->store);
+    overlay->storeVersion = added->version;
+}
+
+/**
+ * Keeps the closest words to the query, as this overlay shows the
+ * dictionary, in table. The added words are scanned first, then the base
+ * store with the removed words hidden, either alone or on a search pool.
+ * @param overlay
+ * @param query Prepared query; its hidden ids are set during the base scan
+ * and cleared again afterwards.
+ * @param pool Search pool over the base's store, or NULL to scan on the
+ * calling thread.
+ * @param table Suggestion table to update.
+ */
+void dictOverlaySuggest(DictOverlay* overlay, DistanceQuery* query, SearchPool* pool, TopK* table)
+{
+    assert((overlay != NULL) && (query != NULL) && (table != NULL));
+    assert((pool == NULL) || (pool->store == overlay->base->store));
+
+    if (hashMapSize(overlay->added) > 0) {
+        refreshStore(overlay);
+        candidateStoreScan(overlay->store, query, table);
+    }
+    query->hiddenIds = overlay->hiddenIds;
+    query->hiddenCount = overlay->hiddenCount;
+    if (pool != NULL) {
+        searchPoolScan(pool, query, table);
+    }
+    else {
+        candidateStoreScan(overlay->base->store, query, table);
+    }
+    query->hiddenIds = NULL;
+    query->hiddenCount = 0;
+}
@@ -0,0 +1,69 @@
+#ifndef DICT_OVERLAY_H
+#define DICT_OVERLAY_H
+
+/*
+ * A shared base dictionary with small per-tenant overlays.
+ *
+ * The base is one finished candidate store plus an index from each of its
+ * words to its id. It is built once and never written again, so any number
+ * of overlays and threads can read it at once.
+ *
+ * An overlay holds one tenant's changes to the base:
+ *   added   words the base lacks, with their frequency classes, in a small
+ *           hash map and, for suggestions, a candidate store of their own
+ *   hidden  sorted ids of base words the tenant removed
+ * A lookup checks the added words, then the base, skipping hidden words.
+ * Suggestions scan the added words and then the base store with the hidden
+ * ids left out, into the same table, so the two layers merge as if they were
+ * one dictionary. An overlay costs memory in proportion to its own changes,
+ * whatever the size of the base.
+ *
+ * An overlay is used by one thread at a time: dictOverlaySuggest rebuilds
+ * the added words' candidate store after they change.
+ */
+
+#include "candidateStore.h"
+#include "hashMap.h"
+#include "searchPool.h"
+#include <stddef.h>
+
+typedef struct DictBase DictBase;
+typedef struct DictOverlay DictOverlay;
+
+struct DictBase
+{
+    // Not owned; must outlive the base.
+    CandidateStore* store;
+    // Word to candidate store id.
+    HashMap* ids;
+};
+
+struct DictOverlay
+{
+    DictBase* base;
+    // Added word to frequency class. Never holds a word the base shows.
+    HashMap* added;
+    // Candidate store of the added words, NULL until a suggestion needs it,
+    // and the version of added it was built from.
+    CandidateStore* store;
+    unsigned long storeVersion;
+    // Base ids removed by this overlay, sorted.
+    int* hiddenIds;
+    int hiddenCount;
+    int hiddenCapacity;
+};
+
+DictBase* dictBaseNew(CandidateStore* store);
+void dictBaseDelete(DictBase* base);
+int dictBaseId(DictBase* base, const char* word);
+
+DictOverlay* dictOverlayNew(DictBase* base);
+void dictOverlayDelete(DictOverlay* overlay);
+void dictOverlayAdd(DictOverlay* overlay, const char* word, int frequency);
+void dictOverlayRemove(DictOverlay* overlay, const char* word);
+int dictOverlayLoad(DictOverlay* overlay, const char* path);
+int dictOverlayContainsKey(DictOverlay* overlay, const char* word);
+size_t dictOverlayMemoryUsage(DictOverlay* overlay);
+void dictOverlaySuggest(DictOverlay* overlay, DistanceQuery* query, SearchPool* pool, TopK* table);
+
+#endif
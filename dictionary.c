@@ -0,0 +1,329 @@
+/*
+ * CS 261 Data Structures
+ * SpellChecker
+ * Name: Dipan Patel (pateldip@oregonstate.edu)
+ * Date: 2020 Mar. 7
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "dictionary.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Tells whether a character can be part of a word: letters, digits and the
+ * apostrophe.
+ * @param c
+ * @return 1 for a word character, 0 otherwise.
+ */
+int isWordCharacter(int c)
+{
+    return (c >= '0' && c <= '9') ||
+           (c >= 'A' && c <= 'Z') ||
+           (c >= 'a' && c <= 'z') ||
+           c == '\'';
+}
+
+/**
+ * Allocates a string for the next word in the file and returns it. This string
+ * is null terminated. Returns NULL after reaching the end of the file.
+ * @param file
+ * @return Allocated string or NULL.
+ */
+char* nextWord(FILE* file)
+{
+    int maxLength = 16;
+    int length = 0;
+    char* word = malloc(sizeof(char) * maxLength);
+    while (1)
+    {
+        char c = fgetc(file);
+        if (isWordCharacter(c))
+        {
+            if (length + 1 >= maxLength)
+            {
+                maxLength *= 2;
+                word = realloc(word, maxLength);
+            }
+            word[length] = c;
+            length++;
+        }
+        else if (length > 0 || c == EOF)
+        {
+            break;
+        }
+    }
+    if (length == 0)
+    {
+        free(word);
+        return NULL;
+    }
+    word[length] = '\0';
+    return word;
+}
+
+/**
+ * Quantizes a word's count to the frequency class kept in the dictionary:
+ * 0 for no count, otherwise 1 + 4 floor(log2 count) plus the two bits below
+ * the count's leading one, so each class is about a quarter of a doubling
+ * and a byte covers any count.
+ * @param count
+ * @return Frequency class, 0 to FREQUENCY_CLASS_MAX.
+ */
+int frequencyClass(unsigned long long count)
+{
+    if (count == 0) {
+        return 0;
+    }
+    int leading = 63 - __builtin_clzll(count);
+    int quarter = (leading >= 2) ? (int) (count >> (leading - 2)) & 3 : (int) (count << (2 - leading)) & 3;
+    int frequency = 1 + 4 * leading + quarter;
+    return (frequency < FREQUENCY_CLASS_MAX) ? frequency : FREQUENCY_CLASS_MAX;
+}
+
+/*
+ * One chunk of a dictionary being loaded. Chunks start and end on line
+ * boundaries, so no entry is split between two.
+ */
+typedef struct DictionaryChunk DictionaryChunk;
+
+struct DictionaryChunk
+{
+    char* text;
+    size_t begin;
+    size_t end;
+    // Words found in the chunk, pointing into text, and their frequency
+    // classes.
+    char** words;
+    int* frequencies;
+    int count;
+    int capacity;
+};
+
+/**
+ * Splits a chunk into words in place: the character after each word is
+ * overwritten with a terminator, so the words need no copies. A run of digits
+ * following a word on the same line, after spaces or tabs, is that word's
+ * count rather than a word of its own, so lines may read "word" or
+ * "word count".
+ * @param arg The chunk.
+ * @return NULL.
+ */
+static void* tokenizeChunk(void* arg)
+{
+    DictionaryChunk* chunk = arg;
+    char* text = chunk->text;
+    size_t i = chunk->begin;
+    while (i < chunk->end) {
+        while (i < chunk->end && !isWordCharacter((unsigned char) text[i])) {
+            i++;
+        }
+        if (i == chunk->end) {
+            break;
+        }
+        size_t start = i;
+        while (i < chunk->end && isWordCharacter((unsigned char) text[i])) {
+            i++;
+        }
+        // the last chunk ends at the buffer's spare byte, so there is always
+        // room for the terminator
+        char after = text[i];
+        text[i] = '\0';
+        i++;
+
+        int frequency = 0;
+        if (after == ' ' || after == '\t') {
+            size_t j = i;
+            while (j < chunk->end && (text[j] == ' ' || text[j] == '\t')) {
+                j++;
+            }
+            size_t digits = j;
+            unsigned long long count = 0;
+            while (j < chunk->end && text[j] >= '0' && text[j] <= '9') {
+                count = (count < ULLONG_MAX / 10) ? count * 10 + (unsigned) (text[j] - '0') : ULLONG_MAX;
+                j++;
+            }
+            if (j > digits && (j == chunk->end || !isWordCharacter((unsigned char) text[j]))) {
+                frequency = frequencyClass(count);
+                i = j;
+            }
+        }
+        if (chunk->count == chunk->capacity) {
+            chunk->capacity = chunk->capacity * 2 + 256;
+            chunk->words = realloc(chunk->words, sizeof(char*) * chunk->capacity);
+            chunk->frequencies = realloc(chunk->frequencies, sizeof(int) * chunk->capacity);
+        }
+        chunk->words[chunk->count] = text + start;
+        chunk->frequencies[chunk->count++] = frequency;
+    }
+    return NULL;
+}
+
+/**
+ * Reads a whole file into a buffer with one spare byte at the end.
+ * @param path
+ * @param size Receives the file's size.
+ * @return Allocated buffer, or NULL if the file cannot be read.
+ */
+static char* readWholeFile(const char* path, size_t* size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return NULL;
+    }
+    char* text = malloc((size_t) info.st_size + 1);
+    size_t length = 0;
+    while (text != NULL && length < (size_t) info.st_size) {
+        ssize_t got = read(fd, text + length, (size_t) info.st_size - length);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        length += (size_t) got;
+    }
+    close(fd);
+    if (text != NULL && length < (size_t) info.st_size) {
+        free(text);
+        return NULL;
+    }
+    *size = length;
+    return text;
+}
+
+/**
+ * Loads the contents of the file into the hash map, one word at a time. Each
+ * word's value is its frequency class, 0 for words listed without a count.
+ * @param file
+ * @param map
+ */
+void loadDictionary(FILE* file, HashMap* map)
+{
+    /* ensure arguments are valid */
+    assert((file != NULL) && (map != NULL));
+
+    // read the rest of the file, keeping a spare byte for tokenizeChunk
+    size_t size = 0;
+    size_t capacity = 64 * 1024;
+    char* text = malloc(capacity);
+    size_t got;
+    while ((got = fread(text + size, 1, capacity - size - 1, file)) > 0) {
+        size += got;
+        if (size + 1 == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+    }
+    text[size] = '\0';
+
+    DictionaryChunk chunk = { text, 0, size, NULL, NULL, 0, 0 };
+    tokenizeChunk(&chunk);
+    for (int i = 0; i < chunk.count; i++) {
+        hashMapPut(map, chunk.words[i], chunk.frequencies[i]);
+    }
+    free(chunk.words);
+    free(chunk.frequencies);
+    free(text);
+}
+
+/**
+ * Loads a dictionary file into an empty map on up to threadCount threads.
+ * The file is read once, split into chunks at line boundaries and each chunk
+ * is tokenized on a thread of its own; the words are then handed to
+ * hashMapPutAll, which sizes the table for all of them up front and builds it
+ * in parallel. Words and counts are read exactly as loadDictionary reads
+ * them.
+ * @param path
+ * @param map
+ * @param threadCount Threads to use, counting the calling one; 0 for one per
+ * CPU.
+ * @return 0 on success, -1 if the file cannot be read.
+ */
+int loadDictionaryParallel(const char* path, HashMap* map, int threadCount)
+{
+    /* ensure arguments are valid */
+    assert((path != NULL) && (map != NULL));
+
+    size_t size;
+    char* text = readWholeFile(path, &size);
+    if (text == NULL) {
+        return -1;
+    }
+    text[size] = '\0';
+
+    if (threadCount <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cpus > 0 ? (int) cpus : 1;
+    }
+    // chunks of at least DICTIONARY_CHUNK_MIN bytes, so small files stay on
+    // one thread
+    if (threadCount > (int) (size / DICTIONARY_CHUNK_MIN) + 1) {
+        threadCount = (int) (size / DICTIONARY_CHUNK_MIN) + 1;
+    }
+    if (threadCount < 1) {
+        threadCount = 1;
+    }
+    DictionaryChunk* chunks = calloc(threadCount, sizeof(DictionaryChunk));
+    size_t begin = 0;
+    for (int c = 0; c < threadCount; c++) {
+        // move each cut forward to just past the next newline
+        size_t end = size;
+        if (c < threadCount - 1) {
+            end = size / threadCount * (c + 1);
+            end = (end < begin) ? begin : end;
+            char* newline = memchr(text + end, '\n', size - end);
+            end = (newline != NULL) ? (size_t) (newline - text) + 1 : size;
+        }
+        chunks[c].text = text;
+        chunks[c].begin = begin;
+        chunks[c].end = end;
+        begin = end;
+    }
+    pthread_t* threads = malloc(sizeof(pthread_t) * threadCount);
+    for (int c = 1; c < threadCount; c++) {
+        pthread_create(&threads[c], NULL, tokenizeChunk, &chunks[c]);
+    }
+    tokenizeChunk(&chunks[0]);
+    for (int c = 1; c < threadCount; c++) {
+        pthread_join(threads[c], NULL);
+    }
+    free(threads);
+
+    // gather the words in file order
+    int count = 0;
+    for (int c = 0; c < threadCount; c++) {
+        count += chunks[c].count;
+    }
+    char** words = malloc(sizeof(char*) * (count > 0 ? count : 1));
+    int* frequencies = malloc(sizeof(int) * (count > 0 ? count : 1));
+    int next = 0;
+    for (int c = 0; c < threadCount; c++) {
+        memcpy(words + next, chunks[c].words, sizeof(char*) * chunks[c].count);
+        memcpy(frequencies + next, chunks[c].frequencies, sizeof(int) * chunks[c].count);
+        next += chunks[c].count;
+        free(chunks[c].words);
+        free(chunks[c].frequencies);
+    }
+    free(chunks);
+
+    hashMapPutAll(map, words, frequencies, count, threadCount);
+    free(frequencies);
+    free(words);
+    free(text);
+    return 0;
+}
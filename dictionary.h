@@ -0,0 +1,25 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+/*
+ * Reading words out of dictionary and document text files.
+ *
+ * A dictionary lists one word per line, optionally followed by how often the
+ * word occurs ("word 1234"). Counts are kept in the map as frequency classes,
+ * which rank equally close suggestions.
+ */
+
+#include "hashMap.h"
+#include "suggestion.h"
+#include <stdio.h>
+
+// Smallest chunk loadDictionaryParallel gives a thread of its own.
+#define DICTIONARY_CHUNK_MIN (256 * 1024)
+
+int isWordCharacter(int c);
+int frequencyClass(unsigned long long count);
+char* nextWord(FILE* file);
+void loadDictionary(FILE* file, HashMap* map);
+int loadDictionaryParallel(const char* path, HashMap* map, int threadCount);
+
+#endif
@@ -0,0 +1,407 @@
+/**
+ * CS 261 Data Structures
+ * SpellChecker
+ * Name: Dipan Patel (pateldip@oregonstate.edu)
+ * Date: 2020 Mar. 7
+ */
+
+#include "distance.h"
+#include "stats.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * SOURCES:
+ * https://en.wikipedia.org/wiki/Levenshtein_distance#cite_note-5
+ * I ended up taking the pseudocode from the Wikipedia article and building the following from that.
+ *
+ * Unbounded Levenshtein distance between s and t. Uses two rows on the stack
+ * for words up to DISTANCE_MAX_WORD characters and only allocates beyond that.
+ */
+int levDistance(const char* s, const char* t) {
+    // get length of each string
+    int lenS = strlen(s);
+    int lenT = strlen(t);
+
+    int stackRows[2 * (DISTANCE_MAX_WORD + 1)];
+    int * rows = (lenT <= DISTANCE_MAX_WORD) ? stackRows : malloc(2 * (lenT + 1) * sizeof(int));
+    int ret = levDistanceBounded(s, lenS, t, lenT, lenS + lenT, rows);
+    if (rows != stackRows) {
+        free(rows);
+    }
+    return ret;
+}
+
+/**
+ * Levenshtein distance between s and t, giving up once it is known to be
+ * larger than maxDistance.
+ *
+ * Only two rows of the matrix are kept, in the caller's rows buffer, and only
+ * the diagonal band |i - j| <= maxDistance is filled since any cell outside it
+ * already costs more than the bound. The scan stops early when the length
+ * difference alone exceeds the bound or when every cell of a row does.
+ *
+ * @param s Dictionary word.
+ * @param lenS Length of s.
+ * @param t Query word.
+ * @param lenT Length of t.
+ * @param maxDistance Largest distance the caller is interested in.
+ * @param rows Scratch space for 2 * (lenT + 1) ints, reused across calls.
+ * @return The distance, or maxDistance + 1 if it is larger than maxDistance.
+ */
+int levDistanceBounded(const char* s, int lenS, const char* t, int lenT, int maxDistance, int* rows)
+{
+    assert((s != NULL) && (t != NULL) && (rows != NULL) && (maxDistance >= 0));
+
+    // the distance never exceeds the longer length, so a bigger bound changes nothing
+    if (maxDistance > lenS + lenT) {
+        maxDistance = lenS + lenT;
+    }
+    int over = maxDistance + 1;
+    STATS_ADD(distanceCalls, 1);
+    if (abs(lenS - lenT) > maxDistance) {
+        STATS_ADD(distanceEarlyExits, 1);
+        return over;
+    }
+
+    int * prev = rows;
+    int * cur = rows + lenT + 1;
+
+    // first row - compare target prefixes to the empty string
+    for (int j = 0; j <= lenT; j++) {
+        prev[j] = (j <= maxDistance) ? j : over;
+    }
+
+    for (int i = 1; i <= lenS; i++) {
+        // only columns within maxDistance of the diagonal can stay in bounds
+        int lo = (i - maxDistance > 1) ? i - maxDistance : 1;
+        int hi = (i + maxDistance < lenT) ? i + maxDistance : lenT;
+        cur[lo - 1] = (lo == 1 && i <= maxDistance) ? i : over;
+        STATS_ADD(distanceCells, hi - lo + 1);
+        int rowMin = cur[lo - 1];
+        char c = s[i - 1];
+
+        for (int j = lo; j <= hi; j++) {
+            // Option C: Substitute Character (only costs 1 if not matching)
+            int best = prev[j - 1] + (c != t[j - 1]);
+            // Option A: Delete character
+            int a = prev[j] + 1;
+            // Option B: Add character (by deleting from target)
+            int b = cur[j - 1] + 1;
+            if (a < best) {
+                best = a;
+            }
+            if (b < best) {
+                best = b;
+            }
+            if (best > over) {
+                best = over;
+            }
+            cur[j] = best;
+            if (best < rowMin) {
+                rowMin = best;
+            }
+        }
+        // the next row's band reaches one column further
+        if (hi < lenT) {
+            cur[hi + 1] = over;
+        }
+        if (rowMin > maxDistance) {
+            STATS_ADD(distanceEarlyExits, 1);
+            return over;
+        }
+
+        int * temp = prev;
+        prev = cur;
+        cur = temp;
+    }
+
+    return prev[lenT] < over ? prev[lenT] : over;
+}
+
+/**
+ * Builds the character masks for a query of at most MYERS_MAX_WORD
+ * characters. Done once per query, then reused for every dictionary word.
+ * @param pattern
+ * @param query
+ * @param length Length of query.
+ */
+void myersPrepare(MyersPattern* pattern, const char* query, int length)
+{
+    assert((pattern != NULL) && (query != NULL) && (length <= MYERS_MAX_WORD));
+
+    memset(pattern->peq, 0, sizeof(pattern->peq));
+    for (int i = 0; i < length; i++) {
+        pattern->peq[(unsigned char) query[i]] |= (uint64_t) 1 << i;
+    }
+    pattern->length = length;
+}
+
+/**
+ * SOURCES:
+ * G. Myers, "A fast bit-vector algorithm for approximate string matching
+ * based on dynamic programming", JACM 1999, with the global-distance variant
+ * from H. Hyyrö, "A bit-vector algorithm for computing Levenshtein and
+ * Damerau edit distances", 2003.
+ *
+ * Levenshtein distance between a prepared query and a word. Each column of
+ * the DP matrix is held as vertical +1/-1 delta bit vectors, so a whole
+ * column costs a handful of word operations instead of one update per cell.
+ * Gives up once the score can no longer come back under maxDistance.
+ *
+ * @param pattern Prepared query.
+ * @param word Dictionary word.
+ * @param length Length of word.
+ * @param maxDistance Largest distance the caller is interested in.
+ * @return The distance, or maxDistance + 1 if it is larger than maxDistance.
+ */
+int myersDistanceBounded(const MyersPattern* pattern, const char* word, int length, int maxDistance)
+{
+    assert((pattern != NULL) && (word != NULL) && (maxDistance >= 0));
+
+    int m = pattern->length;
+    STATS_ADD(distanceCalls, 1);
+    if (abs(m - length) > maxDistance) {
+        STATS_ADD(distanceEarlyExits, 1);
+        return maxDistance + 1;
+    }
+    if (m == 0) {
+        return length;
+    }
+
+    uint64_t last = (uint64_t) 1 << (m - 1);
+    uint64_t pv = ~(uint64_t) 0;
+    uint64_t mv = 0;
+    int score = m;
+
+    for (int j = 0; j < length; j++) {
+        uint64_t eq = pattern->peq[(unsigned char) word[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & last) {
+            score++;
+        }
+        else if (mh & last) {
+            score--;
+        }
+        // row zero grows by one per column for a global distance
+        ph = (ph << 1) | 1;
+        mh = mh << 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+
+        // the last row can drop by at most one per remaining column
+        STATS_ADD(distanceCells, m);
+        if (score - (length - j - 1) > maxDistance) {
+            STATS_ADD(distanceEarlyExits, 1);
+            return maxDistance + 1;
+        }
+    }
+
+    return score <= maxDistance ? score : maxDistance + 1;
+}
+
+/*
+ * QWERTY layout for the keyboard model. Letters of either case map to keys
+ * 1 to 26 and everything else to key 0; bit k of keyboardNeighbors[key] is
+ * set when key k touches it, or is the key itself, so the two cases of a
+ * letter count as neighbours.
+ */
+#define KEY(c) (1 + (c) - 'a')
+
+static const unsigned char keyboardKey[256] = {
+    ['a'] = KEY('a'), ['b'] = KEY('b'), ['c'] = KEY('c'), ['d'] = KEY('d'), ['e'] = KEY('e'), ['f'] = KEY('f'),
+    ['g'] = KEY('g'), ['h'] = KEY('h'), ['i'] = KEY('i'), ['j'] = KEY('j'), ['k'] = KEY('k'), ['l'] = KEY('l'),
+    ['m'] = KEY('m'), ['n'] = KEY('n'), ['o'] = KEY('o'), ['p'] = KEY('p'), ['q'] = KEY('q'), ['r'] = KEY('r'),
+    ['s'] = KEY('s'), ['t'] = KEY('t'), ['u'] = KEY('u'), ['v'] = KEY('v'), ['w'] = KEY('w'), ['x'] = KEY('x'),
+    ['y'] = KEY('y'), ['z'] = KEY('z'),
+    ['A'] = KEY('a'), ['B'] = KEY('b'), ['C'] = KEY('c'), ['D'] = KEY('d'), ['E'] = KEY('e'), ['F'] = KEY('f'),
+    ['G'] = KEY('g'), ['H'] = KEY('h'), ['I'] = KEY('i'), ['J'] = KEY('j'), ['K'] = KEY('k'), ['L'] = KEY('l'),
+    ['M'] = KEY('m'), ['N'] = KEY('n'), ['O'] = KEY('o'), ['P'] = KEY('p'), ['Q'] = KEY('q'), ['R'] = KEY('r'),
+    ['S'] = KEY('s'), ['T'] = KEY('t'), ['U'] = KEY('u'), ['V'] = KEY('v'), ['W'] = KEY('w'), ['X'] = KEY('x'),
+    ['Y'] = KEY('y'), ['Z'] = KEY('z')
+};
+
+#define NEAR(c) (1u << KEY(c))
+
+static const uint32_t keyboardNeighbors[27] = {
+    [KEY('q')] = NEAR('q') | NEAR('w') | NEAR('a'),
+    [KEY('w')] = NEAR('w') | NEAR('q') | NEAR('e') | NEAR('a') | NEAR('s'),
+    [KEY('e')] = NEAR('e') | NEAR('w') | NEAR('r') | NEAR('s') | NEAR('d'),
+    [KEY('r')] = NEAR('r') | NEAR('e') | NEAR('t') | NEAR('d') | NEAR('f'),
+    [KEY('t')] = NEAR('t') | NEAR('r') | NEAR('y') | NEAR('f') | NEAR('g'),
+    [KEY('y')] = NEAR('y') | NEAR('t') | NEAR('u') | NEAR('g') | NEAR('h'),
+    [KEY('u')] = NEAR('u') | NEAR('y') | NEAR('i') | NEAR('h') | NEAR('j'),
+    [KEY('i')] = NEAR('i') | NEAR('u') | NEAR('o') | NEAR('j') | NEAR('k'),
+    [KEY('o')] = NEAR('o') | NEAR('i') | NEAR('p') | NEAR('k') | NEAR('l'),
+    [KEY('p')] = NEAR('p') | NEAR('o') | NEAR('l'),
+    [KEY('a')] = NEAR('a') | NEAR('q') | NEAR('w') | NEAR('s') | NEAR('z'),
+    [KEY('s')] = NEAR('s') | NEAR('w') | NEAR('e') | NEAR('a') | NEAR('d') | NEAR('z') | NEAR('x'),
+    [KEY('d')] = NEAR('d') | NEAR('e') | NEAR('r') | NEAR('s') | NEAR('f') | NEAR('x') | NEAR('c'),
+    [KEY('f')] = NEAR('f') | NEAR('r') | NEAR('t') | NEAR('d') | NEAR('g') | NEAR('c') | NEAR('v'),
+    [KEY('g')] = NEAR('g') | NEAR('t') | NEAR('y') | NEAR('f') | NEAR('h') | NEAR('v') | NEAR('b'),
+    [KEY('h')] = NEAR('h') | NEAR('y') | NEAR('u') | NEAR('g') | NEAR('j') | NEAR('b') | NEAR('n'),
+    [KEY('j')] = NEAR('j') | NEAR('u') | NEAR('i') | NEAR('h') | NEAR('k') | NEAR('n') | NEAR('m'),
+    [KEY('k')] = NEAR('k') | NEAR('i') | NEAR('o') | NEAR('j') | NEAR('l') | NEAR('m'),
+    [KEY('l')] = NEAR('l') | NEAR('o') | NEAR('p') | NEAR('k'),
+    [KEY('z')] = NEAR('z') | NEAR('a') | NEAR('s') | NEAR('x'),
+    [KEY('x')] = NEAR('x') | NEAR('s') | NEAR('d') | NEAR('z') | NEAR('c'),
+    [KEY('c')] = NEAR('c') | NEAR('d') | NEAR('f') | NEAR('x') | NEAR('v'),
+    [KEY('v')] = NEAR('v') | NEAR('f') | NEAR('g') | NEAR('c') | NEAR('b'),
+    [KEY('b')] = NEAR('b') | NEAR('g') | NEAR('h') | NEAR('v') | NEAR('n'),
+    [KEY('n')] = NEAR('n') | NEAR('h') | NEAR('j') | NEAR('b') | NEAR('m'),
+    [KEY('m')] = NEAR('m') | NEAR('j') | NEAR('k') | NEAR('n')
+};
+
+#undef NEAR
+#undef KEY
+
+/**
+ * Returns 1 if two characters are letters on the same or neighbouring keys.
+ */
+static inline int keyboardAdjacent(unsigned char a, unsigned char b)
+{
+    return (int) (keyboardNeighbors[keyboardKey[a]] >> keyboardKey[b]) & 1;
+}
+
+// Optimal string alignment with unit costs.
+#define OSA_KERNEL_NAME osaDistanceBounded
+#define OSA_SUBSTITUTE(a, b) ((a) != (b))
+#define OSA_INDEL 1
+#define OSA_TRANSPOSE 1
+#include "osaKernel.h"
+
+// Optimal string alignment in half edits, with near keys cheap to confuse.
+#define OSA_KERNEL_NAME keyboardDistanceBounded
+#define OSA_SUBSTITUTE(a, b) \
+    (((a) != (b)) * (KEYBOARD_SUBSTITUTE_COST - \
+                     (KEYBOARD_SUBSTITUTE_COST - KEYBOARD_ADJACENT_COST) * keyboardAdjacent((a), (b))))
+#define OSA_INDEL KEYBOARD_INDEL_COST
+#define OSA_TRANSPOSE KEYBOARD_TRANSPOSE_COST
+#include "osaKernel.h"
+
+// Rank of each letter by how common it is in English text, 0 for 'e'.
+static const unsigned char letterRank[26] = {
+    2, 19, 11, 9, 0, 15, 16, 7, 4, 22, 21, 10, 13, 5, 3, 18, 24, 8, 6, 1, 12, 20, 14, 23, 17, 25
+};
+
+/**
+ * Summarizes which characters a word holds in 64 bits, so a scan can rule
+ * words out without running a kernel. Letters are folded to lower case;
+ * bit 63 - r is set when the word holds the letter of rank r at least once
+ * and bit 37 - r when it holds it at least twice. Any other byte c sets bit
+ * c % 12. Common letters take the high bits, so sorting words by signature
+ * groups words that share them.
+ * @param word
+ * @param length Length of word.
+ * @return The signature.
+ */
+uint64_t distanceSignature(const char* word, int length)
+{
+    uint64_t signature = 0;
+    for (int i = 0; i < length; i++) {
+        unsigned char c = (unsigned char) word[i] | 0x20;
+        if (c >= 'a' && c <= 'z') {
+            int rank = letterRank[c - 'a'];
+            uint64_t once = (uint64_t) 1 << (63 - rank);
+            signature |= (signature & once) ? (uint64_t) 1 << (37 - rank) : once;
+        }
+        else {
+            signature |= (uint64_t) 1 << ((unsigned char) word[i] % 12);
+        }
+    }
+    return signature;
+}
+
+/**
+ * Prepares a query for scoring with the given backend. The bit-parallel
+ * backend needs the query to fit in one machine word, so longer queries fall
+ * back to the DP kernel. DISTANCE_SIMD only changes how candidate stores scan
+ * their blocks; single words are still scored with the bit-parallel kernel.
+ * @param query
+ * @param backend Requested backend.
+ * @param word Query word; must stay valid while the query is used.
+ * @param length Length of word.
+ * @return 0 on success, -1 if the word is longer than DISTANCE_MAX_WORD.
+ */
+int distanceQueryInit(DistanceQuery* query, DistanceBackend backend, const char* word, int length)
+{
+    assert((query != NULL) && (word != NULL));
+
+    if (length > DISTANCE_MAX_WORD) {
+        return -1;
+    }
+    query->word = word;
+    query->length = length;
+    query->backend = backend;
+    query->model = DISTANCE_LEVENSHTEIN;
+    query->weighted = NULL;
+    query->indelCost = 1;
+    query->signature = distanceSignature(word, length);
+    query->signatureCost = 1;
+    query->hiddenIds = NULL;
+    query->hiddenCount = 0;
+    query->useMyers = (backend != DISTANCE_DP && length <= MYERS_MAX_WORD);
+    if (query->useMyers) {
+        myersPrepare(&query->pattern, word, length);
+    }
+    return 0;
+}
+
+/**
+ * Switches a prepared query to another cost model. Any model but
+ * DISTANCE_LEVENSHTEIN is scored one word at a time by its own DP kernel, so
+ * the query drops to DISTANCE_DP and candidate stores score it word by word
+ * instead of in SIMD blocks.
+ * @param query Query prepared by distanceQueryInit.
+ * @param model
+ */
+void distanceQuerySetModel(DistanceQuery* query, DistanceModel model)
+{
+    assert(query != NULL);
+    query->model = model;
+    query->weighted = NULL;
+    query->indelCost = 1;
+    query->signatureCost = 1;
+    if (model == DISTANCE_OSA) {
+        query->weighted = osaDistanceBounded;
+    }
+    else if (model == DISTANCE_KEYBOARD) {
+        query->weighted = keyboardDistanceBounded;
+        query->indelCost = KEYBOARD_INDEL_COST;
+        query->signatureCost = KEYBOARD_INDEL_COST;
+        if (KEYBOARD_SUBSTITUTE_COST < query->signatureCost) {
+            query->signatureCost = KEYBOARD_SUBSTITUTE_COST;
+        }
+        if (KEYBOARD_ADJACENT_COST < query->signatureCost) {
+            query->signatureCost = KEYBOARD_ADJACENT_COST;
+        }
+    }
+    if (query->weighted != NULL) {
+        query->backend = DISTANCE_DP;
+        query->useMyers = 0;
+    }
+}
+
+/**
+ * Scores one dictionary word against a prepared query.
+ * @param query
+ * @param word Dictionary word.
+ * @param length Length of word.
+ * @param maxDistance Largest distance the caller is interested in, in the
+ * units of the query's cost model.
+ * @return The distance, or maxDistance + 1 if it is larger than maxDistance.
+ */
+int distanceQueryScore(DistanceQuery* query, const char* word, int length, int maxDistance)
+{
+    if (query->weighted != NULL) {
+        return query->weighted(word, length, query->word, query->length, maxDistance, query->rows);
+    }
+    if (query->useMyers) {
+        return myersDistanceBounded(&query->pattern, word, length, maxDistance);
+    }
+    return levDistanceBounded(word, length, query->word, query->length, maxDistance, query->rows);
+}
@@ -0,0 +1,113 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+/*
+ * Edit distance kernels used to rank spelling suggestions.
+ */
+
+#include <stdint.h>
+
+// Longest query levDistance and DistanceQuery handle with their own rows.
+#define DISTANCE_MAX_WORD 256
+// Longest query the bit-parallel backend handles in one machine word.
+#define MYERS_MAX_WORD 64
+
+typedef enum DistanceBackend
+{
+    DISTANCE_DP,
+    DISTANCE_MYERS,
+    // Batch kernel over many candidates at once; see candidateStore.h.
+    DISTANCE_SIMD
+} DistanceBackend;
+
+/*
+ * What an edit costs. DISTANCE_LEVENSHTEIN is the unit-cost distance every
+ * index (deletion index, BK-tree, DAWG, SIMD blocks) is built on.
+ * DISTANCE_OSA also counts swapping two adjacent characters ("hte" for
+ * "the") as one edit. DISTANCE_KEYBOARD counts in half edits: like OSA, but
+ * a transposition, or a substitution between neighbouring keys on a QWERTY
+ * keyboard or between the two cases of a letter, costs half an edit. The
+ * other two models are scored by the DP kernels in osaKernel.h.
+ */
+typedef enum DistanceModel
+{
+    DISTANCE_LEVENSHTEIN,
+    DISTANCE_OSA,
+    DISTANCE_KEYBOARD
+} DistanceModel;
+
+// Costs of the keyboard model, in half edits. Build with -D to retune; each
+// model's kernel is compiled with its costs as constants.
+#ifndef KEYBOARD_INDEL_COST
+#define KEYBOARD_INDEL_COST 2
+#endif
+#ifndef KEYBOARD_SUBSTITUTE_COST
+#define KEYBOARD_SUBSTITUTE_COST 2
+#endif
+#ifndef KEYBOARD_ADJACENT_COST
+#define KEYBOARD_ADJACENT_COST 1
+#endif
+#ifndef KEYBOARD_TRANSPOSE_COST
+#define KEYBOARD_TRANSPOSE_COST 1
+#endif
+
+typedef int (*WeightedKernel)(const char* s, int lenS, const char* t, int lenT, int maxDistance, int* rows);
+
+typedef struct MyersPattern MyersPattern;
+typedef struct DistanceQuery DistanceQuery;
+
+/*
+ * Per-query character masks for Myers' bit-vector algorithm: bit i of
+ * peq[c] is set when the query's i-th character is c.
+ */
+struct MyersPattern
+{
+    uint64_t peq[256];
+    int length;
+};
+
+/*
+ * A query word prepared for scoring many dictionary words. Holds everything
+ * the selected backend needs so scoring a candidate never allocates.
+ */
+struct DistanceQuery
+{
+    DistanceBackend backend;
+    // Whether single words are scored bit-parallel; long queries fall back to DP.
+    int useMyers;
+    const char* word;
+    int length;
+    // Cost model, the kernel scoring it when it is not Levenshtein, and the
+    // cost of one insertion or deletion, which turns a length difference
+    // into a lower bound on the distance.
+    DistanceModel model;
+    WeightedKernel weighted;
+    int indelCost;
+    // Character signature of the word, and the cost of the cheapest edit that
+    // changes which characters a word holds; candidate stores turn the two
+    // into a lower bound on the distance.
+    uint64_t signature;
+    int signatureCost;
+    // Candidate store ids, sorted, that scans must not offer: words a
+    // dictionary overlay removed from a shared store. NULL hides none.
+    const int* hiddenIds;
+    int hiddenCount;
+    MyersPattern pattern;
+    int rows[3 * (DISTANCE_MAX_WORD + 1)];
+};
+
+int levDistance(const char* s, const char* t);
+int levDistanceBounded(const char* s, int lenS, const char* t, int lenT, int maxDistance, int* rows);
+int osaDistanceBounded(const char* s, int lenS, const char* t, int lenT, int maxDistance, int* rows);
+int keyboardDistanceBounded(const char* s, int lenS, const char* t, int lenT, int maxDistance, int* rows);
+
+uint64_t distanceSignature(const char* word, int length);
+
+void myersPrepare(MyersPattern* pattern, const char* query, int length);
+int myersDistanceBounded(const MyersPattern* pattern, const char* word, int length, int maxDistance);
+
+int distanceQueryInit(DistanceQuery* query, DistanceBackend backend, const char* word, int length);
+void distanceQuerySetModel(DistanceQuery* query, DistanceModel model);
+int distanceQueryScore(DistanceQuery* query, const char* word, int length, int maxDistance);
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ * Streaming tokenizer for documents to be checked.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "document.h"
+#include "dictionary.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Opens a document for tokenizing. Regular files are mapped; anything else,
+ * including stdin, is read in blocks.
+ * @param reader
+ * @param path File to read, or NULL or "-" for stdin.
+ * @return 0 on success, -1 if the file could not be opened.
+ */
+int documentOpen(DocumentReader* reader, const char* path)
+{
+    assert(reader != NULL);
+    memset(reader, 0, sizeof(DocumentReader));
+    for (int c = 0; c < 256; c++) {
+        reader->wordClass[c] = isWordCharacter(c);
+    }
+
+    int useStdin = (path == NULL) || (strcmp(path, "-") == 0);
+    reader->fd = useStdin ? STDIN_FILENO : open(path, O_RDONLY);
+    if (reader->fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(reader->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) {
+            reader->atEnd = 1;
+            return 0;
+        }
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+        if (data != MAP_FAILED) {
+            posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+            reader->data = data;
+            reader->length = st.st_size;
+            reader->mapped = 1;
+            reader->atEnd = 1;
+            return 0;
+        }
+    }
+
+    // not mappable: fall back to block reads
+    reader->buffer = malloc(DOCUMENT_BLOCK_SIZE);
+    reader->data = reader->buffer;
+    return 0;
+}
+
+/**
+ * Unmaps or frees whatever the reader holds and closes its file.
+ * @param reader
+ */
+void documentClose(DocumentReader* reader)
+{
+    assert(reader != NULL);
+    if (reader->mapped) {
+        munmap((void*) reader->data, reader->length);
+    }
+    free(reader->buffer);
+    if (reader->fd > STDIN_FILENO) {
+        close(reader->fd);
+    }
+    reader->data = NULL;
+    reader->buffer = NULL;
+}
+
+/**
+ * Moves the unread bytes from keep onwards to the front of the block buffer
+ * and reads more after them. Sets atEnd once the input is exhausted.
+ */
+static void refill(DocumentReader* reader, size_t keep)
+{
+    size_t carried = reader->length - keep;
+    memmove(reader->buffer, reader->buffer + keep, carried);
+    reader->base += keep;
+    reader->length = carried;
+    reader->position = 0;
+    while (1) {
+        ssize_t got = read(reader->fd, reader->buffer + carried, DOCUMENT_BLOCK_SIZE - carried);
+        if (got > 0) {
+            reader->length += got;
+            return;
+        }
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        reader->atEnd = 1;
+        return;
+    }
+}
+
+/**
+ * Returns the next word in the document. The word is not null terminated and
+ * stays valid until the next call. A word longer than DOCUMENT_BLOCK_SIZE in
+ * a streamed document comes back in pieces.
+ * @param reader
+ * @param length Set to the length of the word.
+ * @param offset Set to the byte offset of the word in the document.
+ * @return Pointer to the word, or NULL at the end of the document.
+ */
+const char* documentNextWord(DocumentReader* reader, int* length, size_t* offset)
+{
+    assert((reader != NULL) && (length != NULL) && (offset != NULL));
+    const unsigned char* wordClass = reader->wordClass;
+    while (1) {
+        const char* data = reader->data;
+        size_t end = reader->length;
+        size_t i = reader->position;
+        while (i < end && !wordClass[(unsigned char) data[i]]) {
+            i++;
+        }
+        size_t start = i;
+        while (i < end && wordClass[(unsigned char) data[i]]) {
+            i++;
+        }
+
+        // a word running into the end of a block may continue in the next one
+        int complete = (i < end) || reader->atEnd || (start == 0 && end == DOCUMENT_BLOCK_SIZE);
+        if (complete) {
+            reader->position = i;
+            if (i == start) {
+                return NULL;
+            }
+            *length = (int) (i - start);
+            *offset = reader->base + start;
+            return data + start;
+        }
+        refill(reader, start);
+    }
+}
+
+/**
+ * Returns how many bytes of the document have been taken in so far.
+ * @param reader
+ * @return Byte count.
+ */
+size_t documentBytesRead(DocumentReader* reader)
+{
+    assert(reader != NULL);
+    return reader->base + reader->length;
+}
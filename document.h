@@ -0,0 +1,42 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+/*
+ * Streaming tokenizer for documents to be checked.
+ *
+ * Regular files are mapped whole; pipes and stdin are read in blocks of
+ * DOCUMENT_BLOCK_SIZE bytes, carrying a word cut by a block boundary over to
+ * the next block. Words are returned as pointers into the mapping or block
+ * with a length and a byte offset in the document, so tokenizing allocates
+ * nothing per word. Word characters are the same as nextWord's.
+ */
+
+#include <stddef.h>
+
+#define DOCUMENT_BLOCK_SIZE (1 << 20)
+
+typedef struct DocumentReader DocumentReader;
+
+struct DocumentReader
+{
+    int fd;
+    int mapped;
+    // The whole mapped file, or the current block.
+    const char* data;
+    size_t length;
+    size_t position;
+    // Document offset of data[0].
+    size_t base;
+    // Block buffer when the document is read rather than mapped.
+    char* buffer;
+    int atEnd;
+    // Nonzero for the bytes isWordCharacter accepts.
+    unsigned char wordClass[256];
+};
+
+int documentOpen(DocumentReader* reader, const char* path);
+void documentClose(DocumentReader* reader);
+const char* documentNextWord(DocumentReader* reader, int* length, size_t* offset);
+size_t documentBytesRead(DocumentReader* reader);
+
+#endif
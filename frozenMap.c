@@ -0,0 +1,448 @@
+/*
+ * Immutable dictionary on a minimal perfect hash.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "frozenMap.h"
+#include "dictImage.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Seeds tried for one bucket before the build gives up.
+#define FROZEN_MAX_SEED 0x7fffffff
+
+/**
+ * Maps a 32-bit value onto [0, range) without a division.
+ */
+static inline uint32_t reduce(uint32_t x, uint32_t range)
+{
+    return (uint32_t) (((uint64_t) x * range) >> 32);
+}
+
+/**
+ * Returns the bucket of a key hash.
+ */
+static inline uint32_t bucketOf(uint64_t hash, uint32_t bucketCount)
+{
+    return reduce((uint32_t) (hash >> 32), bucketCount);
+}
+
+/**
+ * Returns the slot a seed sends a key hash to: the murmur3 finalizer over the
+ * hash offset by the seed.
+ */
+static inline uint32_t slotOf(uint64_t hash, uint32_t seed, uint32_t keyCount)
+{
+    uint64_t x = hash + seed * 0x9e3779b97f4a7c15ULL;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return reduce((uint32_t) x, keyCount);
+}
+
+/**
+ * Returns the byte offsets of each array in a block of the given shape.
+ */
+static size_t layoutMap(uint32_t keyCount, uint32_t bucketCount, uint32_t poolSize,
+                        size_t* seeds, size_t* offsets, size_t* values, size_t* pool)
+{
+    *seeds = sizeof(FrozenMapHeader);
+    *offsets = *seeds + sizeof(uint32_t) * (size_t) bucketCount;
+    *values = *offsets + sizeof(uint32_t) * (size_t) keyCount;
+    *pool = *values + sizeof(int32_t) * (size_t) keyCount;
+    return *pool + poolSize;
+}
+
+/**
+ * Points a map's arrays into its memory block.
+ */
+static void attachMap(FrozenMap* frozen)
+{
+    const FrozenMapHeader* header = frozen->memory;
+    size_t seeds, offsets, values, pool;
+    layoutMap(header->keyCount, header->bucketCount, header->poolSize, &seeds, &offsets, &values, &pool);
+    const char* base = frozen->memory;
+    frozen->keyCount = header->keyCount;
+    frozen->bucketCount = header->bucketCount;
+    frozen->poolSize = header->poolSize;
+    frozen->seeds = (const uint32_t*) (base + seeds);
+    frozen->offsets = (const uint32_t*) (base + offsets);
+    frozen->values = (const int32_t*) (base + values);
+    frozen->pool = base + pool;
+}
+
+/**
+ * Returns a link's key hashed with HASH_FUNCTION, reusing the hash the map
+ * stored when it is on the same function.
+ */
+static uint64_t linkHash(HashMap* map, HashLink* link)
+{
+    return (map->hash == HASH_FUNCTION) ? link->hash : HASH_FUNCTION(link->key);
+}
+
+/**
+ * Builds a frozen copy of every key and value in the map. Buckets are placed
+ * largest first, while the table is still mostly free, and each tries seeds
+ * in order until one sends all of its keys to distinct free slots. Buckets of
+ * one key are left for last and take the remaining free slots directly.
+ * @param map
+ * @return The frozen map, or NULL if the map is empty or two keys share a
+ * full 64-bit hash, which no seed can separate.
+ */
+FrozenMap* frozenMapBuild(HashMap* map)
+{
+    assert(map != NULL);
+    hashMapFinishResize(map);
+    uint32_t keyCount = map->size;
+    if (keyCount == 0) {
+        return NULL;
+    }
+    uint32_t bucketCount = (keyCount + FROZEN_BUCKET_SIZE - 1) / FROZEN_BUCKET_SIZE;
+
+    // group the links by bucket with a counting sort
+    uint32_t* bucketStart = calloc(bucketCount + 1, sizeof(uint32_t));
+    HashLink** links = malloc(sizeof(HashLink*) * keyCount);
+    uint64_t* hashes = malloc(sizeof(uint64_t) * keyCount);
+    uint32_t poolSize = 0;
+    for (int i = 0; i < map->capacity; i++) {
+        if (map->table[i].link != NULL) {
+            bucketStart[bucketOf(linkHash(map, map->table[i].link), bucketCount) + 1]++;
+            poolSize += map->table[i].link->length + 1;
+        }
+    }
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        bucketStart[b + 1] += bucketStart[b];
+    }
+    uint32_t* fill = malloc(sizeof(uint32_t) * bucketCount);
+    memcpy(fill, bucketStart, sizeof(uint32_t) * bucketCount);
+    int largest = 0;
+    for (int i = 0; i < map->capacity; i++) {
+        HashLink* link = map->table[i].link;
+        if (link != NULL) {
+            uint64_t hash = linkHash(map, link);
+            uint32_t b = bucketOf(hash, bucketCount);
+            hashes[fill[b]] = hash;
+            links[fill[b]++] = link;
+            if ((int) (fill[b] - bucketStart[b]) > largest) {
+                largest = fill[b] - bucketStart[b];
+            }
+        }
+    }
+
+    // order buckets by size, largest first, again with a counting sort
+    uint32_t* sizeStart = calloc(largest + 2, sizeof(uint32_t));
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        sizeStart[largest - (bucketStart[b + 1] - bucketStart[b]) + 1]++;
+    }
+    for (int s = 0; s <= largest; s++) {
+        sizeStart[s + 1] += sizeStart[s];
+    }
+    uint32_t* order = malloc(sizeof(uint32_t) * bucketCount);
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        order[sizeStart[largest - (bucketStart[b + 1] - bucketStart[b])]++] = b;
+    }
+
+    uint32_t* seeds = calloc(bucketCount, sizeof(uint32_t));
+    HashLink** slots = calloc(keyCount, sizeof(HashLink*));
+    uint32_t* candidate = malloc(sizeof(uint32_t) * (largest + 1));
+    uint32_t freeCursor = 0;
+    int failed = 0;
+    for (uint32_t o = 0; o < bucketCount && !failed; o++) {
+        uint32_t b = order[o];
+        uint32_t first = bucketStart[b];
+        uint32_t count = bucketStart[b + 1] - first;
+        if (count == 0) {
+            break;
+        }
+        if (count == 1) {
+            // hand out the remaining free slots in order
+            while (slots[freeCursor] != NULL) {
+                freeCursor++;
+            }
+            slots[freeCursor] = links[first];
+            seeds[b] = FROZEN_DIRECT_SLOT | freeCursor;
+            continue;
+        }
+        uint32_t seed = 0;
+        int placed = 0;
+        while (!placed && seed < FROZEN_MAX_SEED) {
+            seed++;
+            placed = 1;
+            for (uint32_t k = 0; k < count && placed; k++) {
+                candidate[k] = slotOf(hashes[first + k], seed, keyCount);
+                if (slots[candidate[k]] != NULL) {
+                    placed = 0;
+                }
+                for (uint32_t j = 0; j < k && placed; j++) {
+                    placed = candidate[j] != candidate[k];
+                }
+            }
+        }
+        if (!placed) {
+            failed = 1;
+            break;
+        }
+        for (uint32_t k = 0; k < count; k++) {
+            slots[candidate[k]] = links[first + k];
+        }
+        seeds[b] = seed;
+    }
+
+    FrozenMap* frozen = NULL;
+    if (!failed) {
+        size_t seedsAt, offsetsAt, valuesAt, poolAt;
+        size_t length = layoutMap(keyCount, bucketCount, poolSize, &seedsAt, &offsetsAt, &valuesAt, &poolAt);
+        frozen = calloc(1, sizeof(FrozenMap));
+        frozen->memory = calloc(1, length);
+        frozen->memoryLength = length;
+        char* base = frozen->memory;
+        FrozenMapHeader* header = frozen->memory;
+        memcpy(header->magic, FROZEN_MAP_MAGIC, sizeof(header->magic));
+        header->version = FROZEN_MAP_VERSION;
+        header->headerSize = sizeof(FrozenMapHeader);
+        header->hashFunction = 3;
+        header->keyCount = keyCount;
+        header->bucketCount = bucketCount;
+        header->poolSize = poolSize;
+
+        memcpy(base + seedsAt, seeds, sizeof(uint32_t) * bucketCount);
+        uint32_t* offsets = (uint32_t*) (base + offsetsAt);
+        int32_t* values = (int32_t*) (base + valuesAt);
+        char* pool = base + poolAt;
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < keyCount; i++) {
+            offsets[i] = offset;
+            values[i] = slots[i]->value;
+            memcpy(pool + offset, slots[i]->key, slots[i]->length + 1);
+            offset += slots[i]->length + 1;
+        }
+        header->checksum = dictImageChecksum(base + sizeof(FrozenMapHeader), length - sizeof(FrozenMapHeader));
+        attachMap(frozen);
+    }
+
+    free(candidate);
+    free(slots);
+    free(seeds);
+    free(order);
+    free(sizeStart);
+    free(fill);
+    free(hashes);
+    free(links);
+    free(bucketStart);
+    return frozen;
+}
+
+/**
+ * Frees a built map or unmaps an opened one.
+ * @param frozen
+ */
+void frozenMapDelete(FrozenMap* frozen)
+{
+    if (frozen == NULL) {
+        return;
+    }
+    if (frozen->mapped) {
+        munmap(frozen->memory, frozen->memoryLength);
+    }
+    else {
+        free(frozen->memory);
+    }
+    free(frozen);
+}
+
+/**
+ * Writes the map to a file, through path.tmp and a rename.
+ * @param frozen
+ * @param path
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int frozenMapSave(FrozenMap* frozen, const char* path)
+{
+    assert((frozen != NULL) && (path != NULL));
+
+    size_t tmpLength = strlen(path) + 5;
+    char* tmpPath = malloc(tmpLength);
+    snprintf(tmpPath, tmpLength, "%s.tmp", path);
+    FILE* file = fopen(tmpPath, "wb");
+    int ret = -1;
+    if (file != NULL) {
+        size_t written = fwrite(frozen->memory, 1, frozen->memoryLength, file);
+        if (fclose(file) == 0 && written == frozen->memoryLength && rename(tmpPath, path) == 0) {
+            ret = 0;
+        }
+        else {
+            remove(tmpPath);
+        }
+    }
+    free(tmpPath);
+    return ret;
+}
+
+/**
+ * Checks every slot a lookup can reach and every key offset stays inside the
+ * map: each direct seed names a slot below keyCount, and each offset falls in
+ * the pool. Seeds that go through slotOf land in range by construction.
+ * @return 1 if they do, 0 otherwise.
+ */
+static int checkRanges(const FrozenMap* frozen)
+{
+    for (int i = 0; i < frozen->bucketCount; i++) {
+        uint32_t seed = frozen->seeds[i];
+        if ((seed & FROZEN_DIRECT_SLOT) && (seed & ~FROZEN_DIRECT_SLOT) >= (uint32_t) frozen->keyCount) {
+            return 0;
+        }
+    }
+    for (int i = 0; i < frozen->keyCount; i++) {
+        if (frozen->offsets[i] >= frozen->poolSize) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Maps a file written by frozenMapSave. The header, the sizes and, in one
+ * pass, the range of every seed and key offset are checked here, so lookups
+ * on a damaged file stay inside the mapping; use frozenMapVerify to check the
+ * checksum as well.
+ * @param path
+ * @return The map, or NULL if the file is missing, damaged or from another
+ * version.
+ */
+FrozenMap* frozenMapOpen(const char* path)
+{
+    assert(path != NULL);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(FrozenMapHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    const FrozenMapHeader* header = base;
+    size_t seeds, offsets, values, pool;
+    int valid = memcmp(header->magic, FROZEN_MAP_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == FROZEN_MAP_VERSION &&
+                header->headerSize == sizeof(FrozenMapHeader) &&
+                header->hashFunction == 3 &&
+                header->keyCount > 0 &&
+                header->bucketCount == (header->keyCount + FROZEN_BUCKET_SIZE - 1) / FROZEN_BUCKET_SIZE &&
+                layoutMap(header->keyCount, header->bucketCount, header->poolSize,
+                          &seeds, &offsets, &values, &pool) == (size_t) st.st_size &&
+                ((const char*) base)[st.st_size - 1] == '\0';
+    if (!valid) {
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    FrozenMap* frozen = calloc(1, sizeof(FrozenMap));
+    frozen->memory = base;
+    frozen->memoryLength = st.st_size;
+    frozen->mapped = 1;
+    attachMap(frozen);
+    if (!checkRanges(frozen)) {
+        frozenMapDelete(frozen);
+        return NULL;
+    }
+    return frozen;
+}
+
+/**
+ * Recomputes the checksum.
+ * @param frozen
+ * @return 1 if the map is intact, 0 otherwise.
+ */
+int frozenMapVerify(FrozenMap* frozen)
+{
+    assert(frozen != NULL);
+    const FrozenMapHeader* header = frozen->memory;
+    return dictImageChecksum((const char*) frozen->memory + sizeof(FrozenMapHeader),
+                             frozen->memoryLength - sizeof(FrozenMapHeader)) == header->checksum;
+}
+
+/**
+ * Returns the slot a key would occupy: its bucket's direct slot or the one
+ * its bucket's seed selects.
+ */
+static inline uint32_t findSlot(FrozenMap* frozen, uint64_t hash)
+{
+    uint32_t seed = frozen->seeds[bucketOf(hash, frozen->bucketCount)];
+    return (seed & FROZEN_DIRECT_SLOT) ? (seed & ~FROZEN_DIRECT_SLOT) : slotOf(hash, seed, frozen->keyCount);
+}
+
+/**
+ * Returns a pointer to the value of the given key, or NULL if the key is not
+ * in the map. Costs one hash, one slot read and one string compare.
+ * @param frozen
+ * @param key
+ * @return Read-only value, or NULL.
+ */
+const int32_t* frozenMapGet(FrozenMap* frozen, const char* key)
+{
+    assert((frozen != NULL) && (key != NULL));
+    uint32_t slot = findSlot(frozen, HASH_FUNCTION(key));
+    return (strcmp(frozen->pool + frozen->offsets[slot], key) == 0) ? &frozen->values[slot] : NULL;
+}
+
+/**
+ * Returns 1 if the key is in the map and 0 otherwise.
+ * @param frozen
+ * @param key
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int frozenMapContainsKey(FrozenMap* frozen, const char* key)
+{
+    return frozenMapGet(frozen, key) != NULL;
+}
+
+/**
+ * Returns the number of keys in the map.
+ * @param frozen
+ * @return Number of keys.
+ */
+int frozenMapSize(FrozenMap* frozen)
+{
+    assert(frozen != NULL);
+    return frozen->keyCount;
+}
+
+/**
+ * Returns the key held in a slot, for walking every key.
+ * @param frozen
+ * @param slot Index below frozenMapSize.
+ * @return Map-owned key.
+ */
+const char* frozenMapKey(FrozenMap* frozen, int slot)
+{
+    assert((frozen != NULL) && (slot >= 0) && (slot < frozen->keyCount));
+    return frozen->pool + frozen->offsets[slot];
+}
+
+/**
+ * Returns the number of bytes the map holds.
+ * @param frozen
+ * @return Bytes in its block plus the handle.
+ */
+size_t frozenMapMemoryUsage(FrozenMap* frozen)
+{
+    assert(frozen != NULL);
+    return sizeof(FrozenMap) + frozen->memoryLength;
+}
@@ -0,0 +1,82 @@
+#ifndef FROZEN_MAP_H
+#define FROZEN_MAP_H
+
+/*
+ * Immutable dictionary on a minimal perfect hash (hash and displace, as in
+ * CHD).
+ *
+ * frozenMapBuild turns a populated HashMap into a table with exactly one slot
+ * per key. Keys are spread over keyCount / FROZEN_BUCKET_SIZE buckets by
+ * their hash. Each bucket then gets a seed, found at build time, that sends
+ * all of its keys to slots no other key uses. A bucket holding one key
+ * records its slot directly. A lookup hashes the key once, reads its bucket's
+ * seed, and compares against the single slot that seed selects. There are no
+ * probe runs and no chains.
+ *
+ * The whole map is one block, so it is saved with one write and reopened
+ * with one mmap.
+ *
+ * Layout (native byte order, offsets from the start of the block):
+ *   FrozenMapHeader
+ *   seeds     bucketCount uint32
+ *   offsets   keyCount uint32, pool offset of the key in each slot
+ *   values    keyCount int32
+ *   pool      poolSize bytes of null-terminated keys, in slot order
+ */
+
+#include "hashMap.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define FROZEN_MAP_MAGIC "SPELLPHF"
+#define FROZEN_MAP_VERSION 1
+// Average number of keys per bucket.
+#define FROZEN_BUCKET_SIZE 4
+// Set in a seed that holds a slot index directly.
+#define FROZEN_DIRECT_SLOT 0x80000000u
+
+typedef struct FrozenMap FrozenMap;
+typedef struct FrozenMapHeader FrozenMapHeader;
+
+struct FrozenMapHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    // 3 for hashFunction3; maps built on another hash are rejected.
+    uint32_t hashFunction;
+    uint32_t keyCount;
+    uint32_t bucketCount;
+    uint32_t poolSize;
+    // 64-bit FNV-1a over every byte after the header.
+    uint64_t checksum;
+};
+
+struct FrozenMap
+{
+    int keyCount;
+    int bucketCount;
+    const uint32_t* seeds;
+    const uint32_t* offsets;
+    const int32_t* values;
+    const char* pool;
+    uint32_t poolSize;
+    // Either one malloc'd block or a read-only file mapping.
+    void* memory;
+    size_t memoryLength;
+    int mapped;
+};
+
+FrozenMap* frozenMapBuild(HashMap* map);
+void frozenMapDelete(FrozenMap* frozen);
+int frozenMapSave(FrozenMap* frozen, const char* path);
+FrozenMap* frozenMapOpen(const char* path);
+int frozenMapVerify(FrozenMap* frozen);
+
+const int32_t* frozenMapGet(FrozenMap* frozen, const char* key);
+int frozenMapContainsKey(FrozenMap* frozen, const char* key);
+int frozenMapSize(FrozenMap* frozen);
+const char* frozenMapKey(FrozenMap* frozen, int slot);
+size_t frozenMapMemoryUsage(FrozenMap* frozen);
+
+#endif
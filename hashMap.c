@@ -7,15 +7,17 @@
  */
 
 #include "hashMap.h"
+#include "stats.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
+#include <pthread.h>
 
-int hashFunction1(const char* key)
+uint64_t hashFunction1(const char* key)
 {
-    int r = 0;
+    uint64_t r = 0;
     for (int i = 0; key[i] != '\0'; i++)
     {
         r += key[i];
@@ -23,9 +25,9 @@ int hashFunction1(const char* key)
     return r;
 }
 
-int hashFunction2(const char* key)
+uint64_t hashFunction2(const char* key)
 {
-    int r = 0;
+    uint64_t r = 0;
     for (int i = 0; key[i] != '\0'; i++)
     {
         r += (i + 1) * key[i];
@@ -34,80 +36,278 @@ int hashFunction2(const char* key)
 }
 
 /**
- * Creates a new hash table link with a copy of the key string.
+ * 64-bit FNV-1a followed by a final avalanche step. FNV-1a alone leaves the
+ * low bits weak for short keys, and the table index is taken from the low
+ * bits, so the result is run through the murmur3 finalizer.
+ * @param key
+ * @return 64-bit hash of the key.
+ */
+uint64_t hashFunction3(const char* key)
+{
+    uint64_t r = 14695981039346656037ULL;
+    for (int i = 0; key[i] != '\0'; i++)
+    {
+        r ^= (unsigned char) key[i];
+        r *= 1099511628211ULL;
+    }
+    r ^= r >> 33;
+    r *= 0xff51afd7ed558ccdULL;
+    r ^= r >> 33;
+    r *= 0xc4ceb9fe1a85ec53ULL;
+    r ^= r >> 33;
+    return r;
+}
+
+/**
+ * Word-at-a-time hash: reads the key 8 bytes at a time and folds each word in
+ * with a 64x64->128-bit multiply, as in wyhash, then finishes with the
+ * murmur3 finalizer. Needs the key's length up front, so it pays for a strlen
+ * before hashing.
+ * @param key
+ * @return 64-bit hash of the key.
+ */
+uint64_t hashFunction4(const char* key)
+{
+    size_t length = strlen(key);
+    uint64_t r = 0x9e3779b97f4a7c15ULL ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, key + i, 8);
+        __uint128_t product = (__uint128_t) (r ^ word) * 0xa0761d6478bd642fULL;
+        r = (uint64_t) product ^ (uint64_t) (product >> 64);
+    }
+    // the tail, zero padded
+    uint64_t word = 0;
+    memcpy(&word, key + i, length - i);
+    __uint128_t product = (__uint128_t) (r ^ word) * 0xe7037ed1a0b428dbULL;
+    r = (uint64_t) product ^ (uint64_t) (product >> 64);
+    r ^= r >> 33;
+    r *= 0xff51afd7ed558ccdULL;
+    r ^= r >> 33;
+    r *= 0xc4ceb9fe1a85ec53ULL;
+    r ^= r >> 33;
+    return r;
+}
+
+/**
+ * Returns the tag stored beside a link in its slot: the half of the hash that
+ * is not used to pick the home slot.
+ * @param hash
+ * @return Slot tag.
+ */
+static inline uint32_t hashTag(uint64_t hash)
+{
+    return (uint32_t) (hash >> 32);
+}
+
+/**
+ * Creates a new hash table link with a copy of the key string. Links removed
+ * earlier are reused first, along with their key storage when the new key
+ * fits in it; everything else is carved out of the map's arena.
+ * @param map Map that will own the link.
  * @param key Key string to copy in the link.
  * @param value Value to set in the link.
- * @param next Pointer to set as the link's next.
- * @return Hash table link allocated on the heap.
+ * @param hash Hash of the key.
+ * @return Hash table link owned by the map.
  */
-HashLink* hashLinkNew(const char* key, int value, HashLink* next)
+static HashLink* hashLinkNew(HashMap* map, const char* key, int value, uint64_t hash)
 {
-    HashLink* link = malloc(sizeof(HashLink));
-    link->key = malloc(sizeof(char) * (strlen(key) + 1));
-    strcpy(link->key, key);
+    int length = (int) strlen(key);
+    HashLink* link = map->freeLinks;
+    if (link != NULL) {
+        map->freeLinks = link->next;
+        if (length <= link->keyCapacity) {
+            memcpy(link->key, key, length + 1);
+        }
+        else {
+            link->key = arenaStrdup(&map->arena, key, length);
+            link->keyCapacity = length;
+        }
+    }
+    else {
+        link = arenaAlloc(&map->arena, sizeof(HashLink), _Alignof(HashLink));
+        link->key = arenaStrdup(&map->arena, key, length);
+        link->keyCapacity = length;
+    }
     link->value = value;
-    link->next = next;
+    link->length = length;
+    link->hash = hash;
+    link->next = NULL;
+    return link;
+}
+
+/**
+ * Returns a link to the map's free list. Its memory stays in the arena until
+ * the map is deleted.
+ * @param map
+ * @param link
+ */
+static void hashLinkDelete(HashMap* map, HashLink* link)
+{
+    link->next = map->freeLinks;
+    map->freeLinks = link;
+}
+
+// Left in old table slots whose link has moved or been removed during an
+// incremental resize, so probe runs through them stay intact.
+static HashLink migratedLink;
+#define MIGRATED (&migratedLink)
+
+/**
+ * Rounds a requested capacity up to the next power of two so that slot
+ * indices can be taken with a mask instead of a modulo.
+ * @param capacity
+ * @return Power of two no smaller than capacity (and at least 8).
+ */
+static int roundCapacity(int capacity)
+{
+    int rounded = 8;
+    while (rounded < capacity) {
+        rounded *= 2;
+    }
+    return rounded;
+}
+
+/**
+ * Finds the slot holding the given key, or the empty slot that ends its probe
+ * sequence if the key is not in the table.
+ * @param map
+ * @param key
+ * @param hash map->hash(key).
+ * @return Index of the matching or empty slot.
+ */
+static int findSlot(HashMap* map, const char* key, uint64_t hash)
+{
+    int mask = map->capacity - 1;
+    uint32_t tag = hashTag(hash);
+    int i = (int) (hash & mask);
+    STATS_ADD(hashLookups, 1);
+    STATS_ADD(hashProbes, 1);
+    // load is kept below one, so there is always an empty slot to stop on
+    while (map->table[i].link != NULL) {
+        if (map->table[i].tag == tag) {
+            STATS_ADD(hashKeyCompares, 1);
+            if (strcmp(map->table[i].link->key, key) == 0) {
+                return i;
+            }
+        }
+        i = (i + 1) & mask;
+        STATS_ADD(hashProbes, 1);
+    }
+    return i;
+}
+
+/**
+ * Finds the old table slot still holding the given key during an incremental
+ * resize.
+ * @param map
+ * @param key
+ * @param hash map->hash(key).
+ * @return Slot holding the key, or NULL if it is not in the old table.
+ */
+static HashSlot* findOldSlot(HashMap* map, const char* key, uint64_t hash)
+{
+    if (map->oldTable == NULL) {
+        return NULL;
+    }
+    int mask = map->oldCapacity - 1;
+    uint32_t tag = hashTag(hash);
+    int i = (int) (hash & mask);
+    STATS_ADD(hashProbes, 1);
+    while (map->oldTable[i].link != NULL) {
+        HashLink* link = map->oldTable[i].link;
+        if (link != MIGRATED && map->oldTable[i].tag == tag) {
+            STATS_ADD(hashKeyCompares, 1);
+            if (strcmp(link->key, key) == 0) {
+                return &map->oldTable[i];
+            }
+        }
+        i = (i + 1) & mask;
+        STATS_ADD(hashProbes, 1);
+    }
+    return NULL;
+}
+
+/**
+ * Returns the link holding the given key in either table, or NULL.
+ */
+static HashLink* findLink(HashMap* map, const char* key)
+{
+    uint64_t hash = map->hash(key);
+    HashLink* link = map->table[findSlot(map, key, hash)].link;
+    if (link == NULL) {
+        HashSlot* old = findOldSlot(map, key, hash);
+        link = (old != NULL) ? old->link : NULL;
+    }
     return link;
 }
 
 /**
- * Free the allocated memory for a hash table link created with hashLinkNew.
+ * Places a link in the first free slot of its probe sequence. The caller
+ * guarantees the key is not already present.
+ * @param map
  * @param link
  */
-static void hashLinkDelete(HashLink* link)
+static void placeLink(HashMap* map, HashLink* link)
 {
-    free(link->key);
-    free(link);
+    int mask = map->capacity - 1;
+    int i = (int) (link->hash & mask);
+    while (map->table[i].link != NULL) {
+        i = (i + 1) & mask;
+    }
+    map->table[i].tag = hashTag(link->hash);
+    map->table[i].link = link;
 }
 
 /**
- * Initializes a hash table map, allocating memory for a link pointer table with
- * the given number of buckets.
+ * Initializes a hash table map, allocating memory for a slot table with
+ * at least the given number of slots.
  * @param map
- * @param capacity The number of table buckets.
+ * @param capacity The minimum number of table slots.
  */
 void hashMapInit(HashMap* map, int capacity)
 {
-    map->capacity = capacity;
+    map->capacity = roundCapacity(capacity);
     map->size = 0;
-    map->table = malloc(sizeof(HashLink*) * capacity);
-    for (int i = 0; i < capacity; i++) {
-	    map->table[i] = NULL;
-    }
+    map->table = calloc(map->capacity, sizeof(HashSlot));
+    arenaInit(&map->arena);
+    map->freeLinks = NULL;
+    map->version = 0;
+    map->resizeMode = HASH_RESIZE_AT_ONCE;
+    map->oldTable = NULL;
+    map->oldCapacity = 0;
+    map->migrateCursor = 0;
+    map->hash = HASH_FUNCTION;
 }
 
 /**
- * Removes all links in the map and frees all allocated memory. You can use
- * hashLinkDelete to free the links.
+ * Removes all links in the map and frees all allocated memory. Links and keys
+ * all live in the arena, so this releases a handful of blocks rather than
+ * walking the table.
  * @param map
  */
 void hashMapCleanUp(HashMap* map)
 {
-    // FIXME: done
     /* ensure arguments are valid */
     assert(map != NULL);
-    
-    int i;
-    // for each bucket in the hashmap
-    for(i = 0; i < map->capacity; i++) {
-        // free each hashlink in bucket until all freed (until NULL reached)
-        while(map->table[i] != NULL) {
-            HashLink * delMe = map->table[i];
-            map->table[i] = map->table[i]->next;
-            hashLinkDelete(delMe);
-        }
-    }
-    // free the hash table
+
+    arenaCleanUp(&map->arena);
+    // free the hash table, and the old one if a resize was still running
     free(map->table);
+    free(map->oldTable);
+    map->oldTable = NULL;
     // reset remaining HashMap members to initial values
+    map->table = NULL;
+    map->freeLinks = NULL;
     map->size = 0;
     map->capacity = 0;
 }
 
 /**
- * Creates a hash table map, allocating memory for a link pointer table with
- * the given number of buckets.
- * @param capacity The number of buckets.
+ * Creates a hash table map, allocating memory for a slot table with at least
+ * the given number of slots.
+ * @param capacity The minimum number of slots.
  * @return The allocated map.
  */
 HashMap* hashMapNew(int capacity)
@@ -117,6 +317,22 @@ HashMap* hashMapNew(int capacity)
     return map;
 }
 
+/**
+ * Creates a hash table map that hashes its keys with the given function
+ * instead of HASH_FUNCTION, for comparing hash functions. Images and frozen
+ * maps built from it still index on HASH_FUNCTION.
+ * @param capacity The minimum number of slots.
+ * @param hash
+ * @return The allocated map.
+ */
+HashMap* hashMapNewWithHash(int capacity, HashFunction hash)
+{
+    assert(hash != NULL);
+    HashMap* map = hashMapNew(capacity);
+    map->hash = hash;
+    return map;
+}
+
 /**
  * Removes all links in the map and frees all allocated memory, including the
  * map itself.
@@ -129,230 +345,477 @@ void hashMapDelete(HashMap* map)
 }
 
 /**
- * Returns a pointer to the value of the link with the given key  and skip traversing as well. Returns NULL
+ * Returns a pointer to the value of the link with the given key. Returns NULL
  * if no link with that key is in the table.
- * 
- * Use HASH_FUNCTION(key) and the map's capacity to find the index of the
- * correct linked list bucket. Also make sure to search the entire list.
- * 
+ *
+ * Probing starts at the key's home slot and stops at the first empty slot;
+ * slots whose tag differs from the key's are skipped without a strcmp.
+ *
  * @param map
  * @param key
  * @return Link value or NULL if no matching link.
  */
 int* hashMapGet(HashMap* map, const char* key)
 {
-    // FIXME: done
     /* ensure arguments are valid */
-    assert((map != NULL) && (key !=  NULL));
-    //printf("DEBUG:: GETTING %c \n", *key);
-    
-    // find index of bucket for given key
-    int hashIndex = HASH_FUNCTION(key) % map->capacity;
-    // initialize pointer to head of bucket
-    HashLink * ptr = map->table[hashIndex];
-    // traverse linked list in search of given key
-    while(ptr != NULL) {
-        // if key is found, return pointer to value of key/value pair
-        if (strcmp(ptr->key, key) == 0) {
-            return &(ptr->value);
+    assert((map != NULL) && (key != NULL));
+
+    HashLink* link = findLink(map, key);
+    return (link != NULL) ? &(link->value) : NULL;
+}
+
+/**
+ * Moves up to count slots of the old table into the current one during an
+ * incremental resize, and frees the old table once every slot has moved.
+ * Moved slots are marked rather than emptied so the old table's probe runs
+ * stay intact for lookups.
+ * @param map
+ * @param count Number of old slots to move.
+ */
+static void migrateSlots(HashMap* map, int count)
+{
+    if (map->oldTable == NULL) {
+        return;
+    }
+    int end = map->migrateCursor + count;
+    if (end > map->oldCapacity) {
+        end = map->oldCapacity;
+    }
+    for (int i = map->migrateCursor; i < end; i++) {
+        HashLink* link = map->oldTable[i].link;
+        if (link != NULL && link != MIGRATED) {
+            placeLink(map, link);
+            map->oldTable[i].link = MIGRATED;
         }
-        // else go to the next link
-        ptr = ptr->next;
     }
-    
-    // if NULL is reached, then the given key does not exist in the hashed bucket
-    return NULL;
+    map->migrateCursor = end;
+    if (end == map->oldCapacity) {
+        free(map->oldTable);
+        map->oldTable = NULL;
+        map->oldCapacity = 0;
+        map->migrateCursor = 0;
+    }
 }
 
 /**
- * Resizes the hash table to have a number of buckets equal to the given 
- * capacity (double of the old capacity). After allocating the new table, 
- * all of the links need to rehashed into it because the capacity has changed.
- * 
- * Remember to free the old table and any old links if you use hashMapPut to
- * rehash them.
- * 
+ * Resizes the hash table to have a number of slots equal to the given
+ * capacity (double of the old capacity). The existing links are relinked into
+ * the new table by their stored hash, so no key is rehashed and no link is
+ * copied or reallocated. In incremental mode the links are only relinked
+ * HASH_MIGRATE_STEP slots at a time by later puts and removes.
+ *
  * @param map
- * @param capacity The new number of buckets.
+ * @param capacity The new number of slots, a power of two.
  */
 void resizeTable(HashMap* map, int capacity)
 {
-    // FIXME: done
     /* ensure arguments are valid */
     assert(map != NULL);
-    //printf("DEBUG:: RESIZING TO %d\n", capacity);
-    
+    assert((capacity & (capacity - 1)) == 0 && capacity > map->size);
+
+    // a resize still running has to complete before another can start
+    hashMapFinishResize(map);
+
     /* store old table and associated values */
-    HashLink ** oldTable = map->table;
-    int oldCapacity = map->capacity;
-    
+    map->oldTable = map->table;
+    map->oldCapacity = map->capacity;
+    map->migrateCursor = 0;
+
     /* initialize new table with given capacity */
-    map->table = (HashLink **) malloc(capacity * sizeof(HashLink *));
-    // initialize newly allocated table
-    for (int i = 0; i < capacity; i++) {
-	    map->table[i] = NULL;
-    }
+    map->table = calloc(capacity, sizeof(HashSlot));
     map->capacity = capacity;
-    map->size = 0;
-    
-    /* add key/value pairs from old table into new table via hashMapPut */
-    int i;
-    // for each bucket in old table
-    for(i = 0; i < oldCapacity; i++) {
-        // until end of bucket's linked list is reached
-        while(oldTable[i] != NULL) {
-            // store current link to allow for freeing memory after adding
-            HashLink * delMe = oldTable[i];
-            // put old table's link in map's resized table
-            hashMapPut(map, oldTable[i]->key, oldTable[i]->value);
-            // go to next link
-            oldTable[i] = oldTable[i]->next;
-            // free the old link
-            hashLinkDelete(delMe);
-        }
+
+    // move every link from the old table into the new one, now or later
+    if (map->resizeMode == HASH_RESIZE_AT_ONCE) {
+        hashMapFinishResize(map);
     }
-    
-    // free old table's memory
-    free(oldTable);
+}
+
+/**
+ * Chooses how the table grows from now on. Switching to HASH_RESIZE_AT_ONCE
+ * completes any incremental resize still running.
+ * @param map
+ * @param mode
+ */
+void hashMapSetResizeMode(HashMap* map, HashResizeMode mode)
+{
+    assert(map != NULL);
+    map->resizeMode = mode;
+    if (mode == HASH_RESIZE_AT_ONCE) {
+        hashMapFinishResize(map);
+    }
+}
+
+/**
+ * Completes a running incremental resize, so that every link is in
+ * map->table. Does nothing if no resize is running.
+ * @param map
+ */
+void hashMapFinishResize(HashMap* map)
+{
+    assert(map != NULL);
+    migrateSlots(map, map->oldCapacity);
 }
 
 /**
  * Updates the given key-value pair in the hash table. If a link with the given
- * key already exists, this will just update the value and skip traversing. Otherwise, it will
- * create a new link with the given key and value and add it to the table
- * bucket's linked list. You can use hashLinkNew to create the link.
- * 
- * Use HASH_FUNCTION(key) and the map's capacity to find the index of the
- * correct linked list bucket.
- * 
+ * key already exists, this will just update the value. Otherwise, it will
+ * create a new link with the given key and value and place it in the first
+ * empty slot of the key's probe sequence.
+ *
  * @param map
  * @param key
  * @param value
  */
 void hashMapPut(HashMap* map, const char* key, int value)
 {
-    // FIXME: done
     /* ensure arguments are valid */
     assert((map != NULL) && (key != NULL));
-    //printf("DEBUG:: PUTTING  (%c)%d \n", *key, value);
 
-    /* traverse map bucket's linked list in search of given key */
-    // find index of bucket for given key
-    int hashIndex = HASH_FUNCTION(key) % map->capacity;
-    
-    // initialize pointer to head of bucket
-    HashLink * ptr = map->table[hashIndex];
-    
-    // iterate through list until at end of list
-    while(ptr != NULL) {
-        // if key is found, update value field with given value
-        if (strcmp(ptr->key, key) == 0) {
-            ptr->value = value;
-            // keys are unique so get the heck outta here once key/value updated
-            //printf("DEBUG:: UPDATED  (%c)%d \n", *key, value);
-            return;
+    migrateSlots(map, HASH_MIGRATE_STEP);
+    uint64_t hash = map->hash(key);
+    int i = findSlot(map, key, hash);
+    map->version++;
+
+    // if key is found, update value field with given value
+    if (map->table[i].link != NULL) {
+        map->table[i].link->value = value;
+        return;
+    }
+    HashSlot* old = findOldSlot(map, key, hash);
+    if (old != NULL) {
+        old->link->value = value;
+        return;
+    }
+
+    // if load factor would pass MAX_TABLE_LOAD, double table size
+    if ((float) (map->size + 1) / (float) map->capacity > MAX_TABLE_LOAD) {
+        resizeTable(map, map->capacity * 2);
+    }
+
+    placeLink(map, hashLinkNew(map, key, value, hash));
+    map->size++;
+}
+
+/*
+ * One thread's share of hashMapPutAll. The build runs in three passes with a
+ * join between each: every worker makes links for a slice of the keys, then
+ * files its slice's links under the slot range their home slot falls in, then
+ * places the links of one range. Ranges are disjoint runs of slots, so the
+ * last pass needs no locks.
+ */
+typedef struct BulkWorker BulkWorker;
+
+struct BulkWorker
+{
+    HashMap* map;
+    char* const* keys;
+    const int* values;
+    // Slice of keys this worker makes links for and files.
+    int begin;
+    int end;
+    HashLink** links;
+    // Links grouped by range, shared by all workers.
+    HashLink** sorted;
+    int rangeCount;
+    int capacityBits;
+    // Links of each range in this worker's slice, turned into this worker's
+    // next write position in sorted for each range before filing.
+    int* counts;
+    // Range this worker places: its slots and its part of sorted.
+    int slotBegin;
+    int slotEnd;
+    int sortedBegin;
+    int sortedEnd;
+    // Links whose probe ran past slotEnd, or that matched a key already
+    // placed, left for the serial pass.
+    HashLink** deferred;
+    int deferredCount;
+    int deferredCapacity;
+    int placed;
+    // Holds the links this worker makes until the map adopts them.
+    Arena arena;
+};
+
+/**
+ * Returns the slot range a hash's home slot falls in. Ranges split the table
+ * into rangeCount nearly equal runs of consecutive slots.
+ */
+static inline int bulkRange(BulkWorker* worker, uint64_t hash)
+{
+    uint64_t home = hash & (((uint64_t) 1 << worker->capacityBits) - 1);
+    return (int) ((home * (uint64_t) worker->rangeCount) >> worker->capacityBits);
+}
+
+/**
+ * First pass: copies the worker's keys into links in its own arena, hashes
+ * them and counts how many fall in each range.
+ * @param arg The worker.
+ * @return NULL.
+ */
+static void* bulkMakeLinks(void* arg)
+{
+    BulkWorker* worker = arg;
+    for (int i = worker->begin; i < worker->end; i++) {
+        const char* key = worker->keys[i];
+        int length = (int) strlen(key);
+        HashLink* link = arenaAlloc(&worker->arena, sizeof(HashLink), _Alignof(HashLink));
+        link->key = arenaStrdup(&worker->arena, key, length);
+        link->value = worker->values[i];
+        link->length = length;
+        link->keyCapacity = length;
+        link->hash = worker->map->hash(link->key);
+        link->next = NULL;
+        worker->links[i] = link;
+        worker->counts[bulkRange(worker, link->hash)]++;
+    }
+    return NULL;
+}
+
+/**
+ * Second pass: files the worker's links under their ranges, keeping their
+ * order so equal keys are resolved in the order they were given.
+ * @param arg The worker.
+ * @return NULL.
+ */
+static void* bulkFileLinks(void* arg)
+{
+    BulkWorker* worker = arg;
+    for (int i = worker->begin; i < worker->end; i++) {
+        HashLink* link = worker->links[i];
+        worker->sorted[worker->counts[bulkRange(worker, link->hash)]++] = link;
+    }
+    return NULL;
+}
+
+/**
+ * Third pass: places the links of the worker's range. A probe that would
+ * leave the range is deferred rather than write a slot another worker owns.
+ * @param arg The worker.
+ * @return NULL.
+ */
+static void* bulkPlaceLinks(void* arg)
+{
+    BulkWorker* worker = arg;
+    HashSlot* table = worker->map->table;
+    int mask = worker->map->capacity - 1;
+    for (int j = worker->sortedBegin; j < worker->sortedEnd; j++) {
+        HashLink* link = worker->sorted[j];
+        uint32_t tag = hashTag(link->hash);
+        int i = (int) (link->hash & mask);
+        while (i < worker->slotEnd && table[i].link != NULL &&
+               (table[i].tag != tag || strcmp(table[i].link->key, link->key) != 0)) {
+            i++;
         }
-        // else go to the next link
-        ptr = ptr->next;
+        if (i < worker->slotEnd && table[i].link == NULL) {
+            table[i].tag = tag;
+            table[i].link = link;
+            worker->placed++;
+            continue;
+        }
+        if (worker->deferredCount == worker->deferredCapacity) {
+            worker->deferredCapacity = worker->deferredCapacity * 2 + 16;
+            worker->deferred = realloc(worker->deferred, sizeof(HashLink*) * worker->deferredCapacity);
+        }
+        worker->deferred[worker->deferredCount++] = link;
     }
+    return NULL;
+}
 
-    /* if end of list is reached, then key is not found - add new link to bucket with given key/value */
-    // if load factor is more than maximum load as defined with MAX_TABLE_LOAD, double table size
-    if(hashMapTableLoad(map) >= MAX_TABLE_LOAD) {
-        resizeTable(map, map->capacity*2);
+/**
+ * Runs fn for every worker, on a thread each apart from the first, which
+ * runs on the calling thread, and waits for all of them.
+ */
+static void runBulkWorkers(BulkWorker* workers, int count, void* (*fn)(void*))
+{
+    pthread_t* threads = malloc(sizeof(pthread_t) * count);
+    for (int i = 1; i < count; i++) {
+        pthread_create(&threads[i], NULL, fn, &workers[i]);
     }
-    
+    fn(&workers[0]);
+    for (int i = 1; i < count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
 
-    // update hashIndex in the event that table was resized
-    hashIndex = HASH_FUNCTION(key) % map->capacity;
+/**
+ * Puts count keys and their values into the map using up to threadCount
+ * threads. Meant for loading: an empty map is sized once for all the keys,
+ * so it never resizes, and the links are made and placed in parallel. The
+ * result is the same as calling hashMapPut for every key in order, so the
+ * last of several equal keys sets the value. A map that already holds keys
+ * takes them one at a time through hashMapPut. The table is sized for count
+ * keys, duplicates included.
+ * @param map
+ * @param keys Null-terminated key strings; they are copied.
+ * @param values Value of each key.
+ * @param count Number of keys.
+ * @param threadCount Threads to use, counting the calling one.
+ */
+void hashMapPutAll(HashMap* map, char* const* keys, const int* values, int count, int threadCount)
+{
+    /* ensure arguments are valid */
+    assert(map != NULL && ((keys != NULL && values != NULL) || count == 0));
 
-    // initialize new link and place at head of list
-    //printf("DEBUG:: PUT  (%c)%d \n", *key, value);
-    map->table[hashIndex] = hashLinkNew(key, value, map->table[hashIndex]);
-    map->size++;
+    if (map->size > 0 || map->oldTable != NULL) {
+        for (int i = 0; i < count; i++) {
+            hashMapPut(map, keys[i], values[i]);
+        }
+        return;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    // size the table so every key fits under MAX_TABLE_LOAD
+    int capacity = roundCapacity((int) (count / MAX_TABLE_LOAD) + 1);
+    if (capacity > map->capacity) {
+        free(map->table);
+        map->table = calloc(capacity, sizeof(HashSlot));
+        map->capacity = capacity;
+    }
+    int capacityBits = 0;
+    while ((1 << capacityBits) < map->capacity) {
+        capacityBits++;
+    }
+
+    // a thread per few thousand keys at most, so small maps stay on one
+    if (threadCount > count / 4096 + 1) {
+        threadCount = count / 4096 + 1;
+    }
+    if (threadCount < 1) {
+        threadCount = 1;
+    }
+    HashLink** links = malloc(sizeof(HashLink*) * count);
+    HashLink** sorted = malloc(sizeof(HashLink*) * count);
+    BulkWorker* workers = calloc(threadCount, sizeof(BulkWorker));
+    for (int w = 0; w < threadCount; w++) {
+        BulkWorker* worker = &workers[w];
+        worker->map = map;
+        worker->keys = keys;
+        worker->values = values;
+        worker->begin = (int) ((long long) count * w / threadCount);
+        worker->end = (int) ((long long) count * (w + 1) / threadCount);
+        worker->links = links;
+        worker->sorted = sorted;
+        worker->rangeCount = threadCount;
+        worker->capacityBits = capacityBits;
+        worker->counts = calloc(threadCount, sizeof(int));
+        // range w starts at the first home slot that maps to it
+        worker->slotBegin = (int) (((long long) map->capacity * w + threadCount - 1) / threadCount);
+        worker->slotEnd = (int) (((long long) map->capacity * (w + 1) + threadCount - 1) / threadCount);
+        arenaInit(&worker->arena);
+    }
+    runBulkWorkers(workers, threadCount, bulkMakeLinks);
+
+    // turn the per-worker counts into write positions in sorted
+    int position = 0;
+    for (int r = 0; r < threadCount; r++) {
+        workers[r].sortedBegin = position;
+        for (int w = 0; w < threadCount; w++) {
+            int linksInRange = workers[w].counts[r];
+            workers[w].counts[r] = position;
+            position += linksInRange;
+        }
+        workers[r].sortedEnd = position;
+    }
+    runBulkWorkers(workers, threadCount, bulkFileLinks);
+    free(links);
+    runBulkWorkers(workers, threadCount, bulkPlaceLinks);
+
+    int placed = 0;
+    for (int w = 0; w < threadCount; w++) {
+        arenaAdopt(&map->arena, &workers[w].arena);
+        placed += workers[w].placed;
+    }
+    map->size = placed;
+    // deferred links probe across ranges, or wrap around, so place them here;
+    // a key seen before only updates the value, as hashMapPut would
+    for (int w = 0; w < threadCount; w++) {
+        for (int j = 0; j < workers[w].deferredCount; j++) {
+            HashLink* link = workers[w].deferred[j];
+            int i = findSlot(map, link->key, link->hash);
+            if (map->table[i].link != NULL) {
+                map->table[i].link->value = link->value;
+                hashLinkDelete(map, link);
+                continue;
+            }
+            map->table[i].tag = hashTag(link->hash);
+            map->table[i].link = link;
+            map->size++;
+        }
+        free(workers[w].deferred);
+        free(workers[w].counts);
+    }
+    map->version++;
+    free(sorted);
+    free(workers);
 }
 
 /**
- * Removes and frees the link with the given key from the table. If no such link
- * exists, this does nothing. Remember to search the entire linked list at the
- * bucket. You can use hashLinkDelete to free the link.
+ * Removes the link with the given key from the table and puts it on the free
+ * list for reuse. If no such link exists, this does nothing.
+ *
+ * Uses backward-shift deletion: later links in the same probe run are moved
+ * back into the hole so no tombstones are needed and probe runs stay short.
  * @param map
  * @param key
  */
 void hashMapRemove(HashMap* map, const char* key)
 {
-    // FIXME: done
     /* ensure arguments are valid */
     assert((map != NULL) && (key != NULL));
-    //printf("DEBUG:: REMOVING %c \n", *key);
 
-    /* traverse map bucket's linked list in search of given key */
-    // find index of bucket for given key
-    int hashIndex = HASH_FUNCTION(key) % map->capacity;
-    
-    // initialize pointer to head of bucket
-    HashLink * ptr = map->table[hashIndex];
-    HashLink * prevPtr = NULL;
-    // iterate through list until at end of list
-    while(ptr != NULL) {
-        // if key is found, remove and free associated link
-        if (strcmp(ptr->key, key) == 0) {
-            // if this is not the first link, resolve previous and next link pointers to skip over this link
-            if(prevPtr != NULL) {
-                prevPtr->next = ptr->next;
-            }
-            // otherwise it is the first link and need to set table to point to next link as head
-            else {
-                map->table[hashIndex] = ptr->next;
-            }
-            // free this link
-            hashLinkDelete(ptr);
-            // decrement map size
+    migrateSlots(map, HASH_MIGRATE_STEP);
+    uint64_t hash = map->hash(key);
+    int mask = map->capacity - 1;
+    int hole = findSlot(map, key, hash);
+
+    // a key not moved yet is only marked in the old table; its probe runs
+    // must stay intact for lookups until the old table is dropped
+    if (map->table[hole].link == NULL) {
+        HashSlot* old = findOldSlot(map, key, hash);
+        if (old != NULL) {
+            hashLinkDelete(map, old->link);
+            old->link = MIGRATED;
             map->size--;
-            // keys are unique so get the heck outta here once key is found and removed
-            //printf("DEBUG:: REMOVED);
-            return;
+            map->version++;
         }
-        // else go to the next link
-        prevPtr = ptr;
-        ptr = ptr->next;
+        // if key is not found, nothing happens
+        return;
+    }
+    hashLinkDelete(map, map->table[hole].link);
+    map->table[hole].link = NULL;
+    map->size--;
+    map->version++;
+
+    // shift back any following link whose home slot is at or before the hole
+    int i = (hole + 1) & mask;
+    while (map->table[i].link != NULL) {
+        int home = (int) (map->table[i].link->hash & mask);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            map->table[hole] = map->table[i];
+            map->table[i].link = NULL;
+            hole = i;
+        }
+        i = (i + 1) & mask;
     }
-    
-    // if key is not found, nothing happens
 }
 
 /**
  * Returns 1 if a link with the given key is in the table and 0 otherwise.
- * 
- * Use HASH_FUNCTION(key) and the map's capacity to find the index of the
- * correct linked list bucket. Also make sure to search the entire list.
- * 
+ *
  * @param map
  * @param key
  * @return 1 if the key is found, 0 otherwise.
  */
 int hashMapContainsKey(HashMap* map, const char* key)
 {
-    // FIXME: done
     /* ensure arguments are valid */
     assert((map != NULL) && (key != NULL));
-    
-    // find index of bucket for given key
-    int hashIndex = HASH_FUNCTION(key) % map->capacity;
-    // initialize pointer to head of bucket
-    HashLink * ptr = map->table[hashIndex];
-    // traverse linked list in search of given key
-    while(ptr != NULL) {
-        // if key is found, return 1
-        if (strcmp(ptr->key, key) == 0) {
-            return 1;
-        }
-        // else go to the next link
-        ptr = ptr->next;
-    }
-    
-    // if NULL is reached, then the given key does not exist in the hashed bucket
-    return 0;
+
+    return findLink(map, key) != NULL;
 }
 
 /**
@@ -370,9 +833,9 @@ int hashMapSize(HashMap* map)
 }
 
 /**
- * Returns the number of buckets in the table.
+ * Returns the number of slots in the table.
  * @param map
- * @return Number of buckets in the table.
+ * @return Number of slots in the table.
  */
 int hashMapCapacity(HashMap* map)
 {
@@ -384,33 +847,75 @@ int hashMapCapacity(HashMap* map)
 }
 
 /**
- * Returns the number of table buckets without any links.
+ * Returns the number of table slots without any links.
  * @param map
- * @return Number of empty buckets.
+ * @return Number of empty slots.
  */
 int hashMapEmptyBuckets(HashMap* map)
 {
-    // FIXME: done
     /* ensure arguments are valid */
     assert(map != NULL);
-    
+
     int emptyBucketCount = 0;
-    
-    // for each bucket in table
-    int i;
-    for(i = 0; i < map->capacity; i++) {
-        // if list head is null, then bucket is empty - increment count
-        emptyBucketCount += (map->table[i] == NULL);
+
+    // for each slot in table
+    for (int i = 0; i < map->capacity; i++) {
+        // if slot has no link, then it is empty - increment count
+        emptyBucketCount += (map->table[i].link == NULL);
     }
-    
+
     return emptyBucketCount;
 }
 
 /**
- * Returns the ratio of (number of links) / (number of buckets) in the table.
- * Remember that the buckets are linked lists, so this ratio tells you nothing
- * about the number of empty buckets. Remember also that the load is a floating
- * point number, so don't do integer division.
+ * Fills a histogram of probe lengths, the open-addressing counterpart of the
+ * old bucket chain lengths: histogram[d] counts the keys found d slots past
+ * their home slot, i.e. after d + 1 probes. Keys displaced by length or more
+ * slots are counted in the last entry. Links an incremental resize has not
+ * moved yet are not counted.
+ * @param map
+ * @param histogram Array of length counters, overwritten.
+ * @param length Number of entries in histogram.
+ * @return Longest probe distance in the table.
+ */
+int hashMapProbeHistogram(HashMap* map, int* histogram, int length)
+{
+    /* ensure arguments are valid */
+    assert((map != NULL) && (histogram != NULL) && (length > 0));
+
+    int mask = map->capacity - 1;
+    int longest = 0;
+    memset(histogram, 0, sizeof(int) * length);
+    for (int i = 0; i < map->capacity; i++) {
+        if (map->table[i].link != NULL) {
+            int distance = (i - (int) (map->table[i].link->hash & mask)) & mask;
+            histogram[distance < length ? distance : length - 1]++;
+            if (distance > longest) {
+                longest = distance;
+            }
+        }
+    }
+    return longest;
+}
+
+/**
+ * Returns the number of bytes the map holds: its slot table plus the arena
+ * blocks backing links and keys.
+ * @param map
+ * @return Bytes allocated by the map.
+ */
+size_t hashMapMemoryUsage(HashMap* map)
+{
+    /* ensure arguments are valid */
+    assert(map != NULL);
+
+    return sizeof(HashMap) + sizeof(HashSlot) * (map->capacity + map->oldCapacity) + arenaReserved(&map->arena);
+}
+
+/**
+ * Returns the ratio of (number of links) / (number of slots) in the table.
+ * With open addressing this can never reach one; puts keep it at or below
+ * MAX_TABLE_LOAD.
  * @param map
  * @return Table load.
  */
@@ -424,29 +929,21 @@ float hashMapTableLoad(HashMap* map)
 }
 
 /**
- * Prints all the links in each of the buckets in the table.
+ * Prints all the links in each of the slots in the table.
  * @param map
  */
 void hashMapPrint(HashMap* map)
 {
-    // FIXME: done
     /* ensure arguments are valid */
     assert(map != NULL);
-    
-    // for each bucket in table
-    int i;
-    HashLink * ptr;
 
-    for(i = 0; i < map->capacity; i++) {
-        ptr = map->table[i];
+    for (int i = 0; i < map->capacity; i++) {
+        HashLink* ptr = map->table[i].link;
         printf("\n map->table[%d]: ", i);
-        while(ptr != NULL) {
+        if (ptr != NULL) {
             printf("(%c)%d ", *(ptr->key), ptr->value);
-            ptr = ptr->next;
         }
-
         printf("<>");
     }
     printf("\n");
 }
-
@@ -1,45 +1,111 @@
-#ifndef HASH_MAP_H
-#define HASH_MAP_H
-
-/*
- * CS 261 Data Structures || Oregon State University
- * Provided by Course CS261
- * HashMap Implementation
- */
-
-#define HASH_FUNCTION hashFunction1
-#define MAX_TABLE_LOAD 1
-
-typedef struct HashMap HashMap;
-typedef struct HashLink HashLink;
-
-struct HashLink
-{
-    char* key;
-    int value;
-    HashLink* next;
-};
-
-struct HashMap
-{
-    HashLink** table;
-    // Number of links in the table.
-    int size;
-    // Number of buckets in the table.
-    int capacity;
-};
-
-HashMap* hashMapNew(int capacity);
-void hashMapDelete(HashMap* map);
-int* hashMapGet(HashMap* map, const char* key);
-void hashMapPut(HashMap* map, const char* key, int value);
-void hashMapRemove(HashMap* map, const char* key);
-int hashMapContainsKey(HashMap* map, const char* key);
-
-int hashMapSize(HashMap* map);
-int hashMapCapacity(HashMap* map);
-int hashMapEmptyBuckets(HashMap* map);
-float hashMapTableLoad(HashMap* map);
-void hashMapPrint(HashMap* map);
-
-#endif
+#ifndef HASH_MAP_H
+#define HASH_MAP_H
+
+/*
+ * CS 261 Data Structures || Oregon State University
+ * Provided by Course CS261
+ * HashMap Implementation
+ */
+
+#include "arena.h"
+#include <stdint.h>
+
+#define HASH_FUNCTION hashFunction3
+#define MAX_TABLE_LOAD 0.75
+// Old slots moved per put or remove while an incremental resize is running.
+#define HASH_MIGRATE_STEP 16
+
+typedef struct HashMap HashMap;
+typedef uint64_t (*HashFunction)(const char* key);
+typedef struct HashLink HashLink;
+typedef struct HashSlot HashSlot;
+
+/*
+ * How a full table grows. HASH_RESIZE_AT_ONCE moves every link into the new
+ * table inside the put that overflowed the old one. HASH_RESIZE_INCREMENTAL
+ * keeps the old table alongside the new one and moves HASH_MIGRATE_STEP of
+ * its slots on every later put or remove, so no single call pays for the
+ * whole table; lookups check both tables until the move is done.
+ */
+typedef enum HashResizeMode
+{
+    HASH_RESIZE_AT_ONCE,
+    HASH_RESIZE_INCREMENTAL
+} HashResizeMode;
+
+struct HashLink
+{
+    char* key;
+    int value;
+    // Length of key.
+    int length;
+    // Longest key the key buffer holds, which stays with the link when it is
+    // removed and reused for a shorter key.
+    int keyCapacity;
+    // Full hash of the key, kept so a resize never has to rehash strings.
+    uint64_t hash;
+    // Next link on the map's free list once the link has been removed.
+    HashLink* next;
+};
+
+/*
+ * One open-addressing slot. The tag is the upper half of the key's hash, so
+ * most probes that land on a different key are rejected without a strcmp.
+ */
+struct HashSlot
+{
+    uint32_t tag;
+    HashLink* link;
+};
+
+struct HashMap
+{
+    // While an incremental resize is running some links are still in
+    // oldTable; call hashMapFinishResize before walking table directly.
+    HashSlot* table;
+    // Number of links in the table.
+    int size;
+    // Number of slots in the table, always a power of two.
+    int capacity;
+    // Owns every link and key string; released in one go by hashMapDelete.
+    Arena arena;
+    // Removed links waiting to be reused by hashMapPut.
+    HashLink* freeLinks;
+    // Bumped by every put and every remove that finds its key, so anything
+    // derived from the map can tell when it is stale.
+    unsigned long version;
+    HashResizeMode resizeMode;
+    // Table being emptied by an incremental resize, NULL when none is running.
+    // Slots below migrateCursor have been moved.
+    HashSlot* oldTable;
+    int oldCapacity;
+    int migrateCursor;
+    // HASH_FUNCTION unless the map was made by hashMapNewWithHash.
+    HashFunction hash;
+};
+
+uint64_t hashFunction1(const char* key);
+uint64_t hashFunction2(const char* key);
+uint64_t hashFunction3(const char* key);
+uint64_t hashFunction4(const char* key);
+
+HashMap* hashMapNew(int capacity);
+HashMap* hashMapNewWithHash(int capacity, HashFunction hash);
+void hashMapDelete(HashMap* map);
+int* hashMapGet(HashMap* map, const char* key);
+void hashMapPut(HashMap* map, const char* key, int value);
+void hashMapPutAll(HashMap* map, char* const* keys, const int* values, int count, int threadCount);
+void hashMapRemove(HashMap* map, const char* key);
+int hashMapContainsKey(HashMap* map, const char* key);
+void hashMapSetResizeMode(HashMap* map, HashResizeMode mode);
+void hashMapFinishResize(HashMap* map);
+
+int hashMapSize(HashMap* map);
+int hashMapCapacity(HashMap* map);
+int hashMapEmptyBuckets(HashMap* map);
+int hashMapProbeHistogram(HashMap* map, int* histogram, int length);
+size_t hashMapMemoryUsage(HashMap* map);
+float hashMapTableLoad(HashMap* map);
+void hashMapPrint(HashMap* map);
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Bounded optimal string alignment kernel, written once and specialized per
+ * cost model. distance.c includes this file once for each model after
+ * defining:
+ *   OSA_KERNEL_NAME       name of the function to define
+ *   OSA_SUBSTITUTE(a, b)  cost of replacing character a with b, 0 when equal
+ *   OSA_INDEL             cost of inserting or deleting a character
+ *   OSA_TRANSPOSE         cost of swapping two adjacent characters
+ * The costs are expanded straight into the inner loop, so each model gets a
+ * kernel of its own with no branches on the model. There is deliberately no
+ * include guard; the parameters are undefined again at the end.
+ */
+
+/**
+ * Optimal string alignment distance between s and t under the kernel's cost
+ * model, giving up once it is known to be larger than maxDistance. Adjacent
+ * transpositions count as one operation, but no substring is edited twice.
+ *
+ * Like levDistanceBounded, only the diagonal band that can stay within the
+ * bound is filled, here maxDistance / OSA_INDEL columns either side. Three
+ * rows are kept since a transposition reaches back two rows, and the scan
+ * stops once two rows in a row are past the bound.
+ *
+ * @param s Dictionary word.
+ * @param lenS Length of s.
+ * @param t Query word.
+ * @param lenT Length of t.
+ * @param maxDistance Largest distance the caller is interested in.
+ * @param rows Scratch space for 3 * (lenT + 1) ints, reused across calls.
+ * @return The distance, or maxDistance + 1 if it is larger than maxDistance.
+ */
+int OSA_KERNEL_NAME(const char* s, int lenS, const char* t, int lenT, int maxDistance, int* rows)
+{
+    assert((s != NULL) && (t != NULL) && (rows != NULL) && (maxDistance >= 0));
+
+    // deleting one word and inserting the other bounds every distance
+    if (maxDistance > (lenS + lenT) * OSA_INDEL) {
+        maxDistance = (lenS + lenT) * OSA_INDEL;
+    }
+    int over = maxDistance + 1;
+    STATS_ADD(distanceCalls, 1);
+    if (abs(lenS - lenT) * OSA_INDEL > maxDistance) {
+        STATS_ADD(distanceEarlyExits, 1);
+        return over;
+    }
+
+    int band = maxDistance / OSA_INDEL;
+    int* older = rows;
+    int* prev = rows + lenT + 1;
+    int* cur = rows + 2 * (lenT + 1);
+    for (int j = 0; j <= lenT; j++) {
+        prev[j] = (j <= band) ? j * OSA_INDEL : over;
+    }
+    int prevMin = 0;
+
+    for (int i = 1; i <= lenS; i++) {
+        int lo = (i - band > 1) ? i - band : 1;
+        int hi = (i + band < lenT) ? i + band : lenT;
+        cur[lo - 1] = (lo == 1 && i <= band) ? i * OSA_INDEL : over;
+        STATS_ADD(distanceCells, hi - lo + 1);
+        int rowMin = cur[lo - 1];
+        unsigned char c = (unsigned char) s[i - 1];
+        // 0 never matches a query character, so row 1 tries no transpositions
+        unsigned char before = (i > 1) ? (unsigned char) s[i - 2] : 0;
+
+        for (int j = lo; j <= hi; j++) {
+            unsigned char u = (unsigned char) t[j - 1];
+            int best = prev[j - 1] + OSA_SUBSTITUTE(c, u);
+            int a = prev[j] + OSA_INDEL;
+            int b = cur[j - 1] + OSA_INDEL;
+            if (a < best) {
+                best = a;
+            }
+            if (b < best) {
+                best = b;
+            }
+            if (j > 1 && before == u && c == (unsigned char) t[j - 2]) {
+                int swap = older[j - 2] + OSA_TRANSPOSE;
+                if (swap < best) {
+                    best = swap;
+                }
+            }
+            if (best > over) {
+                best = over;
+            }
+            cur[j] = best;
+            if (best < rowMin) {
+                rowMin = best;
+            }
+        }
+        if (hi < lenT) {
+            cur[hi + 1] = over;
+        }
+        // the next row builds on this row and, through a transposition, the last
+        if (rowMin > maxDistance && prevMin > maxDistance) {
+            STATS_ADD(distanceEarlyExits, 1);
+            return over;
+        }
+        prevMin = rowMin;
+
+        int* temp = older;
+        older = prev;
+        prev = cur;
+        cur = temp;
+    }
+
+    return prev[lenT] < over ? prev[lenT] : over;
+}
+
+#undef OSA_KERNEL_NAME
+#undef OSA_SUBSTITUTE
+#undef OSA_INDEL
+#undef OSA_TRANSPOSE
@@ -0,0 +1,197 @@
+/*
+ * Worker threads that split one suggestion scan over a candidate store.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "searchPool.h"
+#include "stats.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Returns the number of online CPUs, or 1 if it cannot be determined.
+ * @return Default worker count.
+ */
+int searchPoolDefaultThreads(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int) count : 1;
+}
+
+/**
+ * Claims work units until none are left or the rest are too far off in
+ * length to matter, scoring each into the worker's own table.
+ * @param worker
+ */
+static void searchWorkerRun(SearchWorker* worker)
+{
+    SearchPool* pool = worker->pool;
+    while (1) {
+        int u = atomic_fetch_add_explicit(&pool->nextUnit, 1, memory_order_relaxed);
+        if (u >= pool->unitCount) {
+            break;
+        }
+        SearchUnit* unit = &pool->units[u];
+        if (unit->length < 0) {
+            candidateStoreScanLong(pool->store, &worker->query, &worker->table, &pool->sharedBound);
+            continue;
+        }
+        // skip whole units whose length alone is out of reach
+        int diff = abs(unit->length - worker->query.length) * worker->query.indelCost;
+        if (diff > atomic_load_explicit(&pool->sharedBound, memory_order_relaxed)) {
+            STATS_ADD(candidatesPruned,
+                      candidateStoreBlockWords(pool->store, unit->length, unit->firstBlock, unit->endBlock));
+            continue;
+        }
+        candidateStoreScanBlocks(pool->store, &worker->query, &worker->table, unit->length,
+                                 unit->firstBlock, unit->endBlock, &pool->sharedBound);
+    }
+}
+
+/**
+ * Thread body: waits for a scan, works on it, reports back, repeats.
+ * @param arg The worker.
+ * @return NULL.
+ */
+static void* searchWorkerMain(void* arg)
+{
+    SearchWorker* worker = arg;
+    SearchPool* pool = worker->pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->stopping && pool->generation == seen) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        searchWorkerRun(worker);
+        // the requester reads the totals once every worker has reported back
+        spellStatsFlush();
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * Starts a pool of worker threads over a finished candidate store.
+ * @param store Store to scan; must outlive the pool.
+ * @param threadCount Number of workers, or 0 for one per online CPU.
+ * @return The pool.
+ */
+SearchPool* searchPoolNew(CandidateStore* store, int threadCount)
+{
+    assert(store != NULL);
+
+    SearchPool* pool = calloc(1, sizeof(SearchPool));
+    pool->store = store;
+    pool->threadCount = threadCount > 0 ? threadCount : searchPoolDefaultThreads();
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // one unit per run of blocks, plus one for the long words
+    pool->unitCapacity = 1;
+    for (int n = 0; n <= CANDIDATE_MAX_LENGTH; n++) {
+        pool->unitCapacity += (store->buckets[n].blockCount + SEARCH_UNIT_BLOCKS - 1) / SEARCH_UNIT_BLOCKS;
+    }
+    pool->units = malloc(sizeof(SearchUnit) * pool->unitCapacity);
+
+    pool->workers = calloc(pool->threadCount, sizeof(SearchWorker));
+    for (int i = 0; i < pool->threadCount; i++) {
+        pool->workers[i].pool = pool;
+        pthread_create(&pool->workers[i].thread, NULL, searchWorkerMain, &pool->workers[i]);
+    }
+    return pool;
+}
+
+/**
+ * Stops and joins every worker and frees the pool. The store is left alone.
+ * @param pool
+ */
+void searchPoolDelete(SearchPool* pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->threadCount; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool->units);
+    free(pool);
+}
+
+/**
+ * Scans the whole store for the query on every worker and merges their
+ * results into table. Only one scan runs on a pool at a time.
+ * @param pool
+ * @param query Prepared query.
+ * @param table Suggestion table to update.
+ */
+void searchPoolScan(SearchPool* pool, DistanceQuery* query, TopK* table)
+{
+    assert((pool != NULL) && (query != NULL) && (table != NULL));
+
+    // lay out the work in the order a single-threaded scan would visit it
+    CandidateStore* store = pool->store;
+    pool->unitCount = 0;
+    int steps = 2 * (CANDIDATE_MAX_LENGTH + query->length) + 1;
+    for (int step = 0; step < steps; step++) {
+        int length = candidateStoreScanOrder(query->length, step);
+        if (length < 0) {
+            continue;
+        }
+        for (int block = 0; block < store->buckets[length].blockCount; block += SEARCH_UNIT_BLOCKS) {
+            SearchUnit* unit = &pool->units[pool->unitCount++];
+            unit->length = length;
+            unit->firstBlock = block;
+            unit->endBlock = block + SEARCH_UNIT_BLOCKS;
+        }
+    }
+    if (store->longCount > 0) {
+        pool->units[pool->unitCount++].length = -1;
+    }
+    atomic_store(&pool->nextUnit, 0);
+    // seed the shared bound from whatever the caller's table already holds
+    atomic_store(&pool->sharedBound, topKThreshold(table, INT_MAX));
+
+    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; i < pool->threadCount; i++) {
+        memcpy(&pool->workers[i].query, query, sizeof(DistanceQuery));
+        topKInit(&pool->workers[i].table, table->k);
+    }
+    pool->running = pool->threadCount;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    while (pool->running > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    // merge; the frequency and alphabetical tie-breaks make the order of offers irrelevant
+    for (int i = 0; i < pool->threadCount; i++) {
+        topKMerge(table, &pool->workers[i].table);
+    }
+}
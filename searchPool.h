@@ -0,0 +1,69 @@
+#ifndef SEARCH_POOL_H
+#define SEARCH_POOL_H
+
+/*
+ * Worker threads that split one suggestion scan over a candidate store.
+ *
+ * The store is cut into work units of a few hundred words, ordered the way a
+ * single-threaded scan visits them. Workers claim units from a shared counter,
+ * keep their own suggestion table and share only the current bound, so nothing
+ * is written to the dictionary during a scan. The per-worker tables are merged
+ * with topKMerge, whose alphabetical tie-break makes the result identical to
+ * candidateStoreScan's.
+ */
+
+#include "candidateStore.h"
+#include <pthread.h>
+
+// Blocks of CANDIDATE_LANES words per work unit.
+#define SEARCH_UNIT_BLOCKS 16
+
+typedef struct SearchPool SearchPool;
+typedef struct SearchWorker SearchWorker;
+typedef struct SearchUnit SearchUnit;
+
+struct SearchUnit
+{
+    // Bucket length, or -1 for the words too long for the blocked layout.
+    int length;
+    int firstBlock;
+    int endBlock;
+};
+
+struct SearchWorker
+{
+    SearchPool* pool;
+    pthread_t thread;
+    // Private copy of the query, since scoring writes its scratch rows.
+    DistanceQuery query;
+    TopK table;
+};
+
+struct SearchPool
+{
+    CandidateStore* store;
+    int threadCount;
+    SearchWorker* workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    // Bumped for every scan so workers can tell a new scan from a spurious wakeup.
+    unsigned long generation;
+    int running;
+    int stopping;
+
+    // Work for the current scan.
+    SearchUnit* units;
+    int unitCount;
+    int unitCapacity;
+    atomic_int nextUnit;
+    atomic_int sharedBound;
+};
+
+int searchPoolDefaultThreads(void);
+SearchPool* searchPoolNew(CandidateStore* store, int threadCount);
+void searchPoolDelete(SearchPool* pool);
+void searchPoolScan(SearchPool* pool, DistanceQuery* query, TopK* table);
+
+#endif
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# End-to-end test of spellServer on localhost, run by make test.
+#
+# Starts the server on a socket in a temporary directory, checks that
+# spellClient prints exactly what spellChecker --batch prints for the same
+# document, in one request and in many small pipelined ones, and runs
+# spellServerTest's protocol checks against it. Exits 1 on any difference.
+
+set -u
+document=serverTestDocument.txt
+dir=$(mktemp -d)
+socket="$dir/spellServer.sock"
+
+./spellServer --socket "$socket" --workers 2 2>"$dir/server.log" &
+server=$!
+trap 'kill $server 2>/dev/null; wait $server 2>/dev/null; rm -rf "$dir"' EXIT
+
+fail()
+{
+    echo "serverTest: $1" >&2
+    cat "$dir/server.log" >&2
+    exit 1
+}
+
+# the socket appears once the dictionary is loaded and the server listens
+tries=0
+while [ ! -S "$socket" ]; do
+    kill -0 $server 2>/dev/null || fail "the server exited"
+    tries=$((tries + 1))
+    [ $tries -le 300 ] || fail "the server did not start"
+    sleep 0.1
+done
+
+./spellChecker --batch "$document" >"$dir/expected" 2>/dev/null || fail "spellChecker failed"
+[ -s "$dir/expected" ] || fail "spellChecker found no misspellings in $document"
+./spellClient --socket "$socket" "$document" >"$dir/actual" 2>/dev/null || fail "spellClient failed"
+diff -u "$dir/expected" "$dir/actual" || fail "spellClient and spellChecker differ"
+./spellClient --socket "$socket" --words 3 --depth 4 "$document" >"$dir/actual" 2>/dev/null ||
+    fail "spellClient failed with small requests"
+diff -u "$dir/expected" "$dir/actual" || fail "spellClient with small requests and spellChecker differ"
+./spellServerTest --socket "$socket" || fail "protocol checks failed"
+
+echo "serverTest: spellClient matches spellChecker --batch"
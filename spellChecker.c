@@ -1,267 +1,950 @@
-/**
- * CS 261 Data Structures
- * SpellChecker
- * Name: Dipan Patel (pateldip@oregonstate.edu)
- * Date: 2020 Mar. 7
- */
- 
-#include "hashMap.h"
-#include <assert.h>
-#include <time.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-
-/**
- * SOURCES:
- * https://en.wikipedia.org/wiki/Levenshtein_distance#cite_note-5
- * I ended up taking the pseudocode from the Wikipedia article and building the following from that.
- */
-int levDistance(const char* s, const char* t) {
-    // get length of each string
-    int lenS = strlen(s);
-    int lenT = strlen(t);
-
-    // initialize two vectors to hold integer distance values, initialized to zero
-    int ** matrix = malloc((lenS+1) * sizeof(int *));
-    for(int i=0; i<lenS+1; i++) {
-        matrix[i] = malloc((lenT+1) * sizeof(int));
-    }
-
-    // valgrind kept yelling until I did this - uninitialized memory
-    for(int i = 0; i < lenS+1; i++) {
-        for(int j = 0; j < lenT+1; j++) {
-            matrix[i][j] = 0;
-        }
-    }
-   
-    // initialize first row of matrix - compare target to empty string
-    for (int i = 1; i<lenS+1; i++) {
-        matrix[i][0] = i;
-        //printf("Initializing row index: %d \n", i);
-    }
-    
-    // initialize first column of matrix - compare starting string to empty string
-    for (int i = 1; i<lenT+1; i++) {
-        matrix[0][i] = i;
-        //printf("Initializing col index: %d \n", i);
-    }
-    // fill in the remaining distances
-    int a = 0;
-    int b = 0;
-    int c = 0;
-    for (int i = 1; i<lenS+1; i++) {
-        for (int j = 1; j<lenT+1; j++) {
-            // Option A: Delete character
-            a = matrix[i-1][j] + 1;
-            // Option B: Add character (by deleting from target)
-            b = matrix[i][j-1] + 1;
-            // Option C: Substitute Character (only costs 1 if not matching)
-            if(s[i-1]!=t[j-1]) {
-                c = matrix[i-1][j-1] + 1;
-            }
-            else {
-                c = matrix[i-1][j-1];
-            }
-
-            // Find option with smallest cost
-            if (b < a) {
-                a = b;
-            }
-            if (c < a) {
-                a = c;
-            }
-
-            // store smallest cost option at current index
-            matrix[i][j] = a;
-        }
-    }
-
-    // store smallest distance and free allocated memory
-    int ret = matrix[lenS][lenT];
-    for(int i=0; i<lenS+1; i++) {
-        matrix[i]=0;
-        free(matrix[i]);
-    }
-    matrix = 0;
-    free(matrix);
-
-    //printf("%s (%d) | %s (%d)| %d \n", s, lenS, t, lenT, ret);
-    return ret;
-};
-
-/**
- * Manage array of closest matches to a given word
- * Idea is to allow this program to manage capturing the lowest 5 distance words
- * When a value is found to be lower than an index, move it there and shift the rest up
- * @return used for debugging to alert when a word is found that is considered close
- */
-int closest(HashLink ** table, HashLink * ptr) {
-    HashLink * temp = NULL;
-    int ret = 0;
-    for(int i = 0; i < 5; i++) {
-        if (table[i] == NULL) {
-            table[i] = ptr;
-            return 1;
-        }
-        if (ptr->value < table[i]->value) {
-            temp = table[i];
-            table[i] = ptr;
-            ptr = temp;
-            ret = 1;
-        }
-    }
-    return ret;
-};
-
-/**
- * Allocates a string for the next word in the file and returns it. This string
- * is null terminated. Returns NULL after reaching the end of the file.
- * @param file
- * @return Allocated string or NULL.
- */
-char* nextWord(FILE* file)
-{
-    int maxLength = 16;
-    int length = 0;
-    char* word = malloc(sizeof(char) * maxLength);
-    while (1)
-    {
-        char c = fgetc(file);
-        if ((c >= '0' && c <= '9') ||
-            (c >= 'A' && c <= 'Z') ||
-            (c >= 'a' && c <= 'z') ||
-            c == '\'')
-        {
-            if (length + 1 >= maxLength)
-            {
-                maxLength *= 2;
-                word = realloc(word, maxLength);
-            }
-            word[length] = c;
-            length++;
-        }
-        else if (length > 0 || c == EOF)
-        {
-            break;
-        }
-    }
-    if (length == 0)
-    {
-        free(word);
-        return NULL;
-    }
-    word[length] = '\0';
-    return word;
-}
-
-/**
- * Loads the contents of the file into the hash map.
- * @param file
- * @param map
- */
-void loadDictionary(FILE* file, HashMap* map)
-{
-    // FIXME: done
-    /* ensure arguments are valid */
-    assert((file != NULL) && (map != NULL));
-    // get next dictionary word from file
-    char * key = nextWord(file);
-    // until NULL terminator is reached in file, add each word from file to HashMap
-    while(key != NULL) {
-        // place key into hashmap with placeholder value of -1
-        hashMapPut(map, key, -1);
-        // since we allocate memory via nextWord and return pointer to it, free it after we add it
-        free(key);
-        // go on to next word in file
-        key = nextWord(file);
-    }
-}
-
-/**
- * Checks the spelling of the word provided by the user. If the word is spelled incorrectly,
- * print the 5 closest words as determined by a metric like the Levenshtein distance.
- * Otherwise, indicate that the provded word is spelled correctly. Use dictionary.txt to
- * create the dictionary.
- * @param argc
- * @param argv
- * @return
- */
-int main(int argc, const char** argv)
-{
-    // FIXME: implement
-    HashMap* map = hashMapNew(1000);
-
-    FILE* file = fopen("dictionary.txt", "r");
-    clock_t timer = clock();
-    loadDictionary(file, map);
-    timer = clock() - timer;
-    printf("Dictionary loaded in %f seconds\n", (float)timer / (float)CLOCKS_PER_SEC);
-    fclose(file);
-
-    char inputBuffer[256];
-    int quit = 0;
-
-    while (!quit)
-    {
-        printf("Enter a word or \"quit\" to quit: ");
-        scanf("%s", inputBuffer);
-        
-        // Implement the spell checker code here... 
-        for(int i = 0; i < strlen(inputBuffer); i++) {
-            inputBuffer[i] = tolower(inputBuffer[i]);
-        }
-        // if key is found, output as such
-        if(hashMapContainsKey(map, inputBuffer)) {
-            printf("The inputted word '%s' is spelled correctly. \n\n", inputBuffer);
-        }
-        // otherwise, go through dictionary and identify closest matches and store in closestTable
-        else {
-            // table to hold closest values, initialize to zero cus you have a ton of bugs baby
-            HashLink ** closestTable = malloc(sizeof(HashLink *) * 5);
-            for(int i=0; i<5; i++) {
-                closestTable[i] = NULL;
-            }
-             printf("The inputted word '%s' is spelled incorrectly. \n", inputBuffer);
-             for(int i = 0; i < map->capacity; i++) {
-                 HashLink * ptr = map->table[i];
-                 while(ptr != NULL) {
-                     // calculate distance between input and dictionary word
-                    int distance = levDistance(ptr->key, inputBuffer);
-                    ptr->value = distance;
-
-                    // used for debugging but need to run closest() to update table of closest matches
-                    if (closest(closestTable, ptr)) {
-                        //printf("LEV DISTANCE: %s & %s is %d | len: %d, %d \n", inputBuffer, ptr->key, distance, strlen(inputBuffer), strlen(ptr->key));
-                        //printf("LEV DISTANCE: %s & %s \n", inputBuffer, ptr->key);
-                    }
-                    
-                    // traverse to next link
-                    ptr = ptr->next;
-                 }
-                 // idk why I have this but I added it during debugging and i'm afraid to get rid of it
-                 ptr = NULL;
-             }
-             printf("Did you mean...: ");
-             // output the 5 closest matches
-             for(int i=0; i<5; i++) {
-                 printf("%s ", closestTable[i]->key);
-             }
-             printf("? \n \n");
-
-             // idk why I have this but I added it during debugging and i'm afraid to get rid of it
-            for(int i=0; i<5; i++) {
-                closestTable[i] = NULL;
-            }
-            free(closestTable);
-        }
-        if (strcmp(inputBuffer, "quit") == 0)
-        {
-            quit = 1;
-        }
-        
-    }
-    hashMapDelete(map);
-    return 0;
-}
+/**
+ * CS 261 Data Structures
+ * SpellChecker
+ * Name: Dipan Patel (pateldip@oregonstate.edu)
+ * Date: 2020 Mar. 7
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "hashMap.h"
+#include "dictionary.h"
+#include "dictImage.h"
+#include "distance.h"
+#include "topK.h"
+#include "candidateStore.h"
+#include "searchPool.h"
+#include "symSpell.h"
+#include "bkTree.h"
+#include "document.h"
+#include "suggestCache.h"
+#include "frozenMap.h"
+#include "dawg.h"
+#include "dictOverlay.h"
+#include "stats.h"
+#include <assert.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/**
+ * The loaded dictionary: the hash map, a mapped image or a frozen map.
+ * Exactly one of them is non-NULL, except that a DAWG built from the words
+ * answers ahead of them and replaces the hash map. An overlay, when there is
+ * one, answers ahead of everything with its own changes applied.
+ */
+typedef struct WordSource
+{
+    HashMap* map;
+    DictImage* image;
+    FrozenMap* frozen;
+    Dawg* dawg;
+    DictOverlay* overlay;
+} WordSource;
+
+/**
+ * Returns 1 if the word is in the loaded dictionary and 0 otherwise.
+ * @param source
+ * @param word Lowercase word.
+ * @return 1 if the word is found, 0 otherwise.
+ */
+int wordSourceContains(WordSource* source, const char* word)
+{
+    if (source->overlay != NULL) {
+        return dictOverlayContainsKey(source->overlay, word);
+    }
+    if (source->dawg != NULL) {
+        return dawgContainsKey(source->dawg, word);
+    }
+    if (source->frozen != NULL) {
+        return frozenMapContainsKey(source->frozen, word);
+    }
+    if (source->image != NULL) {
+        return dictImageContainsKey(source->image, word);
+    }
+    return hashMapContainsKey(source->map, word);
+}
+
+/**
+ * Walks every word of whichever dictionary is loaded.
+ */
+typedef struct WordCursor
+{
+    WordSource* source;
+    int slot;
+    const char* word;
+    // Frequency class of the word last returned.
+    int frequency;
+} WordCursor;
+
+/**
+ * Starts a walk over the loaded dictionary.
+ * @param cursor
+ * @param source
+ */
+void wordCursorInit(WordCursor* cursor, WordSource* source)
+{
+    cursor->source = source;
+    if (source->map != NULL) {
+        // walking map->table directly misses links a resize has not moved yet
+        hashMapFinishResize(source->map);
+    }
+    cursor->slot = 0;
+    cursor->word = NULL;
+    cursor->frequency = 0;
+}
+
+/**
+ * Returns the next dictionary word and its length, or NULL once every word
+ * has been visited. The word's frequency class is left in cursor->frequency.
+ * @param cursor
+ * @param length Set to the length of the returned word.
+ * @return Next word or NULL.
+ */
+const char* wordCursorNext(WordCursor* cursor, int* length)
+{
+    WordSource* source = cursor->source;
+    if (source->dawg != NULL) {
+        // in sorted order
+        if (cursor->slot >= source->dawg->wordCount) {
+            return NULL;
+        }
+        CandidateStore* store = source->dawg->store;
+        int id = source->dawg->words[cursor->slot++];
+        cursor->word = candidateStoreWord(store, id);
+        cursor->frequency = store->frequencies[id];
+        *length = store->lengths[id];
+        return cursor->word;
+    }
+    if (source->frozen != NULL) {
+        if (cursor->slot >= frozenMapSize(source->frozen)) {
+            return NULL;
+        }
+        cursor->frequency = source->frozen->values[cursor->slot];
+        cursor->word = frozenMapKey(source->frozen, cursor->slot++);
+        *length = strlen(cursor->word);
+        return cursor->word;
+    }
+    if (source->image != NULL) {
+        // walk the image's string pool in place, no further than its word
+        // count, which sizes the frequency table
+        if (cursor->slot >= dictImageSize(source->image)) {
+            return NULL;
+        }
+        cursor->word = (cursor->word == NULL) ? dictImageFirstWord(source->image)
+                                              : dictImageNextWord(source->image, cursor->word);
+        if (cursor->word != NULL) {
+            *length = strlen(cursor->word);
+            cursor->frequency = dictImageFrequency(source->image, cursor->slot++);
+        }
+        return cursor->word;
+    }
+    while (cursor->slot < source->map->capacity) {
+        HashLink * ptr = source->map->table[cursor->slot++].link;
+        if (ptr != NULL) {
+            *length = ptr->length;
+            cursor->frequency = ptr->value;
+            return ptr->key;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Checks that the bit-parallel backend agrees with the DP kernel for every
+ * dictionary word against a set of common misspellings, both unbounded and
+ * at small bounds, that the weighted kernels give up exactly where their
+ * bound says and never score above Levenshtein, and that full candidate
+ * store scans pick the same suggestions with every backend, with the scan
+ * split over threads, when answered from the deletion index, the BK-tree and
+ * the DAWG.
+ * @param source
+ * @param store Candidate store holding the same words.
+ * @return Number of disagreements found.
+ */
+int selfTest(WordSource* source, CandidateStore* store)
+{
+    SearchPool* pool = searchPoolNew(store, 4);
+    SymSpellIndex* symSpell = symSpellBuild(store, SYMSPELL_DEFAULT_DISTANCE, SYMSPELL_DEFAULT_MAX_BYTES, 4);
+    BkTree* tree = bkTreeBuild(store);
+    Dawg* dawg = dawgBuild(store);
+    const char* samples[] = {
+        "teh", "recieve", "seperate", "definately", "occured", "untill", "wich", "acommodate",
+        "neccessary", "helo", "beleive", "goverment", "tommorow", "wierd", "thier", "a",
+        "xylophne", "pronounciation", "supercalifragilisticexpialidocious", "zzzzzzzzzzqqq"
+    };
+    int sampleCount = sizeof(samples) / sizeof(samples[0]);
+    int failures = 0;
+    long comparisons = 0;
+
+    for (int i = 0; i < sampleCount; i++) {
+        int sampleLength = strlen(samples[i]);
+        DistanceQuery dp;
+        DistanceQuery myers;
+        distanceQueryInit(&dp, DISTANCE_DP, samples[i], sampleLength);
+        distanceQueryInit(&myers, DISTANCE_MYERS, samples[i], sampleLength);
+
+        WordCursor cursor;
+        const char* word;
+        int length;
+        wordCursorInit(&cursor, source);
+        while ((word = wordCursorNext(&cursor, &length)) != NULL) {
+            int expected = levDistance(word, samples[i]);
+            // an unbounded run plus bounds on either side of the true distance
+            int bounds[] = { length + sampleLength, 0, 1, 2, 3, expected - 1, expected };
+            for (int b = 0; b < 7; b++) {
+                if (bounds[b] < 0) {
+                    continue;
+                }
+                int want = (expected <= bounds[b]) ? expected : bounds[b] + 1;
+                int gotDp = distanceQueryScore(&dp, word, length, bounds[b]);
+                int gotMyers = distanceQueryScore(&myers, word, length, bounds[b]);
+                comparisons++;
+                if (gotDp != want || gotMyers != want) {
+                    if (failures < 10) {
+                        printf("MISMATCH %s vs %s (bound %d): expected %d, dp %d, myers %d\n",
+                               samples[i], word, bounds[b], want, gotDp, gotMyers);
+                    }
+                    failures++;
+                }
+            }
+
+            // the weighted kernels must agree with themselves unbounded, and a
+            // transposition or a change of key can only make a word closer
+            int osa = osaDistanceBounded(word, length, samples[i], sampleLength, length + sampleLength, dp.rows);
+            int keys = keyboardDistanceBounded(word, length, samples[i], sampleLength,
+                                               (length + sampleLength) * KEYBOARD_INDEL_COST, dp.rows);
+            if (osa > expected || keys > expected * KEYBOARD_SUBSTITUTE_COST) {
+                if (failures < 10) {
+                    printf("MISMATCH %s vs %s: levenshtein %d, osa %d, keyboard %d\n",
+                           samples[i], word, expected, osa, keys);
+                }
+                failures++;
+            }
+            for (int bound = 0; bound <= 4; bound++) {
+                int gotOsa = osaDistanceBounded(word, length, samples[i], sampleLength, bound, dp.rows);
+                int gotKeys = keyboardDistanceBounded(word, length, samples[i], sampleLength, bound, dp.rows);
+                comparisons++;
+                if (gotOsa != ((osa <= bound) ? osa : bound + 1) || gotKeys != ((keys <= bound) ? keys : bound + 1)) {
+                    if (failures < 10) {
+                        printf("MISMATCH %s vs %s (bound %d): osa %d of %d, keyboard %d of %d\n",
+                               samples[i], word, bound, gotOsa, osa, gotKeys, keys);
+                    }
+                    failures++;
+                }
+            }
+        }
+
+        // whole scans must agree word for word across backends
+        // then the SIMD scan split over the pool's workers, the deletion index, the BK-tree and the DAWG
+        DistanceBackend backends[] = {
+            DISTANCE_DP, DISTANCE_MYERS, DISTANCE_SIMD, DISTANCE_SIMD, DISTANCE_MYERS, DISTANCE_MYERS, DISTANCE_DP
+        };
+        // at the smallest, the usual and the largest number of suggestions
+        int counts[] = { 1, SUGGESTION_COUNT, TOPK_MAX };
+        for (int c = 0; c < 3; c++) {
+            Suggestion sorted[7][TOPK_MAX];
+            int found[7];
+            for (int b = 0; b < 7; b++) {
+                DistanceQuery query;
+                distanceQueryInit(&query, backends[b], samples[i], sampleLength);
+                TopK table;
+                topKInit(&table, counts[c]);
+                if (b == 3) {
+                    searchPoolScan(pool, &query, &table);
+                }
+                else if (b == 5) {
+                    bkTreeQuery(tree, &query, DISTANCE_MAX_WORD, &table);
+                }
+                else if (b == 6) {
+                    dawgSearch(dawg, samples[i], sampleLength, DISTANCE_MAX_WORD, &table);
+                }
+                else if (b != 4 || symSpell == NULL || !symSpellSearch(symSpell, store, &query, &table)) {
+                    candidateStoreScan(store, &query, &table);
+                }
+                found[b] = topKSorted(&table, sorted[b]);
+            }
+            for (int b = 1; b < 7; b++) {
+                comparisons++;
+                if (found[b] != found[0]) {
+                    if (failures < 10) {
+                        printf("MISMATCH scanning for %s: backend %d found %d of %d words, dp found %d\n",
+                               samples[i], b, found[b], counts[c], found[0]);
+                    }
+                    failures++;
+                    continue;
+                }
+                for (int k = 0; k < found[0]; k++) {
+                    comparisons++;
+                    // the BK-tree holds its own copy of each word, so compare by content
+                    if (strcmp(sorted[b][k].word, sorted[0][k].word) != 0 ||
+                        sorted[b][k].distance != sorted[0][k].distance) {
+                        if (failures < 10) {
+                            printf("MISMATCH scanning for %s (k %d): backend %d picked %s (%d), dp picked %s (%d)\n",
+                                   samples[i], counts[c], b, sorted[b][k].word, sorted[b][k].distance,
+                                   sorted[0][k].word, sorted[0][k].distance);
+                        }
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+    dawgDelete(dawg);
+    bkTreeDelete(tree);
+    symSpellDelete(symSpell);
+    searchPoolDelete(pool);
+    printf("Self-test: %ld comparisons over %d samples, %d mismatches\n", comparisons, sampleCount, failures);
+    return failures;
+}
+
+/**
+ * Everything a suggestion lookup may use. Only store is required; the cache
+ * and the other indexes are tried first when present.
+ */
+typedef struct Suggester
+{
+    DistanceBackend backend;
+    // Suggestions wanted per misspelling, 1 to TOPK_MAX.
+    int count;
+    // Models other than DISTANCE_LEVENSHTEIN bypass the indexes, which are
+    // built on unit costs, and go to the pool or the scan.
+    DistanceModel model;
+    // Tenant overlay on store; it bypasses the indexes too, which know only
+    // the base words.
+    DictOverlay* overlay;
+    CandidateStore* store;
+    SearchPool* pool;
+    SymSpellIndex* symSpell;
+    BkTree* tree;
+    Dawg* dawg;
+    int dawgDistance;
+    SuggestCache* cache;
+    // Suggestions taking at least this many microseconds are logged to stderr
+    // with their counters; negative turns the log off.
+    long logMicros;
+} Suggester;
+
+/**
+ * Returns the current time in seconds, for throughput figures.
+ */
+static double wallSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Fills an empty suggestion table with the closest dictionary words to a word.
+ * Words seen recently are answered from the cache. Otherwise the deletion
+ * index answers on its own when k words lie within its distance, and then the
+ * DAWG when k words lie within dawgDistance; otherwise the BK-tree, the
+ * thread pool or a plain scan of the candidate store does, in that order of
+ * preference. Under a weighted cost model only the
+ * pool or the scan can answer, and with an overlay only the overlay does.
+ * @param suggester
+ * @param word Lowercase word, null terminated.
+ * @param length
+ * @param table Empty table of the k suggestions wanted.
+ * @return Name of whatever answered, for the query log.
+ */
+static const char* findSuggestions(Suggester* suggester, const char* word, int length, TopK* table)
+{
+    if (suggester->cache != NULL && suggestCacheGet(suggester->cache, word, table)) {
+        return "cache";
+    }
+    // prepare the query once; scoring a candidate then needs no allocation
+    DistanceQuery query;
+    if (distanceQueryInit(&query, suggester->backend, word, length) != 0) {
+        return "none";
+    }
+    distanceQuerySetModel(&query, suggester->model);
+    int indexed = (suggester->model == DISTANCE_LEVENSHTEIN && suggester->overlay == NULL);
+    const char* answeredBy = "symspell";
+    int answered = indexed && suggester->symSpell != NULL &&
+                   symSpellSearch(suggester->symSpell, suggester->store, &query, table);
+    if (!answered && indexed && suggester->dawg != NULL) {
+        answeredBy = "dawg";
+        answered = dawgSuggest(suggester->dawg, word, length, suggester->dawgDistance, table);
+    }
+    if (suggester->overlay != NULL) {
+        answeredBy = "overlay";
+        dictOverlaySuggest(suggester->overlay, &query, suggester->pool, table);
+    }
+    else if (!answered && indexed && suggester->tree != NULL) {
+        answeredBy = "bktree";
+        bkTreeQuery(suggester->tree, &query, DISTANCE_MAX_WORD, table);
+    }
+    else if (!answered && suggester->pool != NULL) {
+        answeredBy = "pool";
+        searchPoolScan(suggester->pool, &query, table);
+    }
+    else if (!answered) {
+        answeredBy = "scan";
+        // score the length buckets closest to the query first, giving up on a word
+        // once it can no longer beat the current k-th best
+        candidateStoreScan(suggester->store, &query, table);
+    }
+    if (suggester->cache != NULL) {
+        suggestCachePut(suggester->cache, word, table);
+    }
+    return answeredBy;
+}
+
+/**
+ * Writes a string as a JSON string literal.
+ */
+static void printJsonString(FILE* out, const char* text)
+{
+    fputc('"', out);
+    for (const char* p = text; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        }
+        else if ((unsigned char) *p < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned char) *p);
+        }
+        else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/**
+ * Fills an empty suggestion table with the closest dictionary words to a
+ * word; see findSuggestions. Times the lookup into the counters and, when it
+ * is slower than logMicros, writes one JSON line to stderr with the word's
+ * shape, what answered it and the counters it moved.
+ * @param suggester
+ * @param word Lowercase word, null terminated.
+ * @param length
+ * @param table Empty table of the k suggestions wanted.
+ */
+void suggest(Suggester* suggester, const char* word, int length, TopK* table)
+{
+    SpellStats before;
+    if (suggester->logMicros >= 0) {
+        spellStatsSnapshot(&before);
+    }
+    double start = wallSeconds();
+    const char* answeredBy = findSuggestions(suggester, word, length, table);
+    double micros = (wallSeconds() - start) * 1e6;
+    STATS_ADD(suggestions, 1);
+    STATS_ADD(suggestNanos, micros * 1e3);
+    STATS_MAX(suggestMaxNanos, micros * 1e3);
+
+    if (suggester->logMicros >= 0 && micros >= suggester->logMicros) {
+        SpellStats after;
+        SpellStats delta;
+        spellStatsSnapshot(&after);
+        spellStatsSubtract(&delta, &after, &before);
+        fprintf(stderr, "{\"word\": ");
+        printJsonString(stderr, word);
+        fprintf(stderr, ", \"length\": %d, \"micros\": %.1f, \"answeredBy\": \"%s\", \"counters\": ",
+                length, micros, answeredBy);
+        spellStatsPrint(stderr, &delta, 1);
+        fprintf(stderr, "}\n");
+    }
+}
+
+/**
+ * Checks every word of a document and writes one line per misspelling:
+ * path, byte offset, word and suggestions, separated by tabs. Words are
+ * lowercased before lookup, as in interactive mode. Throughput is reported on
+ * stderr.
+ * @param path Document to check, or "-" for stdin.
+ * @param source
+ * @param suggester
+ * @return 0 on success, -1 if the document could not be opened.
+ */
+int checkDocument(const char* path, WordSource* source, Suggester* suggester)
+{
+    DocumentReader reader;
+    if (documentOpen(&reader, path) != 0) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return -1;
+    }
+
+    double start = wallSeconds();
+    long words = 0;
+    long misspelled = 0;
+    double suggesting = 0;
+    const char* token;
+    int length;
+    size_t offset;
+    char word[DISTANCE_MAX_WORD];
+    while ((token = documentNextWord(&reader, &length, &offset)) != NULL) {
+        words++;
+        // lowercase into a fixed buffer; words too long for it cannot be in the dictionary
+        int fits = length < DISTANCE_MAX_WORD;
+        int copied = fits ? length : DISTANCE_MAX_WORD - 1;
+        for (int i = 0; i < copied; i++) {
+            word[i] = tolower((unsigned char) token[i]);
+        }
+        word[copied] = '\0';
+        if (fits && wordSourceContains(source, word)) {
+            continue;
+        }
+
+        misspelled++;
+        printf("%s\t%zu\t%.*s\t", path, offset, length, token);
+        if (fits) {
+            TopK table;
+            topKInit(&table, suggester->count);
+            double suggestStart = wallSeconds();
+            suggest(suggester, word, length, &table);
+            suggesting += wallSeconds() - suggestStart;
+            Suggestion sorted[TOPK_MAX];
+            int found = topKSorted(&table, sorted);
+            for (int i = 0; i < found; i++) {
+                printf(i == 0 ? "%s" : " %s", sorted[i].word);
+            }
+        }
+        printf("\n");
+    }
+
+    double elapsed = wallSeconds() - start;
+    double megabytes = documentBytesRead(&reader) / (1024.0 * 1024.0);
+    fprintf(stderr, "%s: %.2f MB in %.3f seconds (%.1f MB/s), %ld words, %ld misspelled, "
+            "%.3f seconds finding suggestions\n",
+            path, megabytes, elapsed, elapsed > 0 ? megabytes / elapsed : 0.0, words, misspelled, suggesting);
+    SuggestCache* cache = suggester->cache;
+    if (cache != NULL) {
+        fprintf(stderr, "Suggestion cache: %ld hits, %ld misses, %ld evictions, %ld invalidations\n",
+                cache->hits, cache->misses, cache->evictions, cache->invalidations);
+    }
+    documentClose(&reader);
+    return 0;
+}
+
+/**
+ * Prints table occupancy and the probe length histogram for the map.
+ * @param map
+ * @param out Stream to print to.
+ */
+void printTableStats(HashMap* map, FILE* out)
+{
+    int histogram[16];
+    int longest = hashMapProbeHistogram(map, histogram, 16);
+    fprintf(out, "Table: %d words in %d slots (load %.2f), %d empty slots, %zu bytes\n",
+           hashMapSize(map), hashMapCapacity(map), hashMapTableLoad(map), hashMapEmptyBuckets(map),
+           hashMapMemoryUsage(map));
+    fprintf(out, "Probe lengths (longest %d):\n", longest + 1);
+    for (int i = 0; i < 16; i++) {
+        if (histogram[i] > 0) {
+            fprintf(out, "  %2d%s: %d\n", i + 1, (i == 15) ? "+" : " ", histogram[i]);
+        }
+    }
+}
+
+/**
+ * Checks the spelling of the word provided by the user. If the word is spelled incorrectly,
+ * print the 5 closest words as determined by a metric like the Levenshtein distance.
+ * Otherwise, indicate that the provded word is spelled correctly. Use dictionary.txt to
+ * create the dictionary.
+ * @param argc
+ * @param argv
+ * @return
+ */
+int main(int argc, const char** argv)
+{
+    HashMap* map = NULL;
+    DictImage* image = NULL;
+    const char* imagePath = NULL;
+    const char* frozenPath = NULL;
+    int showStats = 0;
+    int runSelfTest = 0;
+    int threadCount = 1;
+    int loadThreads = 0;
+    int symSpellDistance = 0;
+    size_t symSpellMaxBytes = SYMSPELL_DEFAULT_MAX_BYTES;
+    const char* treePath = NULL;
+    const char* overlayPath = NULL;
+    int dawgDistance = 0;
+    const char** documents = NULL;
+    int documentCount = 0;
+    int batch = 0;
+    int cacheCapacity = SUGGEST_CACHE_DEFAULT_CAPACITY;
+    const char* countersFormat = NULL;
+    long logMicros = -1;
+    DistanceBackend backend = DISTANCE_SIMD;
+    DistanceModel model = DISTANCE_LEVENSHTEIN;
+    int suggestionCount = SUGGESTION_COUNT;
+
+    // --stats prints how well the hash function spreads the dictionary
+    // --image <path> maps a prebuilt image from dictCompile instead of parsing dictionary.txt
+    // --frozen <path> maps a perfect-hash dictionary, building it from dictionary.txt and saving it there first
+    //     if the file does not exist yet
+    // --backend dp|myers|simd picks the distance kernel used for suggestions
+    // --costs levenshtein|osa|keyboard picks what an edit costs when ranking suggestions; osa and keyboard
+    //     count adjacent swaps as one edit, keyboard also makes neighbouring keys cheap to confuse, and both
+    //     are scored by a plain scan (or --threads), ignoring --symspell, --bktree and --dawg for suggestions
+    // --suggestions N offers the N closest words for each misspelling (1 to 20, default 5)
+    // --threads N splits each suggestion scan over N workers (0 = one per CPU)
+    // --load-threads N loads dictionary.txt on N threads (default 0 = one per CPU)
+    // --symspell [N] answers suggestions from a deletion index of edit distance N (default 2)
+    // --symspell-cap MB caps the memory the deletion index may use
+    // --bktree [path] answers suggestions from a BK-tree, loaded from path or built and saved there
+    // --dawg [N] builds a DAWG from the words; it answers lookups in place of the hash map, and suggestions
+    //     when 5 words lie within edit distance N (default 2)
+    // --overlay <path> layers a tenant word list over the dictionary: "word [count]" lines add words and
+    //     "-word" lines remove them, for lookups and suggestions alike
+    // --cache N keeps the suggestions for the last N distinct misspellings (0 = no cache)
+    // --batch [file ...] checks whole documents (stdin if none are given) and prints each misspelling
+    // --counters [text|json] prints the hot-path counters on exit (build with -DSPELL_STATS to fill them)
+    // --query-log USEC writes a JSON line to stderr for every suggestion taking at least USEC microseconds
+    // --selftest checks the distance backends agree over the whole dictionary and exits
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            showStats = 1;
+        }
+        else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+            imagePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--frozen") == 0 && i + 1 < argc) {
+            frozenPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "dp") == 0) {
+                backend = DISTANCE_DP;
+            }
+            else if (strcmp(argv[i], "myers") == 0) {
+                backend = DISTANCE_MYERS;
+            }
+            else {
+                backend = DISTANCE_SIMD;
+            }
+        }
+        else if (strcmp(argv[i], "--costs") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "osa") == 0) {
+                model = DISTANCE_OSA;
+            }
+            else if (strcmp(argv[i], "keyboard") == 0) {
+                model = DISTANCE_KEYBOARD;
+            }
+            else {
+                model = DISTANCE_LEVENSHTEIN;
+            }
+        }
+        else if (strcmp(argv[i], "--suggestions") == 0 && i + 1 < argc) {
+            suggestionCount = atoi(argv[++i]);
+            if (suggestionCount < 1 || suggestionCount > TOPK_MAX) {
+                fprintf(stderr, "--suggestions takes 1 to %d\n", TOPK_MAX);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--load-threads") == 0 && i + 1 < argc) {
+            loadThreads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--symspell") == 0) {
+            symSpellDistance = SYMSPELL_DEFAULT_DISTANCE;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) {
+                symSpellDistance = atoi(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "--symspell-cap") == 0 && i + 1 < argc) {
+            symSpellMaxBytes = (size_t) atol(argv[++i]) * 1024 * 1024;
+        }
+        else if (strcmp(argv[i], "--bktree") == 0) {
+            treePath = "dictionary.bkt";
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                treePath = argv[++i];
+            }
+        }
+        else if (strcmp(argv[i], "--dawg") == 0) {
+            dawgDistance = DAWG_DEFAULT_DISTANCE;
+            if (i + 1 < argc && isdigit((unsigned char) argv[i + 1][0])) {
+                dawgDistance = atoi(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cacheCapacity = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--batch") == 0) {
+            batch = 1;
+            documents = argv + i + 1;
+            while (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                documentCount++;
+                i++;
+            }
+        }
+        else if (strcmp(argv[i], "--counters") == 0) {
+            countersFormat = "text";
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                countersFormat = argv[++i];
+            }
+        }
+        else if (strcmp(argv[i], "--query-log") == 0 && i + 1 < argc) {
+            logMicros = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--overlay") == 0 && i + 1 < argc) {
+            overlayPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--selftest") == 0) {
+            runSelfTest = 1;
+        }
+    }
+
+    // progress goes to stderr in batch mode so stdout holds only the report
+    FILE* progress = batch ? stderr : stdout;
+    clock_t timer = clock();
+    FrozenMap* frozen = (frozenPath != NULL) ? frozenMapOpen(frozenPath) : NULL;
+    if (frozen != NULL) {
+        timer = clock() - timer;
+        fprintf(progress, "Frozen dictionary mapped in %f seconds\n", (float)timer / (float)CLOCKS_PER_SEC);
+    }
+    else if (imagePath != NULL) {
+        image = dictImageOpen(imagePath);
+        if (image == NULL) {
+            fprintf(stderr, "Could not open dictionary image %s\n", imagePath);
+            return 1;
+        }
+        timer = clock() - timer;
+        fprintf(progress, "Dictionary image mapped in %f seconds\n", (float)timer / (float)CLOCKS_PER_SEC);
+    }
+    else {
+        // wall time, since clock() adds up the loader threads
+        double loadStart = wallSeconds();
+        map = hashMapNew(1000);
+        if (loadDictionaryParallel("dictionary.txt", map, loadThreads) != 0) {
+            fprintf(stderr, "Could not read dictionary.txt\n");
+            return 1;
+        }
+        fprintf(progress, "Dictionary loaded in %f seconds\n", wallSeconds() - loadStart);
+
+        if (showStats) {
+            printTableStats(map, progress);
+        }
+        if (frozenPath != NULL) {
+            // lookups go to the frozen copy from here on
+            timer = clock();
+            frozen = frozenMapBuild(map);
+            if (frozen == NULL || frozenMapSave(frozen, frozenPath) != 0) {
+                fprintf(stderr, "Could not save frozen dictionary to %s\n", frozenPath);
+            }
+            if (frozen != NULL) {
+                hashMapDelete(map);
+                map = NULL;
+            }
+            timer = clock() - timer;
+            fprintf(progress, "Dictionary frozen in %f seconds\n", (float)timer / (float)CLOCKS_PER_SEC);
+        }
+    }
+    if (showStats && frozen != NULL) {
+        fprintf(progress, "Frozen dictionary: %d words, %zu bytes (%.1f per word)\n", frozenMapSize(frozen),
+                frozenMapMemoryUsage(frozen), (double) frozenMapMemoryUsage(frozen) / frozenMapSize(frozen));
+    }
+    WordSource source = { map, image, frozen, NULL, NULL };
+
+    // lay the words out for batch scoring, whichever source they came from
+    CandidateStore* store = candidateStoreNew();
+    WordCursor cursor;
+    const char* word;
+    int length;
+    wordCursorInit(&cursor, &source);
+    while ((word = wordCursorNext(&cursor, &length)) != NULL) {
+        candidateStoreAdd(store, word, length, cursor.frequency);
+    }
+    candidateStoreFinish(store);
+    if (showStats) {
+        fprintf(progress, "Suggestion kernel: %s\n", candidateStoreKernelName());
+    }
+
+    DictBase* base = NULL;
+    DictOverlay* overlay = NULL;
+    if (overlayPath != NULL) {
+        base = dictBaseNew(store);
+        overlay = dictOverlayNew(base);
+        int lines = dictOverlayLoad(overlay, overlayPath);
+        if (lines < 0) {
+            fprintf(stderr, "Could not read overlay %s\n", overlayPath);
+            dictOverlayDelete(overlay);
+            overlay = NULL;
+        }
+        else {
+            fprintf(progress, "Overlay %s: %d lines, %d words added, %d removed, %zu bytes over a %zu byte base index\n",
+                    overlayPath, lines, hashMapSize(overlay->added), overlay->hiddenCount,
+                    dictOverlayMemoryUsage(overlay), hashMapMemoryUsage(base->ids));
+            source.overlay = overlay;
+        }
+    }
+
+    Dawg* dawg = NULL;
+    if (dawgDistance > 0) {
+        timer = clock();
+        dawg = dawgBuild(store);
+        timer = clock() - timer;
+        if (dawg == NULL) {
+            fprintf(stderr, "Could not build DAWG\n");
+        }
+        else {
+            fprintf(progress, "DAWG: %d words, %d states, %d edges, %zu bytes, built in %f seconds\n",
+                    dawg->wordCount, dawg->stateCount, dawg->edgeCount, dawgMemoryUsage(dawg),
+                    (float)timer / (float)CLOCKS_PER_SEC);
+            source.dawg = dawg;
+            if (map != NULL) {
+                // lookups go to the DAWG from here on
+                hashMapDelete(map);
+                map = NULL;
+                source.map = NULL;
+            }
+        }
+    }
+
+    SearchPool* pool = (threadCount != 1) ? searchPoolNew(store, threadCount) : NULL;
+
+    SymSpellIndex* symSpell = NULL;
+    if (symSpellDistance > 0) {
+        timer = clock();
+        symSpell = symSpellBuild(store, symSpellDistance, symSpellMaxBytes,
+                                 threadCount > 1 ? threadCount : searchPoolDefaultThreads());
+        timer = clock() - timer;
+        if (symSpell == NULL) {
+            fprintf(progress, "Deletion index would exceed %zu MB; scanning instead\n",
+                    symSpellMaxBytes / (1024 * 1024));
+        }
+        else {
+            fprintf(progress, "Deletion index (distance %d): %zu keys, %zu postings, %.1f MB, built in %f seconds\n",
+                    symSpell->maxDistance, symSpell->keyCount, symSpell->postingCount,
+                    symSpellMemoryUsage(symSpell) / (1024.0 * 1024.0), (float)timer / (float)CLOCKS_PER_SEC);
+        }
+    }
+
+    BkTree* tree = NULL;
+    if (treePath != NULL) {
+        timer = clock();
+        tree = bkTreeLoad(treePath);
+        if (tree != NULL && tree->fingerprint != bkTreeFingerprint(store)) {
+            // saved from a different dictionary, or a different version of this one
+            bkTreeDelete(tree);
+            tree = NULL;
+        }
+        if (tree == NULL) {
+            tree = bkTreeBuild(store);
+            if (tree != NULL && bkTreeSave(tree, treePath) != 0) {
+                fprintf(stderr, "Could not save BK-tree to %s\n", treePath);
+            }
+            timer = clock() - timer;
+            fprintf(progress, "BK-tree built in %f seconds\n", (float)timer / (float)CLOCKS_PER_SEC);
+        }
+        else {
+            timer = clock() - timer;
+            fprintf(progress, "BK-tree mapped in %f seconds\n", (float)timer / (float)CLOCKS_PER_SEC);
+        }
+    }
+
+    if (runSelfTest) {
+        int failures = selfTest(&source, store);
+        dictOverlayDelete(overlay);
+        dictBaseDelete(base);
+        dawgDelete(dawg);
+        bkTreeDelete(tree);
+        symSpellDelete(symSpell);
+        searchPoolDelete(pool);
+        candidateStoreDelete(store);
+        if (map != NULL) {
+            hashMapDelete(map);
+        }
+        dictImageClose(image);
+        frozenMapDelete(frozen);
+        return failures == 0 ? 0 : 1;
+    }
+
+    SuggestCache* cache = (cacheCapacity > 0) ? suggestCacheNew(cacheCapacity, map) : NULL;
+    Suggester suggester = { backend, suggestionCount, model, overlay, store, pool, symSpell, tree, dawg, dawgDistance, cache, logMicros };
+    int exitCode = 0;
+    if (batch) {
+        // stdout carries the report, so keep it fully buffered
+        setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+        if (documentCount == 0) {
+            exitCode = checkDocument("-", &source, &suggester) != 0;
+        }
+        for (int i = 0; i < documentCount; i++) {
+            if (checkDocument(documents[i], &source, &suggester) != 0) {
+                exitCode = 1;
+            }
+        }
+    }
+
+    char inputBuffer[256];
+    int quit = batch;
+
+    while (!quit)
+    {
+        printf("Enter a word or \"quit\" to quit: ");
+        scanf("%s", inputBuffer);
+        
+        // :stats and :stats-json dump the counters gathered so far
+        if (strcmp(inputBuffer, ":stats") == 0 || strcmp(inputBuffer, ":stats-json") == 0) {
+            SpellStats stats;
+            spellStatsSnapshot(&stats);
+            spellStatsPrint(stdout, &stats, strcmp(inputBuffer, ":stats-json") == 0);
+            printf("\n");
+            continue;
+        }
+
+        // Implement the spell checker code here... 
+        size_t inputLength = strlen(inputBuffer);
+        for (size_t i = 0; i < inputLength; i++) {
+            inputBuffer[i] = tolower((unsigned char) inputBuffer[i]);
+        }
+        // if key is found, output as such
+        int found = wordSourceContains(&source, inputBuffer);
+        if(found) {
+            printf("The inputted word '%s' is spelled correctly. \n\n", inputBuffer);
+        }
+        // otherwise, go through dictionary and identify closest matches and store in closestTable
+        else {
+            // table to hold closest values, initialize to zero cus you have a ton of bugs baby
+            TopK closestTable;
+            topKInit(&closestTable, suggester.count);
+             printf("The inputted word '%s' is spelled incorrectly. \n", inputBuffer);
+             // update table of closest matches
+             suggest(&suggester, inputBuffer, strlen(inputBuffer), &closestTable);
+             printf("Did you mean...: ");
+             // output the closest matches, best first; a tiny dictionary may have fewer than asked for
+             Suggestion sorted[TOPK_MAX];
+             int count = topKSorted(&closestTable, sorted);
+             for(int i=0; i<count; i++) {
+                 printf("%s ", sorted[i].word);
+             }
+             printf("? \n \n");
+        }
+        if (strcmp(inputBuffer, "quit") == 0)
+        {
+            quit = 1;
+        }
+        
+    }
+    if (countersFormat != NULL) {
+        SpellStats stats;
+        spellStatsSnapshot(&stats);
+        spellStatsPrint(progress, &stats, strcmp(countersFormat, "json") == 0);
+        if (strcmp(countersFormat, "json") == 0) {
+            fprintf(progress, "\n");
+        }
+    }
+    suggestCacheDelete(cache);
+    dictOverlayDelete(overlay);
+    dictBaseDelete(base);
+    dawgDelete(dawg);
+    bkTreeDelete(tree);
+    symSpellDelete(symSpell);
+    searchPoolDelete(pool);
+    candidateStoreDelete(store);
+    if (map != NULL) {
+        hashMapDelete(map);
+    }
+    dictImageClose(image);
+    frozenMapDelete(frozen);
+    return exitCode;
+}
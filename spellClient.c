@@ -0,0 +1,409 @@
+/*
+ * Client for spellServer.
+ *
+ * Usage: spellClient [--socket path | --tcp port] [--suggestions N] [--words N] [--depth N] [file ...]
+ *
+ * Checks documents (stdin if none are given) against a running spellServer
+ * and prints one line per misspelling exactly as spellChecker --batch does:
+ * path, byte offset, word and suggestions, separated by tabs. Words go out in
+ * requests of up to --words words (default 4096, fewer if the response
+ * could outgrow a frame for the --suggestions asked), and up to --depth requests
+ * (default 4) are in flight at once, so the tokenizer, the network and the
+ * server's workers overlap. Throughput is reported on stderr.
+ *
+ * Connects to spellServer.sock by default, or to 127.0.0.1:port with --tcp.
+ * Words longer than SPELL_WORD_MAX bytes are sent cut to that length.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "document.h"
+#include "spellProtocol.h"
+#include "topK.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CLIENT_WORDS 4096
+#define CLIENT_DEPTH 4
+
+typedef struct Batch Batch;
+typedef struct Client Client;
+
+/*
+ * One request: its frame, kept until the response arrives so the words can
+ * be printed next to their results, and each word's offset in its document.
+ */
+struct Batch
+{
+    const char* path;
+    uint32_t id;
+    int count;
+    size_t* offsets;
+    SpellBuffer frame;
+};
+
+struct Client
+{
+    int fd;
+    int suggestions;
+    int batchWords;
+    // Documents still to read; reader is open on documents[0] when open is set.
+    const char** documents;
+    int documentCount;
+    DocumentReader reader;
+    int open;
+    int exitCode;
+    // Ring of requests in flight: outstanding of them from first, the first
+    // sent of which are fully written.
+    Batch* batches;
+    int depth;
+    int first;
+    int outstanding;
+    int sent;
+    size_t sentBytes;
+    uint32_t nextId;
+    SpellBuffer input;
+    long words;
+    long misspelled;
+    long requests;
+};
+
+/**
+ * Tells whether a batch has no room for another word: it holds the most
+ * words a request may, or one more word of SPELL_WORD_MAX bytes could take
+ * the frame past SPELL_FRAME_MAX.
+ */
+static int batchFull(Client* client, Batch* batch)
+{
+    return batch->count == client->batchWords ||
+           batch->frame.length + 2 + SPELL_WORD_MAX > SPELL_FRAME_HEADER + SPELL_FRAME_MAX;
+}
+
+/**
+ * Fills a batch with the next words of the current document, moving on to
+ * the next document when it ends. A batch never spans two documents.
+ * @return 1 if the batch holds any words, 0 once every document is done.
+ */
+static int fillBatch(Client* client, Batch* batch)
+{
+    batch->count = 0;
+    batch->frame.length = 0;
+    while (client->documentCount > 0) {
+        const char* path = client->documents[0];
+        if (!client->open) {
+            if (documentOpen(&client->reader, path) != 0) {
+                fprintf(stderr, "Could not open %s\n", path);
+                client->exitCode = 1;
+                client->documents++;
+                client->documentCount--;
+                continue;
+            }
+            client->open = 1;
+        }
+        if (batch->count == 0) {
+            batch->path = path;
+            batch->id = client->nextId++;
+            spellFrameBegin(&batch->frame);
+            spellPut32(&batch->frame, batch->id);
+            spellPut8(&batch->frame, SPELL_OP_SUGGEST);
+            spellPut8(&batch->frame, client->suggestions);
+            // count is filled in once the batch is full
+            spellPut32(&batch->frame, 0);
+        }
+        const char* token;
+        int length;
+        size_t offset;
+        while (!batchFull(client, batch) &&
+               (token = documentNextWord(&client->reader, &length, &offset)) != NULL) {
+            spellPutWord(&batch->frame, token, length < SPELL_WORD_MAX ? length : SPELL_WORD_MAX);
+            batch->offsets[batch->count++] = offset;
+        }
+        if (batchFull(client, batch)) {
+            break;
+        }
+        // the document is done
+        documentClose(&client->reader);
+        client->open = 0;
+        client->documents++;
+        client->documentCount--;
+        if (batch->count > 0) {
+            break;
+        }
+        batch->frame.length = 0;
+    }
+    if (batch->count == 0) {
+        return 0;
+    }
+    // the count sits after the header, id, op and k
+    size_t at = SPELL_FRAME_HEADER + 6;
+    for (int i = 0; i < 4; i++) {
+        batch->frame.data[at + i] = (unsigned char) ((uint32_t) batch->count >> (8 * i));
+    }
+    spellFrameEnd(&batch->frame, 0);
+    client->words += batch->count;
+    return 1;
+}
+
+/**
+ * Prints the misspellings of a batch from its response.
+ * @return 0 on success, -1 if the response does not match the request.
+ */
+static int printResponse(Client* client, Batch* batch, const unsigned char* frame, size_t length)
+{
+    SpellReader response;
+    spellReaderInit(&response, frame, length);
+    uint32_t id = spellGet32(&response);
+    unsigned status = spellGet8(&response);
+    uint32_t count = spellGet32(&response);
+    if (status == SPELL_STATUS_TOO_LARGE) {
+        fprintf(stderr, "The server found request %u too large\n", batch->id);
+    }
+    if (response.overrun || id != batch->id || status != SPELL_STATUS_OK || count != (uint32_t) batch->count) {
+        return -1;
+    }
+    SpellReader request;
+    spellReaderInit(&request, batch->frame.data, batch->frame.length);
+    // past id, op, k and count
+    request.position += 10;
+    for (int i = 0; i < batch->count; i++) {
+        int wordLength;
+        const char* word = spellGetWord(&request, &wordLength);
+        if (spellGet8(&response)) {
+            continue;
+        }
+        client->misspelled++;
+        printf("%s\t%zu\t%.*s\t", batch->path, batch->offsets[i], wordLength, word);
+        unsigned found = spellGet8(&response);
+        for (unsigned j = 0; j < found; j++) {
+            int suggestionLength;
+            const char* suggestion = spellGetWord(&response, &suggestionLength);
+            printf(j == 0 ? "%.*s" : " %.*s", suggestionLength, suggestion);
+        }
+        printf("\n");
+    }
+    return response.overrun ? -1 : 0;
+}
+
+/**
+ * Writes as much of the unsent requests as the socket takes.
+ * @return 0 on success, -1 if the connection failed.
+ */
+static int sendBatches(Client* client)
+{
+    while (client->sent < client->outstanding) {
+        Batch* batch = &client->batches[(client->first + client->sent) % client->depth];
+        ssize_t written = send(client->fd, batch->frame.data + client->sentBytes,
+                               batch->frame.length - client->sentBytes, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return 0;
+            }
+            return -1;
+        }
+        client->sentBytes += written;
+        if (client->sentBytes == batch->frame.length) {
+            client->sent++;
+            client->sentBytes = 0;
+            client->requests++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Reads responses and prints each one against the oldest request in flight.
+ * @return 0 on success, -1 if the server closed the connection or answered
+ * out of turn.
+ */
+static int receiveResponses(Client* client)
+{
+    SpellBuffer* input = &client->input;
+    spellBufferReserve(input, 64 * 1024);
+    ssize_t got = read(client->fd, input->data + input->length, input->capacity - input->length);
+    if (got == 0) {
+        fprintf(stderr, "The server closed the connection\n");
+        return -1;
+    }
+    if (got < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    input->length += got;
+
+    size_t parsed = 0;
+    long length;
+    while ((length = spellFrameLength(input->data + parsed, input->length - parsed)) > 0) {
+        if (client->sent == 0) {
+            return -1;
+        }
+        Batch* batch = &client->batches[client->first];
+        if (printResponse(client, batch, input->data + parsed, length) != 0) {
+            fprintf(stderr, "Bad response to request %u\n", batch->id);
+            return -1;
+        }
+        parsed += length;
+        client->first = (client->first + 1) % client->depth;
+        client->outstanding--;
+        client->sent--;
+    }
+    spellBufferConsume(input, parsed);
+    return (length < 0) ? -1 : 0;
+}
+
+/**
+ * Connects to the server's Unix socket, or to the loopback port if port is
+ * not 0.
+ * @return The connected socket, or -1.
+ */
+static int connectServer(const char* path, int port)
+{
+    int fd;
+    int result;
+    if (port > 0) {
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        result = (fd < 0) ? -1 : connect(fd, (struct sockaddr*) &address, sizeof(address));
+    }
+    else {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        result = (fd < 0) ? -1 : connect(fd, (struct sockaddr*) &address, sizeof(address));
+    }
+    if (result != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+int main(int argc, const char** argv)
+{
+    const char* socketPath = "spellServer.sock";
+    int port = 0;
+    Client client;
+    memset(&client, 0, sizeof(client));
+    client.suggestions = SUGGESTION_COUNT;
+    client.batchWords = CLIENT_WORDS;
+    client.depth = CLIENT_DEPTH;
+    client.nextId = 1;
+    static const char* standardInput[] = { "-" };
+    client.documents = standardInput;
+    client.documentCount = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--tcp") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--suggestions") == 0 && i + 1 < argc) {
+            client.suggestions = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--words") == 0 && i + 1 < argc) {
+            client.batchWords = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            client.depth = atoi(argv[++i]);
+        }
+        else {
+            // the documents are the rest of the arguments
+            client.documents = argv + i;
+            client.documentCount = argc - i;
+            break;
+        }
+    }
+    if (client.suggestions < 1 || client.suggestions > TOPK_MAX || client.batchWords < 1 || client.depth < 1) {
+        fprintf(stderr, "--suggestions takes 1 to %d; --words and --depth must be positive\n", TOPK_MAX);
+        return 1;
+    }
+    uint32_t responseWords = spellResponseWords(SPELL_OP_SUGGEST, client.suggestions);
+    if ((uint32_t) client.batchWords > responseWords) {
+        client.batchWords = responseWords;
+    }
+
+    client.fd = connectServer(socketPath, port);
+    if (client.fd < 0) {
+        if (port > 0) {
+            fprintf(stderr, "Could not connect to 127.0.0.1:%d\n", port);
+        }
+        else {
+            fprintf(stderr, "Could not connect to %s\n", socketPath);
+        }
+        return 1;
+    }
+    client.batches = calloc(client.depth, sizeof(Batch));
+    for (int i = 0; i < client.depth; i++) {
+        client.batches[i].offsets = malloc(sizeof(size_t) * client.batchWords);
+    }
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int reading = 1;
+    int failed = 0;
+    while (!failed) {
+        while (reading && client.outstanding < client.depth) {
+            Batch* batch = &client.batches[(client.first + client.outstanding) % client.depth];
+            reading = fillBatch(&client, batch);
+            client.outstanding += reading;
+        }
+        if (client.outstanding == 0) {
+            break;
+        }
+        struct pollfd events = { client.fd, POLLIN, 0 };
+        if (client.sent < client.outstanding) {
+            events.events |= POLLOUT;
+        }
+        if (poll(&events, 1, -1) < 0) {
+            failed = (errno != EINTR);
+            continue;
+        }
+        if (events.revents & POLLOUT) {
+            failed = sendBatches(&client) != 0;
+        }
+        if (!failed && (events.revents & (POLLIN | POLLHUP | POLLERR))) {
+            failed = receiveResponses(&client) != 0;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fflush(stdout);
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%ld words in %ld requests, %ld misspelled, %.3f seconds (%.0f words/s)\n", client.words,
+            client.requests, client.misspelled, elapsed, elapsed > 0 ? client.words / elapsed : 0.0);
+    if (failed) {
+        fprintf(stderr, "Lost the connection to the server\n");
+        client.exitCode = 1;
+    }
+    if (client.open) {
+        documentClose(&client.reader);
+    }
+    for (int i = 0; i < client.depth; i++) {
+        free(client.batches[i].offsets);
+        spellBufferFree(&client.batches[i].frame);
+    }
+    free(client.batches);
+    spellBufferFree(&client.input);
+    close(client.fd);
+    return client.exitCode;
+}
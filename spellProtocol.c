@@ -0,0 +1,230 @@
+/*
+ * Wire format shared by spellServer and spellClient.
+ */
+
+#include "spellProtocol.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Frees a buffer's bytes and leaves it empty and reusable.
+ * @param buffer
+ */
+void spellBufferFree(SpellBuffer* buffer)
+{
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+/**
+ * Makes room for extra more bytes after the buffer's contents.
+ * @param buffer
+ * @param extra
+ */
+void spellBufferReserve(SpellBuffer* buffer, size_t extra)
+{
+    if (buffer->length + extra <= buffer->capacity) {
+        return;
+    }
+    size_t capacity = buffer->capacity * 2 + 256;
+    if (capacity < buffer->length + extra) {
+        capacity = buffer->length + extra;
+    }
+    buffer->data = realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+}
+
+/**
+ * Drops the first count bytes of the buffer, moving the rest to the front.
+ * @param buffer
+ * @param count At most the buffer's length.
+ */
+void spellBufferConsume(SpellBuffer* buffer, size_t count)
+{
+    assert(count <= buffer->length);
+    memmove(buffer->data, buffer->data + count, buffer->length - count);
+    buffer->length -= count;
+}
+
+/**
+ * Appends the low byte of value.
+ */
+void spellPut8(SpellBuffer* buffer, unsigned value)
+{
+    spellBufferReserve(buffer, 1);
+    buffer->data[buffer->length++] = (unsigned char) value;
+}
+
+/**
+ * Appends the low 16 bits of value, little-endian.
+ */
+void spellPut16(SpellBuffer* buffer, unsigned value)
+{
+    spellBufferReserve(buffer, 2);
+    buffer->data[buffer->length++] = (unsigned char) value;
+    buffer->data[buffer->length++] = (unsigned char) (value >> 8);
+}
+
+/**
+ * Appends value, little-endian.
+ */
+void spellPut32(SpellBuffer* buffer, uint32_t value)
+{
+    spellBufferReserve(buffer, 4);
+    for (int i = 0; i < 4; i++) {
+        buffer->data[buffer->length++] = (unsigned char) (value >> (8 * i));
+    }
+}
+
+/**
+ * Appends a word as its u16 length and bytes.
+ * @param buffer
+ * @param word
+ * @param length At most SPELL_WORD_MAX.
+ */
+void spellPutWord(SpellBuffer* buffer, const char* word, int length)
+{
+    assert((length >= 0) && (length <= SPELL_WORD_MAX));
+    spellPut16(buffer, length);
+    spellBufferReserve(buffer, length);
+    memcpy(buffer->data + buffer->length, word, length);
+    buffer->length += length;
+}
+
+/**
+ * Starts a frame at the end of the buffer, leaving room for its length.
+ * @param buffer
+ * @return Where the frame starts, for spellFrameEnd.
+ */
+size_t spellFrameBegin(SpellBuffer* buffer)
+{
+    size_t start = buffer->length;
+    spellPut32(buffer, 0);
+    return start;
+}
+
+/**
+ * Fills in the length of a frame once its body has been appended.
+ * @param buffer
+ * @param start Value spellFrameBegin returned.
+ */
+void spellFrameEnd(SpellBuffer* buffer, size_t start)
+{
+    uint32_t length = buffer->length - start - SPELL_FRAME_HEADER;
+    for (int i = 0; i < 4; i++) {
+        buffer->data[start + i] = (unsigned char) (length >> (8 * i));
+    }
+}
+
+/**
+ * Tells whether a whole frame has arrived at the start of data.
+ * @param data
+ * @param available Bytes received so far.
+ * @return Length of the frame including its header, 0 if more bytes are
+ * needed, or -1 if the frame is longer than SPELL_FRAME_MAX.
+ */
+long spellFrameLength(const unsigned char* data, size_t available)
+{
+    if (available < SPELL_FRAME_HEADER) {
+        return 0;
+    }
+    uint32_t length = data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24;
+    if (length > SPELL_FRAME_MAX) {
+        return -1;
+    }
+    return (available >= SPELL_FRAME_HEADER + length) ? (long) (SPELL_FRAME_HEADER + length) : 0;
+}
+
+/**
+ * Returns how many words a request can carry so that its response is sure
+ * to fit in SPELL_FRAME_MAX, counting every misspelling of a suggest request
+ * as k suggestions of SPELL_SUGGESTION_MAX bytes.
+ * @param op SPELL_OP_CHECK or SPELL_OP_SUGGEST.
+ * @param k Suggestions wanted per misspelling, for SPELL_OP_SUGGEST.
+ * @return Most words per request.
+ */
+uint32_t spellResponseWords(unsigned op, unsigned k)
+{
+    // id, status and count
+    size_t header = 9;
+    size_t perWord = 1;
+    if (op == SPELL_OP_SUGGEST) {
+        perWord += 1 + (size_t) k * (2 + SPELL_SUGGESTION_MAX);
+    }
+    return (SPELL_FRAME_MAX - header) / perWord;
+}
+
+/**
+ * Starts reading the body of a whole frame.
+ * @param reader
+ * @param frame Frame including its header.
+ * @param length Length spellFrameLength returned.
+ */
+void spellReaderInit(SpellReader* reader, const unsigned char* frame, size_t length)
+{
+    reader->data = frame;
+    reader->length = length;
+    reader->position = SPELL_FRAME_HEADER;
+    reader->overrun = 0;
+}
+
+/**
+ * Claims count bytes of the frame, or returns NULL and marks the reader
+ * overrun if there are not that many left.
+ */
+static const unsigned char* take(SpellReader* reader, size_t count)
+{
+    if (reader->overrun || reader->length - reader->position < count) {
+        reader->overrun = 1;
+        return NULL;
+    }
+    const unsigned char* p = reader->data + reader->position;
+    reader->position += count;
+    return p;
+}
+
+/**
+ * Reads a byte, or 0 past the end of the frame.
+ */
+unsigned spellGet8(SpellReader* reader)
+{
+    const unsigned char* p = take(reader, 1);
+    return (p == NULL) ? 0 : p[0];
+}
+
+/**
+ * Reads a little-endian u16, or 0 past the end of the frame.
+ */
+unsigned spellGet16(SpellReader* reader)
+{
+    const unsigned char* p = take(reader, 2);
+    return (p == NULL) ? 0 : (p[0] | (unsigned) p[1] << 8);
+}
+
+/**
+ * Reads a little-endian u32, or 0 past the end of the frame.
+ */
+uint32_t spellGet32(SpellReader* reader)
+{
+    const unsigned char* p = take(reader, 4);
+    return (p == NULL) ? 0 : (p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+}
+
+/**
+ * Reads a u16 length and that many bytes.
+ * @param reader
+ * @param length Set to the word's length.
+ * @return The word, not null terminated, or NULL if the frame ends first.
+ */
+const char* spellGetWord(SpellReader* reader, int* length)
+{
+    *length = spellGet16(reader);
+    const unsigned char* p = take(reader, *length);
+    if (p == NULL) {
+        *length = 0;
+    }
+    return (const char*) p;
+}
@@ -0,0 +1,97 @@
+#ifndef SPELL_PROTOCOL_H
+#define SPELL_PROTOCOL_H
+
+/*
+ * Wire format shared by spellServer and spellClient.
+ *
+ * Every message is a frame: a 4-byte body length, then the body. Integers
+ * are little-endian. A request body is
+ *   u32 id        chosen by the client and echoed in the response
+ *   u8  op        SPELL_OP_CHECK or SPELL_OP_SUGGEST
+ *   u8  k         suggestions wanted per misspelling, 1 to TOPK_MAX, for
+ *                 SPELL_OP_SUGGEST; ignored for SPELL_OP_CHECK
+ *   u32 count     words in the batch
+ *   count words, each a u16 length and that many bytes
+ * and the response body is
+ *   u32 id
+ *   u8  status    SPELL_STATUS_OK, or SPELL_STATUS_BAD_REQUEST or
+ *                 SPELL_STATUS_TOO_LARGE with count 0
+ *   u32 count     one result per request word, in request order
+ *   count results, each a u8 that is 1 if the word is spelled correctly;
+ *   for SPELL_OP_SUGGEST a misspelling's result goes on with a u8 number of
+ *   suggestions and each suggestion as a u16 length and its bytes.
+ *
+ * Suggestions longer than SPELL_SUGGESTION_MAX are left out, so a response
+ * has a worst-case size known from the request alone. A request with more
+ * words than spellResponseWords allows for its op and k could need a
+ * response over SPELL_FRAME_MAX and is answered SPELL_STATUS_TOO_LARGE
+ * without being checked.
+ *
+ * A client may send any number of requests without waiting for responses;
+ * each connection gets its responses in the order it sent the requests.
+ * Batching thousands of words into one request makes a round trip cost
+ * about as much as the lookups themselves.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest frame body either side accepts; a peer sending more is dropped.
+#define SPELL_FRAME_MAX (16 * 1024 * 1024)
+#define SPELL_FRAME_HEADER 4
+// Longest word a frame can carry.
+#define SPELL_WORD_MAX 65535
+// Longest suggestion a response carries.
+#define SPELL_SUGGESTION_MAX 256
+
+#define SPELL_OP_CHECK 1
+#define SPELL_OP_SUGGEST 2
+
+#define SPELL_STATUS_OK 0
+#define SPELL_STATUS_BAD_REQUEST 1
+#define SPELL_STATUS_TOO_LARGE 2
+
+typedef struct SpellBuffer SpellBuffer;
+typedef struct SpellReader SpellReader;
+
+/*
+ * A growable byte buffer for building frames and holding socket data.
+ */
+struct SpellBuffer
+{
+    unsigned char* data;
+    size_t length;
+    size_t capacity;
+};
+
+/*
+ * Reads integers and words out of a frame body, remembering whether it ran
+ * past the end so a malformed frame can be checked once at the end.
+ */
+struct SpellReader
+{
+    const unsigned char* data;
+    size_t length;
+    size_t position;
+    int overrun;
+};
+
+void spellBufferFree(SpellBuffer* buffer);
+void spellBufferReserve(SpellBuffer* buffer, size_t extra);
+void spellBufferConsume(SpellBuffer* buffer, size_t count);
+void spellPut8(SpellBuffer* buffer, unsigned value);
+void spellPut16(SpellBuffer* buffer, unsigned value);
+void spellPut32(SpellBuffer* buffer, uint32_t value);
+void spellPutWord(SpellBuffer* buffer, const char* word, int length);
+size_t spellFrameBegin(SpellBuffer* buffer);
+void spellFrameEnd(SpellBuffer* buffer, size_t start);
+long spellFrameLength(const unsigned char* data, size_t available);
+uint32_t spellResponseWords(unsigned op, unsigned k);
+
+void spellReaderInit(SpellReader* reader, const unsigned char* frame, size_t length);
+unsigned spellGet8(SpellReader* reader);
+unsigned spellGet16(SpellReader* reader);
+uint32_t spellGet32(SpellReader* reader);
+const char* spellGetWord(SpellReader* reader, int* length);
+
+#endif
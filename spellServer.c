@@ -0,0 +1,835 @@
+/*
+ * Spell-check daemon.
+ *
+ * Usage: spellServer [--dictionary path] [--socket path] [--tcp port] [--workers N]
+ *
+ * Loads the dictionary (a word list, or an image from dictCompile) once into
+ * a Checker and answers spellProtocol requests on a Unix domain socket
+ * (default spellServer.sock) and, with --tcp, on 127.0.0.1:port, so every
+ * client process shares one copy instead of loading its own.
+ *
+ * One thread runs an epoll loop that accepts connections, cuts the bytes
+ * they send into frames and writes responses back. Each whole request is
+ * queued for a pool of --workers threads (default one per CPU), which each
+ * keep a CheckerContext and answer a batch of words at a time without
+ * allocating. Finished requests come back to the loop through a list and an
+ * eventfd, and go out on their connection in the order they were sent.
+ *
+ * A connection with SERVER_MAX_PENDING requests in flight, or more than
+ * SERVER_OUTPUT_LIMIT bytes of responses it has not read yet, is not read
+ * from until it catches up. SIGINT or SIGTERM stops the server and removes
+ * the socket.
+ */
+
+#define _GNU_SOURCE
+
+#include "checker.h"
+#include "spellProtocol.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// Requests a connection may have read but not yet answered.
+#define SERVER_MAX_PENDING 64
+// Unsent response bytes past which a connection is not read from.
+#define SERVER_OUTPUT_LIMIT (4 * 1024 * 1024)
+// Bytes asked of the socket per read.
+#define SERVER_READ_SIZE (64 * 1024)
+#define SERVER_EVENTS 64
+
+typedef struct Endpoint Endpoint;
+typedef struct Job Job;
+typedef struct Connection Connection;
+typedef struct Server Server;
+
+typedef enum EndpointKind
+{
+    ENDPOINT_LISTENER,
+    ENDPOINT_CONNECTION,
+    ENDPOINT_WAKE,
+    ENDPOINT_SIGNAL
+} EndpointKind;
+
+/*
+ * Anything registered with epoll; the event's pointer is to one of these.
+ */
+struct Endpoint
+{
+    EndpointKind kind;
+    int fd;
+};
+
+/*
+ * One request on its way through the workers.
+ */
+struct Job
+{
+    Connection* connection;
+    // Position of the request among those read from its connection.
+    unsigned long sequence;
+    // The whole request frame, and the response frame a worker builds.
+    SpellBuffer request;
+    SpellBuffer response;
+    // Words answered, 0 for a bad request.
+    uint32_t words;
+    Job* next;
+};
+
+struct Connection
+{
+    // First, so an epoll pointer to it is also a pointer to the connection.
+    Endpoint endpoint;
+    SpellBuffer input;
+    SpellBuffer output;
+    // Bytes at the front of output already written.
+    size_t outputSent;
+    // Sequence for the next request read, and of the next response to write.
+    unsigned long nextSequence;
+    unsigned long nextResponse;
+    // Requests read whose responses are not in output yet.
+    int pending;
+    // Answered ahead of an earlier request, sorted by sequence.
+    Job* ready;
+    // The peer will send nothing more.
+    int readClosed;
+    // The socket is closed; the connection is freed once pending reaches 0.
+    // Workers read it to stop answering requests nobody will read.
+    atomic_int closed;
+    uint32_t events;
+    Connection* prev;
+    Connection* next;
+};
+
+struct Server
+{
+    Checker* checker;
+    int epoll;
+    Endpoint wake;
+    Endpoint signals;
+    Endpoint listeners[2];
+    int listenerCount;
+    const char* socketPath;
+    pthread_t* workers;
+    int workerCount;
+
+    // Queue of requests for the workers and the list of answered ones,
+    // under lock. Workers wait on available.
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    Job* queueHead;
+    Job* queueTail;
+    Job* finished;
+    int stopping;
+
+    // Only the event loop touches these.
+    Connection* connections;
+    // Closed connections to free at the end of the current batch of events,
+    // which may still mention them.
+    Connection* closedConnections;
+    // Answered jobs kept for reuse, with their buffers.
+    Job* spareJobs;
+    long connectionCount;
+    long requestCount;
+    long wordCount;
+};
+
+/**
+ * Answers one request frame into job->response. Gives up part way if the
+ * connection closes, since nobody is left to read the answer.
+ * @param context The worker's context.
+ * @param job
+ */
+static void answerRequest(CheckerContext* context, Job* job)
+{
+    SpellReader reader;
+    spellReaderInit(&reader, job->request.data, job->request.length);
+    uint32_t id = spellGet32(&reader);
+    unsigned op = spellGet8(&reader);
+    unsigned k = spellGet8(&reader);
+    uint32_t count = spellGet32(&reader);
+
+    SpellBuffer* out = &job->response;
+    out->length = 0;
+    size_t start = spellFrameBegin(out);
+    spellPut32(out, id);
+    size_t status = out->length;
+    // every word takes at least its two length bytes
+    int valid = !reader.overrun && (op == SPELL_OP_CHECK || (op == SPELL_OP_SUGGEST && k >= 1 && k <= TOPK_MAX)) &&
+                count <= (reader.length - reader.position) / 2;
+    int tooLarge = valid && count > spellResponseWords(op, k);
+    if (valid && !tooLarge) {
+        spellPut8(out, SPELL_STATUS_OK);
+        spellPut32(out, count);
+        for (uint32_t i = 0; i < count && !reader.overrun; i++) {
+            if (atomic_load_explicit(&job->connection->closed, memory_order_relaxed)) {
+                job->words = 0;
+                return;
+            }
+            int length;
+            const char* word = spellGetWord(&reader, &length);
+            int correct = checkerCheck(context, word, length);
+            spellPut8(out, correct);
+            if (op == SPELL_OP_SUGGEST && !correct) {
+                Suggestion found[TOPK_MAX];
+                int n = checkerSuggest(context, word, length, k, found);
+                size_t at = out->length;
+                spellPut8(out, 0);
+                int sent = 0;
+                for (int j = 0; j < n; j++) {
+                    size_t suggestionLength = strlen(found[j].word);
+                    if (suggestionLength <= SPELL_SUGGESTION_MAX) {
+                        spellPutWord(out, found[j].word, suggestionLength);
+                        sent++;
+                    }
+                }
+                out->data[at] = sent;
+            }
+        }
+        valid = !reader.overrun && reader.position == reader.length;
+    }
+    if (!valid || tooLarge) {
+        out->length = status;
+        spellPut8(out, tooLarge ? SPELL_STATUS_TOO_LARGE : SPELL_STATUS_BAD_REQUEST);
+        spellPut32(out, 0);
+    }
+    spellFrameEnd(out, start);
+    job->words = (valid && !tooLarge) ? count : 0;
+}
+
+/**
+ * Worker thread: answers queued requests until the server stops.
+ */
+static void* workerRun(void* arg)
+{
+    Server* server = arg;
+    CheckerContext context;
+    checkerContextInit(&context, server->checker);
+    const uint64_t one = 1;
+
+    pthread_mutex_lock(&server->lock);
+    while (1) {
+        while (server->queueHead == NULL && !server->stopping) {
+            pthread_cond_wait(&server->available, &server->lock);
+        }
+        Job* job = server->queueHead;
+        if (server->stopping) {
+            // whatever is still queued is dropped
+            break;
+        }
+        server->queueHead = job->next;
+        if (server->queueHead == NULL) {
+            server->queueTail = NULL;
+        }
+        pthread_mutex_unlock(&server->lock);
+
+        answerRequest(&context, job);
+
+        pthread_mutex_lock(&server->lock);
+        int wasEmpty = (server->finished == NULL);
+        job->next = server->finished;
+        server->finished = job;
+        if (wasEmpty) {
+            // the loop drains the whole list per wakeup
+            if (write(server->wake.fd, &one, sizeof(one)) < 0) {
+                perror("eventfd");
+            }
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+/**
+ * Moves a closed connection with nothing left in flight to the list freed
+ * at the end of the current batch of events, which may still mention it.
+ */
+static void retireConnection(Server* server, Connection* connection)
+{
+    if (connection->prev != NULL) {
+        connection->prev->next = connection->next;
+    }
+    else {
+        server->connections = connection->next;
+    }
+    if (connection->next != NULL) {
+        connection->next->prev = connection->prev;
+    }
+    connection->prev = NULL;
+    connection->next = server->closedConnections;
+    server->closedConnections = connection;
+}
+
+/**
+ * Closes a connection's socket. Its memory is released once its last queued
+ * request comes back.
+ */
+static void closeConnection(Server* server, Connection* connection)
+{
+    if (connection->closed) {
+        return;
+    }
+    epoll_ctl(server->epoll, EPOLL_CTL_DEL, connection->endpoint.fd, NULL);
+    close(connection->endpoint.fd);
+    connection->closed = 1;
+    if (connection->pending == 0) {
+        retireConnection(server, connection);
+    }
+}
+
+/**
+ * Changes the events epoll reports for a connection: input while it has room
+ * for more requests, output while responses wait to be written. A peer that
+ * has stopped sending and has nothing left to receive is closed.
+ */
+static void updateInterest(Server* server, Connection* connection)
+{
+    if (connection->closed) {
+        return;
+    }
+    size_t unsent = connection->output.length - connection->outputSent;
+    if (connection->readClosed && connection->pending == 0 && unsent == 0) {
+        closeConnection(server, connection);
+        return;
+    }
+    uint32_t events = 0;
+    if (!connection->readClosed && connection->pending < SERVER_MAX_PENDING && unsent < SERVER_OUTPUT_LIMIT) {
+        events |= EPOLLIN;
+    }
+    if (unsent > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events != connection->events) {
+        struct epoll_event event = { .events = events, .data.ptr = connection };
+        epoll_ctl(server->epoll, EPOLL_CTL_MOD, connection->endpoint.fd, &event);
+        connection->events = events;
+    }
+}
+
+/**
+ * Returns a job with empty buffers, reusing an answered one if there is one.
+ */
+static Job* takeJob(Server* server)
+{
+    Job* job = server->spareJobs;
+    if (job != NULL) {
+        server->spareJobs = job->next;
+        job->request.length = 0;
+        job->response.length = 0;
+    }
+    else {
+        job = calloc(1, sizeof(Job));
+    }
+    job->next = NULL;
+    return job;
+}
+
+/**
+ * Queues every whole request frame read from the connection, as long as it
+ * has room for more in flight. A frame longer than SPELL_FRAME_MAX closes
+ * the connection.
+ */
+static void queueRequests(Server* server, Connection* connection)
+{
+    Job* first = NULL;
+    Job* last = NULL;
+    size_t parsed = 0;
+    while (!connection->closed && connection->pending < SERVER_MAX_PENDING) {
+        long length = spellFrameLength(connection->input.data + parsed, connection->input.length - parsed);
+        if (length < 0) {
+            closeConnection(server, connection);
+            break;
+        }
+        if (length == 0) {
+            break;
+        }
+        Job* job = takeJob(server);
+        job->connection = connection;
+        job->sequence = connection->nextSequence++;
+        spellBufferReserve(&job->request, length);
+        memcpy(job->request.data, connection->input.data + parsed, length);
+        job->request.length = length;
+        parsed += length;
+        connection->pending++;
+        if (last != NULL) {
+            last->next = job;
+        }
+        else {
+            first = job;
+        }
+        last = job;
+    }
+    if (parsed > 0) {
+        spellBufferConsume(&connection->input, parsed);
+    }
+    if (first == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&server->lock);
+    if (server->queueTail != NULL) {
+        server->queueTail->next = first;
+    }
+    else {
+        server->queueHead = first;
+    }
+    server->queueTail = last;
+    pthread_cond_broadcast(&server->available);
+    pthread_mutex_unlock(&server->lock);
+}
+
+/**
+ * Writes as much of the connection's output as the socket takes.
+ */
+static void writeConnection(Server* server, Connection* connection)
+{
+    SpellBuffer* output = &connection->output;
+    while (!connection->closed && connection->outputSent < output->length) {
+        ssize_t sent = send(connection->endpoint.fd, output->data + connection->outputSent,
+                            output->length - connection->outputSent, MSG_NOSIGNAL);
+        if (sent > 0) {
+            connection->outputSent += sent;
+        }
+        else if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        else {
+            closeConnection(server, connection);
+        }
+    }
+    if (connection->outputSent == output->length) {
+        output->length = 0;
+        connection->outputSent = 0;
+    }
+}
+
+/**
+ * Reads what the connection has sent and queues the requests it completes.
+ */
+static void readConnection(Server* server, Connection* connection)
+{
+    SpellBuffer* input = &connection->input;
+    spellBufferReserve(input, SERVER_READ_SIZE);
+    ssize_t got = read(connection->endpoint.fd, input->data + input->length, input->capacity - input->length);
+    if (got > 0) {
+        input->length += got;
+        queueRequests(server, connection);
+    }
+    else if (got == 0) {
+        connection->readClosed = 1;
+    }
+    else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        closeConnection(server, connection);
+    }
+}
+
+/**
+ * Accepts every connection waiting on a listening socket.
+ */
+static void acceptConnections(Server* server, Endpoint* listener)
+{
+    while (1) {
+        int fd = accept4(listener->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("accept");
+            }
+            return;
+        }
+        // responses are written whole, so there is nothing to gain from Nagle
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        Connection* connection = calloc(1, sizeof(Connection));
+        connection->endpoint.kind = ENDPOINT_CONNECTION;
+        connection->endpoint.fd = fd;
+        connection->events = EPOLLIN;
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = connection };
+        if (epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+            perror("epoll_ctl");
+            close(fd);
+            free(connection);
+            continue;
+        }
+        connection->next = server->connections;
+        if (server->connections != NULL) {
+            server->connections->prev = connection;
+        }
+        server->connections = connection;
+        server->connectionCount++;
+    }
+}
+
+/**
+ * Moves answered requests to their connections' output, in the order each
+ * connection sent them, and writes what it can.
+ */
+static void deliverFinished(Server* server)
+{
+    uint64_t count;
+    if (read(server->wake.fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        perror("eventfd");
+    }
+    pthread_mutex_lock(&server->lock);
+    Job* finished = server->finished;
+    server->finished = NULL;
+    pthread_mutex_unlock(&server->lock);
+
+    while (finished != NULL) {
+        Job* job = finished;
+        finished = job->next;
+        Connection* connection = job->connection;
+
+        Job** link = &connection->ready;
+        while (*link != NULL && (*link)->sequence < job->sequence) {
+            link = &(*link)->next;
+        }
+        job->next = *link;
+        *link = job;
+
+        while (connection->ready != NULL && connection->ready->sequence == connection->nextResponse) {
+            Job* next = connection->ready;
+            connection->ready = next->next;
+            if (!connection->closed) {
+                SpellBuffer* output = &connection->output;
+                spellBufferReserve(output, next->response.length);
+                memcpy(output->data + output->length, next->response.data, next->response.length);
+                output->length += next->response.length;
+                server->requestCount++;
+                server->wordCount += next->words;
+            }
+            connection->nextResponse++;
+            connection->pending--;
+            next->next = server->spareJobs;
+            server->spareJobs = next;
+        }
+
+        if (connection->closed) {
+            if (connection->pending == 0) {
+                retireConnection(server, connection);
+            }
+            continue;
+        }
+        writeConnection(server, connection);
+        // room again for requests that were already read
+        queueRequests(server, connection);
+        updateInterest(server, connection);
+    }
+}
+
+/**
+ * Frees a connection and its buffers.
+ */
+static void freeConnection(Connection* connection)
+{
+    spellBufferFree(&connection->input);
+    spellBufferFree(&connection->output);
+    free(connection);
+}
+
+/**
+ * Frees a list of jobs and their buffers.
+ */
+static void freeJobs(Job* job)
+{
+    while (job != NULL) {
+        Job* next = job->next;
+        spellBufferFree(&job->request);
+        spellBufferFree(&job->response);
+        free(job);
+        job = next;
+    }
+}
+
+/**
+ * Runs the event loop until a stop signal arrives.
+ */
+static void serve(Server* server)
+{
+    struct epoll_event events[SERVER_EVENTS];
+    int running = 1;
+    while (running) {
+        int n = epoll_wait(server->epoll, events, SERVER_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            Endpoint* endpoint = events[i].data.ptr;
+            if (endpoint->kind == ENDPOINT_LISTENER) {
+                acceptConnections(server, endpoint);
+            }
+            else if (endpoint->kind == ENDPOINT_WAKE) {
+                deliverFinished(server);
+            }
+            else if (endpoint->kind == ENDPOINT_SIGNAL) {
+                struct signalfd_siginfo info;
+                if (read(endpoint->fd, &info, sizeof(info)) == sizeof(info)) {
+                    fprintf(stderr, "Stopping on signal %u\n", info.ssi_signo);
+                }
+                running = 0;
+            }
+            else {
+                Connection* connection = (Connection*) endpoint;
+                if (connection->closed) {
+                    continue;
+                }
+                uint32_t happened = events[i].events;
+                if (happened & (EPOLLHUP | EPOLLERR)) {
+                    // the peer cannot read any responses
+                    closeConnection(server, connection);
+                    continue;
+                }
+                if (happened & EPOLLIN) {
+                    readConnection(server, connection);
+                }
+                if ((happened & EPOLLOUT) && !connection->closed) {
+                    writeConnection(server, connection);
+                }
+                updateInterest(server, connection);
+            }
+        }
+        while (server->closedConnections != NULL) {
+            Connection* connection = server->closedConnections;
+            server->closedConnections = connection->next;
+            freeJobs(connection->ready);
+            freeConnection(connection);
+        }
+    }
+}
+
+/**
+ * Opens a listening Unix domain socket at path. A stale socket file left by
+ * a server that died is replaced; one a live server answers on is not.
+ * @return The socket, or -1 on failure.
+ */
+static int listenUnix(const char* path)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path %s is too long\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0 && connect(probe, (struct sockaddr*) &address, sizeof(address)) == 0) {
+        fprintf(stderr, "A server is already listening on %s\n", path);
+        close(probe);
+        return -1;
+    }
+    if (probe >= 0) {
+        close(probe);
+    }
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Opens a listening TCP socket on the loopback address only.
+ * @return The socket, or -1 on failure.
+ */
+static int listenLoopback(int port)
+{
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int on = 1;
+    if (fd >= 0) {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (fd < 0 || bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror("tcp");
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Registers an endpoint with the server's epoll set for input.
+ */
+static int watch(Server* server, Endpoint* endpoint)
+{
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = endpoint };
+    return epoll_ctl(server->epoll, EPOLL_CTL_ADD, endpoint->fd, &event);
+}
+
+int main(int argc, const char** argv)
+{
+    const char* dictionaryPath = "dictionary.txt";
+    const char* socketPath = "spellServer.sock";
+    int tcpPort = 0;
+    int workerCount = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--dictionary") == 0) {
+            dictionaryPath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--socket") == 0) {
+            socketPath = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--tcp") == 0) {
+            tcpPort = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--workers") == 0) {
+            workerCount = atoi(argv[i + 1]);
+        }
+    }
+    if (workerCount <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workerCount = cpus > 0 ? (int) cpus : 1;
+    }
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    Checker* checker = checkerOpen(dictionaryPath);
+    if (checker == NULL) {
+        fprintf(stderr, "Could not read %s\n", dictionaryPath);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(stderr, "Dictionary loaded in %f seconds\n",
+            (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.checker = checker;
+    server.socketPath = socketPath;
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.available, NULL);
+
+    // block the stop signals everywhere, workers included, and take them
+    // through the event loop instead
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    server.epoll = epoll_create1(EPOLL_CLOEXEC);
+    server.wake.kind = ENDPOINT_WAKE;
+    server.wake.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    server.signals.kind = ENDPOINT_SIGNAL;
+    server.signals.fd = signalfd(-1, &stopSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    int listening = 1;
+    int unixFd = listenUnix(socketPath);
+    if (unixFd < 0) {
+        listening = 0;
+    }
+    else {
+        server.listeners[server.listenerCount++] = (Endpoint) { ENDPOINT_LISTENER, unixFd };
+    }
+    if (listening && tcpPort > 0) {
+        int tcpFd = listenLoopback(tcpPort);
+        if (tcpFd < 0) {
+            listening = 0;
+        }
+        else {
+            server.listeners[server.listenerCount++] = (Endpoint) { ENDPOINT_LISTENER, tcpFd };
+        }
+    }
+    int ready = listening && server.epoll >= 0 && server.wake.fd >= 0 && server.signals.fd >= 0 &&
+                watch(&server, &server.wake) == 0 && watch(&server, &server.signals) == 0;
+    for (int i = 0; ready && i < server.listenerCount; i++) {
+        ready = watch(&server, &server.listeners[i]) == 0;
+    }
+
+    int exitCode = 1;
+    if (ready) {
+        server.workers = malloc(sizeof(pthread_t) * workerCount);
+        for (int i = 0; i < workerCount; i++) {
+            pthread_create(&server.workers[i], NULL, workerRun, &server);
+        }
+        server.workerCount = workerCount;
+        if (tcpPort > 0) {
+            fprintf(stderr, "Listening on %s and 127.0.0.1:%d with %d workers\n", socketPath, tcpPort, workerCount);
+        }
+        else {
+            fprintf(stderr, "Listening on %s with %d workers\n", socketPath, workerCount);
+        }
+
+        serve(&server);
+
+        pthread_mutex_lock(&server.lock);
+        server.stopping = 1;
+        pthread_cond_broadcast(&server.available);
+        pthread_mutex_unlock(&server.lock);
+        for (int i = 0; i < server.workerCount; i++) {
+            pthread_join(server.workers[i], NULL);
+        }
+        free(server.workers);
+        fprintf(stderr, "Served %ld requests, %ld words over %ld connections\n", server.requestCount,
+                server.wordCount, server.connectionCount);
+        exitCode = 0;
+    }
+
+    // every worker has exited, so nothing else refers to the connections
+    while (server.connections != NULL) {
+        Connection* connection = server.connections;
+        server.connections = connection->next;
+        if (!connection->closed) {
+            close(connection->endpoint.fd);
+        }
+        freeJobs(connection->ready);
+        freeConnection(connection);
+    }
+    freeJobs(server.queueHead);
+    freeJobs(server.finished);
+    for (Connection* connection = server.closedConnections; connection != NULL;) {
+        Connection* next = connection->next;
+        freeJobs(connection->ready);
+        freeConnection(connection);
+        connection = next;
+    }
+    freeJobs(server.spareJobs);
+    for (int i = 0; i < server.listenerCount; i++) {
+        close(server.listeners[i].fd);
+    }
+    if (server.listenerCount > 0) {
+        unlink(socketPath);
+    }
+    close(server.signals.fd);
+    close(server.wake.fd);
+    close(server.epoll);
+    pthread_cond_destroy(&server.available);
+    pthread_mutex_destroy(&server.lock);
+    checkerClose(checker);
+    return exitCode;
+}
@@ -0,0 +1,206 @@
+/*
+ * Protocol checks against a running spellServer.
+ *
+ * Usage: spellServerTest --socket path
+ *
+ * Sends requests the server must refuse, a malformed frame and one whose
+ * response could outgrow SPELL_FRAME_MAX, and checks each gets the matching
+ * status with no results. Then sends a well-formed request on the same
+ * connection, to check the refusals did not cost the client its connection.
+ * serverTest.sh starts the server and runs this. Prints each failed check
+ * and exits 1 if there were any.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "spellProtocol.h"
+#include "topK.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                        \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+/*
+ * The fixed part of a response.
+ */
+typedef struct Response
+{
+    uint32_t id;
+    unsigned status;
+    uint32_t count;
+    // The whole frame, for reading results past the header.
+    SpellBuffer frame;
+} Response;
+
+/**
+ * Writes all of a buffer to the socket.
+ * @return 0 on success, -1 if the connection failed.
+ */
+static int sendAll(int fd, const unsigned char* data, size_t length)
+{
+    while (length > 0) {
+        ssize_t written = send(fd, data, length, MSG_NOSIGNAL);
+        if (written <= 0) {
+            return -1;
+        }
+        data += written;
+        length -= written;
+    }
+    return 0;
+}
+
+/**
+ * Reads one whole response frame and its header fields.
+ * @return 0 on success, -1 if the connection closed or the frame is bad.
+ */
+static int receiveResponse(int fd, Response* response)
+{
+    SpellBuffer* frame = &response->frame;
+    frame->length = 0;
+    long length;
+    while ((length = spellFrameLength(frame->data, frame->length)) == 0) {
+        spellBufferReserve(frame, 64 * 1024);
+        ssize_t got = read(fd, frame->data + frame->length, frame->capacity - frame->length);
+        if (got <= 0) {
+            return -1;
+        }
+        frame->length += got;
+    }
+    if (length < 0) {
+        return -1;
+    }
+    SpellReader reader;
+    spellReaderInit(&reader, frame->data, length);
+    response->id = spellGet32(&reader);
+    response->status = spellGet8(&reader);
+    response->count = spellGet32(&reader);
+    return reader.overrun ? -1 : 0;
+}
+
+/**
+ * Starts a request frame with its header; the caller appends count words.
+ */
+static size_t beginRequest(SpellBuffer* request, uint32_t id, unsigned op, unsigned k, uint32_t count)
+{
+    request->length = 0;
+    size_t start = spellFrameBegin(request);
+    spellPut32(request, id);
+    spellPut8(request, op);
+    spellPut8(request, k);
+    spellPut32(request, count);
+    return start;
+}
+
+/**
+ * Connects to the server's Unix socket.
+ * @return The socket, or -1.
+ */
+static int connectServer(const char* path)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+int main(int argc, const char** argv)
+{
+    if (argc != 3 || strcmp(argv[1], "--socket") != 0) {
+        fprintf(stderr, "Usage: spellServerTest --socket path\n");
+        return 1;
+    }
+    int fd = connectServer(argv[2]);
+    if (fd < 0) {
+        fprintf(stderr, "Could not connect to %s\n", argv[2]);
+        return 1;
+    }
+    SpellBuffer request = { 0 };
+    Response response;
+    memset(&response, 0, sizeof(response));
+
+    // claims five words but carries two
+    size_t start = beginRequest(&request, 1, SPELL_OP_CHECK, 0, 5);
+    spellPutWord(&request, "hello", 5);
+    spellPutWord(&request, "wrold", 5);
+    spellFrameEnd(&request, start);
+    EXPECT(sendAll(fd, request.data, request.length) == 0);
+    EXPECT(receiveResponse(fd, &response) == 0);
+    EXPECT(response.id == 1);
+    EXPECT(response.status == SPELL_STATUS_BAD_REQUEST);
+    EXPECT(response.count == 0);
+
+    // an op the protocol does not have
+    start = beginRequest(&request, 2, 7, 0, 1);
+    spellPutWord(&request, "hello", 5);
+    spellFrameEnd(&request, start);
+    EXPECT(sendAll(fd, request.data, request.length) == 0);
+    EXPECT(receiveResponse(fd, &response) == 0);
+    EXPECT(response.id == 2);
+    EXPECT(response.status == SPELL_STATUS_BAD_REQUEST);
+    EXPECT(response.count == 0);
+
+    // one word more than a response of TOPK_MAX suggestions per word can hold
+    uint32_t count = spellResponseWords(SPELL_OP_SUGGEST, TOPK_MAX) + 1;
+    start = beginRequest(&request, 3, SPELL_OP_SUGGEST, TOPK_MAX, count);
+    for (uint32_t i = 0; i < count; i++) {
+        spellPutWord(&request, "", 0);
+    }
+    spellFrameEnd(&request, start);
+    EXPECT(sendAll(fd, request.data, request.length) == 0);
+    EXPECT(receiveResponse(fd, &response) == 0);
+    EXPECT(response.id == 3);
+    EXPECT(response.status == SPELL_STATUS_TOO_LARGE);
+    EXPECT(response.count == 0);
+
+    // the connection still answers a good request
+    start = beginRequest(&request, 4, SPELL_OP_SUGGEST, 1, 2);
+    spellPutWord(&request, "hello", 5);
+    spellPutWord(&request, "helo", 4);
+    spellFrameEnd(&request, start);
+    EXPECT(sendAll(fd, request.data, request.length) == 0);
+    EXPECT(receiveResponse(fd, &response) == 0);
+    EXPECT(response.id == 4);
+    EXPECT(response.status == SPELL_STATUS_OK);
+    EXPECT(response.count == 2);
+    if (response.status == SPELL_STATUS_OK && response.count == 2) {
+        SpellReader reader;
+        spellReaderInit(&reader, response.frame.data, response.frame.length);
+        // past id, status and count
+        reader.position += 9;
+        EXPECT(spellGet8(&reader) == 1);
+        EXPECT(spellGet8(&reader) == 0);
+        EXPECT(spellGet8(&reader) == 1);
+        int length;
+        spellGetWord(&reader, &length);
+        EXPECT(length > 0);
+        EXPECT(!reader.overrun && reader.position == reader.length);
+    }
+
+    close(fd);
+    spellBufferFree(&request);
+    spellBufferFree(&response.frame);
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("spellServerTest: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * Process-wide totals for the hot-path counters.
+ */
+
+#include "stats.h"
+#include <pthread.h>
+#include <string.h>
+
+#ifdef SPELL_STATS
+_Thread_local SpellStats spellStatsLocal;
+#endif
+
+// Counts flushed by every thread so far.
+static SpellStats totals;
+static pthread_mutex_t totalsLock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef SPELL_STATS
+/**
+ * Adds one set of counters to another. Maxima are merged as maxima.
+ */
+static void addStats(SpellStats* into, const SpellStats* from)
+{
+    into->hashLookups += from->hashLookups;
+    into->hashProbes += from->hashProbes;
+    into->hashKeyCompares += from->hashKeyCompares;
+    into->distanceCalls += from->distanceCalls;
+    into->distanceCells += from->distanceCells;
+    into->distanceEarlyExits += from->distanceEarlyExits;
+    into->candidatesScored += from->candidatesScored;
+    into->candidatesPruned += from->candidatesPruned;
+    into->candidatesFiltered += from->candidatesFiltered;
+    into->suggestions += from->suggestions;
+    into->suggestNanos += from->suggestNanos;
+    if (from->suggestMaxNanos > into->suggestMaxNanos) {
+        into->suggestMaxNanos = from->suggestMaxNanos;
+    }
+}
+#endif
+
+/**
+ * Adds the calling thread's counters to the process totals and zeroes them.
+ * Threads that count on behalf of another, like the search pool's workers,
+ * call this when they finish a piece of work so the totals are complete by
+ * the time the requester reads them.
+ */
+void spellStatsFlush(void)
+{
+#ifdef SPELL_STATS
+    pthread_mutex_lock(&totalsLock);
+    addStats(&totals, &spellStatsLocal);
+    pthread_mutex_unlock(&totalsLock);
+    memset(&spellStatsLocal, 0, sizeof(SpellStats));
+#endif
+}
+
+/**
+ * Copies the process totals, including the calling thread's unflushed
+ * counts, into stats.
+ * @param stats
+ */
+void spellStatsSnapshot(SpellStats* stats)
+{
+    spellStatsFlush();
+    pthread_mutex_lock(&totalsLock);
+    memcpy(stats, &totals, sizeof(SpellStats));
+    pthread_mutex_unlock(&totalsLock);
+}
+
+/**
+ * Zeroes the process totals and the calling thread's counters. Counts other
+ * threads have not flushed yet are kept.
+ */
+void spellStatsReset(void)
+{
+#ifdef SPELL_STATS
+    memset(&spellStatsLocal, 0, sizeof(SpellStats));
+#endif
+    pthread_mutex_lock(&totalsLock);
+    memset(&totals, 0, sizeof(SpellStats));
+    pthread_mutex_unlock(&totalsLock);
+}
+
+/**
+ * Computes the counts between two snapshots, for attributing work to one
+ * query. The maximum is taken from after.
+ * @param result
+ * @param after
+ * @param before
+ */
+void spellStatsSubtract(SpellStats* result, const SpellStats* after, const SpellStats* before)
+{
+    result->hashLookups = after->hashLookups - before->hashLookups;
+    result->hashProbes = after->hashProbes - before->hashProbes;
+    result->hashKeyCompares = after->hashKeyCompares - before->hashKeyCompares;
+    result->distanceCalls = after->distanceCalls - before->distanceCalls;
+    result->distanceCells = after->distanceCells - before->distanceCells;
+    result->distanceEarlyExits = after->distanceEarlyExits - before->distanceEarlyExits;
+    result->candidatesScored = after->candidatesScored - before->candidatesScored;
+    result->candidatesPruned = after->candidatesPruned - before->candidatesPruned;
+    result->candidatesFiltered = after->candidatesFiltered - before->candidatesFiltered;
+    result->suggestions = after->suggestions - before->suggestions;
+    result->suggestNanos = after->suggestNanos - before->suggestNanos;
+    result->suggestMaxNanos = after->suggestMaxNanos;
+}
+
+/**
+ * Returns a / b, or 0 when b is 0.
+ */
+static double ratio(unsigned long long a, unsigned long long b)
+{
+    return (b == 0) ? 0.0 : (double) a / (double) b;
+}
+
+/**
+ * Writes counters as aligned text lines or as one JSON object; the JSON has
+ * no trailing newline so it can be embedded. Both forms include the averages
+ * that matter most: probes per lookup, cells per distance call and time per
+ * suggestion.
+ * @param out
+ * @param stats
+ * @param json Nonzero for JSON.
+ */
+void spellStatsPrint(FILE* out, const SpellStats* stats, int json)
+{
+    if (json) {
+        fprintf(out, "{\"enabled\": %s, \"hashLookups\": %llu, \"hashProbes\": %llu, \"hashKeyCompares\": %llu, "
+                "\"distanceCalls\": %llu, \"distanceCells\": %llu, \"distanceEarlyExits\": %llu, "
+                "\"candidatesScored\": %llu, \"candidatesPruned\": %llu, \"candidatesFiltered\": %llu, "
+                "\"suggestions\": %llu, "
+                "\"suggestNanos\": %llu, \"suggestMaxNanos\": %llu, \"probesPerLookup\": %.3f, "
+                "\"cellsPerCall\": %.1f, \"suggestMeanNanos\": %.0f}",
+                STATS_ENABLED ? "true" : "false", stats->hashLookups, stats->hashProbes, stats->hashKeyCompares,
+                stats->distanceCalls, stats->distanceCells, stats->distanceEarlyExits, stats->candidatesScored,
+                stats->candidatesPruned, stats->candidatesFiltered, stats->suggestions, stats->suggestNanos, stats->suggestMaxNanos,
+                ratio(stats->hashProbes, stats->hashLookups), ratio(stats->distanceCells, stats->distanceCalls),
+                ratio(stats->suggestNanos, stats->suggestions));
+        return;
+    }
+    if (!STATS_ENABLED) {
+        fprintf(out, "Counters are compiled out; rebuild with -DSPELL_STATS\n");
+        return;
+    }
+    fprintf(out, "hash lookups          %12llu  (%.3f probes, %.3f key compares each)\n", stats->hashLookups,
+            ratio(stats->hashProbes, stats->hashLookups), ratio(stats->hashKeyCompares, stats->hashLookups));
+    fprintf(out, "distance calls        %12llu  (%.1f cells each, %llu stopped early)\n", stats->distanceCalls,
+            ratio(stats->distanceCells, stats->distanceCalls), stats->distanceEarlyExits);
+    fprintf(out, "candidates scored     %12llu\n", stats->candidatesScored);
+    fprintf(out, "candidates pruned     %12llu\n", stats->candidatesPruned);
+    fprintf(out, "candidates filtered   %12llu\n", stats->candidatesFiltered);
+    fprintf(out, "suggestions           %12llu  (%.1f us mean, %.1f us max)\n", stats->suggestions,
+            ratio(stats->suggestNanos, stats->suggestions) / 1e3, stats->suggestMaxNanos / 1e3);
+}
@@ -0,0 +1,69 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*
+ * Hot-path counters.
+ *
+ * Built with -DSPELL_STATS, the hash map, the distance kernels and the
+ * suggestion scan count their work into a thread-local SpellStats: plain
+ * increments, no atomics and no shared cache lines. A thread adds its counts
+ * to the process totals with spellStatsFlush, which the search pool's workers
+ * do after every scan. Without SPELL_STATS the STATS_ macros expand to
+ * nothing and the counters cost nothing; the functions below still exist and
+ * report zeros.
+ */
+
+#include <stdio.h>
+
+typedef struct SpellStats SpellStats;
+
+struct SpellStats
+{
+    // Hash map lookups, including the ones inside put and remove, the slots
+    // they examined and the keys they compared with strcmp.
+    unsigned long long hashLookups;
+    unsigned long long hashProbes;
+    unsigned long long hashKeyCompares;
+    // Distance kernel calls (one per word, or per block of CANDIDATE_LANES
+    // words for the block kernels), DP cells computed (a bit-parallel column
+    // counts as one cell per query character) and calls that stopped early
+    // because the bound could no longer be met.
+    unsigned long long distanceCalls;
+    unsigned long long distanceCells;
+    unsigned long long distanceEarlyExits;
+    // Candidate store words handed to a kernel during suggestion scans,
+    // words skipped without scoring because their length alone was too far,
+    // and words skipped because their character signature was.
+    unsigned long long candidatesScored;
+    unsigned long long candidatesPruned;
+    unsigned long long candidatesFiltered;
+    // Suggestion lookups and the time spent in them.
+    unsigned long long suggestions;
+    unsigned long long suggestNanos;
+    unsigned long long suggestMaxNanos;
+};
+
+#ifdef SPELL_STATS
+extern _Thread_local SpellStats spellStatsLocal;
+#define STATS_ADD(field, n) (spellStatsLocal.field += (unsigned long long) (n))
+#define STATS_MAX(field, n) \
+    do { \
+        unsigned long long statsValue = (unsigned long long) (n); \
+        if (statsValue > spellStatsLocal.field) { \
+            spellStatsLocal.field = statsValue; \
+        } \
+    } while (0)
+#define STATS_ENABLED 1
+#else
+#define STATS_ADD(field, n) ((void) 0)
+#define STATS_MAX(field, n) ((void) 0)
+#define STATS_ENABLED 0
+#endif
+
+void spellStatsFlush(void);
+void spellStatsSnapshot(SpellStats* stats);
+void spellStatsReset(void);
+void spellStatsSubtract(SpellStats* result, const SpellStats* after, const SpellStats* before);
+void spellStatsPrint(FILE* out, const SpellStats* stats, int json);
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Bounded CLOCK cache of suggestion results.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "suggestCache.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Creates an empty cache.
+ * @param capacity Largest number of words kept, at least 1.
+ * @param dictionary Map whose changes invalidate the cache, or NULL.
+ * @return New cache.
+ */
+SuggestCache* suggestCacheNew(int capacity, HashMap* dictionary)
+{
+    assert(capacity > 0);
+    SuggestCache* cache = calloc(1, sizeof(SuggestCache));
+    cache->capacity = capacity;
+    cache->entries = calloc(capacity, sizeof(SuggestCacheEntry));
+    // sized so the index never has to grow
+    cache->index = hashMapNew(capacity * 2);
+    cache->dictionary = dictionary;
+    cache->version = (dictionary != NULL) ? dictionary->version : 0;
+    return cache;
+}
+
+/**
+ * Frees the cache and its keys.
+ * @param cache
+ */
+void suggestCacheDelete(SuggestCache* cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    for (int i = 0; i < cache->count; i++) {
+        free(cache->entries[i].key);
+    }
+    free(cache->entries);
+    hashMapDelete(cache->index);
+    free(cache);
+}
+
+/**
+ * Drops every entry. Counters are kept.
+ * @param cache
+ */
+void suggestCacheClear(SuggestCache* cache)
+{
+    assert(cache != NULL);
+    for (int i = 0; i < cache->count; i++) {
+        free(cache->entries[i].key);
+        cache->entries[i].key = NULL;
+    }
+    cache->count = 0;
+    cache->hand = 0;
+    hashMapDelete(cache->index);
+    cache->index = hashMapNew(cache->capacity * 2);
+}
+
+/**
+ * Drops every entry if the watched dictionary changed since they were stored.
+ */
+static void checkVersion(SuggestCache* cache)
+{
+    if (cache->dictionary != NULL && cache->dictionary->version != cache->version) {
+        suggestCacheClear(cache);
+        cache->version = cache->dictionary->version;
+        cache->invalidations++;
+    }
+}
+
+/**
+ * Looks a word up and offers its cached suggestions to table on a hit. An
+ * entry kept for fewer suggestions than table wants is a miss.
+ * @param cache
+ * @param word Lowercased misspelling.
+ * @param table Empty table to fill.
+ * @return 1 on a hit, 0 on a miss.
+ */
+int suggestCacheGet(SuggestCache* cache, const char* word, TopK* table)
+{
+    assert((cache != NULL) && (word != NULL) && (table != NULL));
+    checkVersion(cache);
+    int* slot = hashMapGet(cache->index, word);
+    if (slot == NULL || cache->entries[*slot].table.k < table->k) {
+        cache->misses++;
+        return 0;
+    }
+    SuggestCacheEntry* entry = &cache->entries[*slot];
+    entry->referenced = 1;
+    topKMerge(table, &entry->table);
+    cache->hits++;
+    return 1;
+}
+
+/**
+ * Stores the suggestions for a word, evicting the entry under the clock hand
+ * if the cache is full. A word already cached has its entry replaced.
+ * @param cache
+ * @param word Lowercased misspelling.
+ * @param table Suggestions to copy.
+ */
+void suggestCachePut(SuggestCache* cache, const char* word, TopK* table)
+{
+    assert((cache != NULL) && (word != NULL) && (table != NULL));
+    checkVersion(cache);
+    int* slot = hashMapGet(cache->index, word);
+    if (slot != NULL) {
+        cache->entries[*slot].table = *table;
+        return;
+    }
+
+    int victim;
+    if (cache->count < cache->capacity) {
+        victim = cache->count++;
+    }
+    else {
+        // give every referenced entry a second chance before evicting it
+        while (cache->entries[cache->hand].referenced) {
+            cache->entries[cache->hand].referenced = 0;
+            cache->hand = (cache->hand + 1) % cache->capacity;
+        }
+        victim = cache->hand;
+        cache->hand = (cache->hand + 1) % cache->capacity;
+        hashMapRemove(cache->index, cache->entries[victim].key);
+        free(cache->entries[victim].key);
+        cache->evictions++;
+    }
+
+    SuggestCacheEntry* entry = &cache->entries[victim];
+    entry->key = strdup(word);
+    entry->referenced = 0;
+    entry->table = *table;
+    hashMapPut(cache->index, word, victim);
+}
@@ -0,0 +1,58 @@
+#ifndef SUGGEST_CACHE_H
+#define SUGGEST_CACHE_H
+
+/*
+ * Bounded cache of suggestion results, keyed on the lowercased misspelling.
+ *
+ * Entries live in a fixed array and are found through a HashMap from word to
+ * entry index. Eviction uses the CLOCK approximation of LRU: a hit sets the
+ * entry's reference bit, and the clock hand clears reference bits as it goes
+ * round and evicts the first entry whose bit is already clear.
+ *
+ * An entry answers requests for as many suggestions as it holds or fewer.
+ *
+ * The cache watches the version counter of the dictionary map it was created
+ * with and drops every entry when the map has changed since they were stored.
+ * Suggested words are not copied, so the index they came from must outlive
+ * the cache. The cache is not thread safe.
+ */
+
+#include "hashMap.h"
+#include "topK.h"
+
+#define SUGGEST_CACHE_DEFAULT_CAPACITY 4096
+
+typedef struct SuggestCache SuggestCache;
+typedef struct SuggestCacheEntry SuggestCacheEntry;
+
+struct SuggestCacheEntry
+{
+    char* key;
+    int referenced;
+    TopK table;
+};
+
+struct SuggestCache
+{
+    int capacity;
+    int count;
+    int hand;
+    SuggestCacheEntry* entries;
+    // Word to index in entries.
+    HashMap* index;
+    // Dictionary watched for changes, NULL if it cannot change.
+    HashMap* dictionary;
+    unsigned long version;
+    long hits;
+    long misses;
+    long evictions;
+    long invalidations;
+};
+
+SuggestCache* suggestCacheNew(int capacity, HashMap* dictionary);
+void suggestCacheDelete(SuggestCache* cache);
+int suggestCacheGet(SuggestCache* cache, const char* word, TopK* table);
+void suggestCachePut(SuggestCache* cache, const char* word, TopK* table);
+void suggestCacheClear(SuggestCache* cache);
+
+#endif
@@ -0,0 +1,30 @@
+/**
+ * CS 261 Data Structures
+ * SpellChecker
+ * Name: Dipan Patel (pateldip@oregonstate.edu)
+ * Date: 2020 Mar. 7
+ */
+
+#include "suggestion.h"
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Orders suggestions by distance, then by frequency with the more common word
+ * first, then alphabetically so a set of suggestions does not depend on the
+ * order candidates are scanned in. Distance stays the primary key, so every
+ * bound on distance the searches prune with holds whatever the frequencies
+ * are.
+ * @param a
+ * @param b
+ * @return 1 if a ranks before b, 0 otherwise.
+ */
+int suggestionRanksBefore(const Suggestion * a, const Suggestion * b) {
+    if (a->distance != b->distance) {
+        return a->distance < b->distance;
+    }
+    if (a->frequency != b->frequency) {
+        return a->frequency > b->frequency;
+    }
+    return strcmp(a->word, b->word) < 0;
+}
@@ -0,0 +1,28 @@
+#ifndef SUGGESTION_H
+#define SUGGESTION_H
+
+/*
+ * A suggested dictionary word and the order suggestions are ranked in. The
+ * closest words are collected in a TopK; see topK.h.
+ */
+
+// Suggestions offered for a misspelling unless asked for another number.
+#define SUGGESTION_COUNT 5
+// Words carry a frequency class from 0, for no known count, up to this;
+// higher classes are more common words. See frequencyClass.
+#define FREQUENCY_CLASS_MAX 255
+
+/*
+ * A dictionary word, its distance from the word being checked and its
+ * frequency class.
+ */
+typedef struct Suggestion
+{
+    const char* word;
+    int distance;
+    int frequency;
+} Suggestion;
+
+int suggestionRanksBefore(const Suggestion * a, const Suggestion * b);
+
+#endif
@@ -0,0 +1,521 @@
+/*
+ * Symmetric deletion index (SymSpell) over a candidate store.
+ */
+
+#include "symSpell.h"
+#include "hashMap.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARTITIONS (1 << SYMSPELL_PARTITION_BITS)
+
+typedef struct DeletePair DeletePair;
+typedef struct BuildState BuildState;
+typedef struct ParallelTask ParallelTask;
+
+/*
+ * One (deletion hash, word) pair produced while building.
+ */
+struct DeletePair
+{
+    uint64_t hash;
+    uint32_t id;
+};
+
+/*
+ * Everything the build phases share.
+ */
+struct BuildState
+{
+    CandidateStore* store;
+    int maxDistance;
+    int maxLength;
+    int threadCount;
+    // Per-thread pairs and per-thread counts of pairs in each partition.
+    DeletePair** threadPairs;
+    size_t* threadPairCounts;
+    uint32_t** threadHistograms;
+    // All pairs, grouped by partition; partitionStarts has PARTITIONS + 1 entries.
+    DeletePair* pairs;
+    size_t* partitionStarts;
+    // Unique keys in each partition, then where each partition's keys start.
+    uint32_t* partitionKeys;
+    SymSpellIndex* index;
+};
+
+/*
+ * A parallel loop: workers claim items from a shared counter.
+ */
+struct ParallelTask
+{
+    void (*fn)(BuildState* state, int item);
+    BuildState* state;
+    int count;
+    atomic_int next;
+};
+
+/**
+ * Worker body for parallelFor.
+ * @param arg The task.
+ * @return NULL.
+ */
+static void* parallelWorker(void* arg)
+{
+    ParallelTask* task = arg;
+    int item;
+    while ((item = atomic_fetch_add(&task->next, 1)) < task->count) {
+        task->fn(task->state, item);
+    }
+    return NULL;
+}
+
+/**
+ * Runs fn for every item in [0, count) on up to threadCount threads,
+ * including the calling one, and waits for all of them.
+ */
+static void parallelFor(int threadCount, int count, void (*fn)(BuildState*, int), BuildState* state)
+{
+    ParallelTask task;
+    task.fn = fn;
+    task.state = state;
+    task.count = count;
+    atomic_init(&task.next, 0);
+
+    int extra = (threadCount < count ? threadCount : count) - 1;
+    pthread_t* threads = malloc(sizeof(pthread_t) * (extra > 0 ? extra : 1));
+    for (int i = 0; i < extra; i++) {
+        pthread_create(&threads[i], NULL, parallelWorker, &task);
+    }
+    parallelWorker(&task);
+    for (int i = 0; i < extra; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
+
+/**
+ * Hashes every string reachable from buffers[depth] by deleting characters at
+ * positions from start on, up to maxDistance deletions in total.
+ * @param buffers One scratch string per depth, each as long as the word.
+ * @param length Length of buffers[depth].
+ * @param depth Deletions made so far.
+ * @param start First position that may be deleted, so each set of positions
+ * is generated once.
+ * @param maxDistance
+ * @param out Receives the hashes.
+ * @param count Number of hashes in out so far.
+ * @return New number of hashes in out.
+ */
+static int generateDeletes(char** buffers, int length, int depth, int start, int maxDistance, uint64_t* out, int count)
+{
+    if (depth == maxDistance) {
+        return count;
+    }
+    const char* word = buffers[depth];
+    char* next = buffers[depth + 1];
+    for (int i = start; i < length; i++) {
+        memcpy(next, word, i);
+        memcpy(next + i, word + i + 1, length - i);
+        out[count++] = hashFunction3(next);
+        count = generateDeletes(buffers, length - 1, depth + 1, i, maxDistance, out, count);
+    }
+    return count;
+}
+
+/**
+ * Returns how many deletion strings generateDeletes can produce for a word,
+ * counting the word itself: the sum of C(length, d) for d up to maxDistance.
+ * @param length
+ * @param maxDistance
+ * @return Upper bound on the word's deletions.
+ */
+static size_t deleteCount(int length, int maxDistance)
+{
+    size_t total = 0;
+    size_t choose = 1;
+    for (int d = 0; d <= maxDistance && d <= length; d++) {
+        total += choose;
+        choose = choose * (length - d) / (d + 1);
+    }
+    return total;
+}
+
+/**
+ * Orders 64-bit hashes for qsort.
+ */
+static int compareHashes(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Orders pairs by hash, then word id, for qsort.
+ */
+static int comparePairs(const void* a, const void* b)
+{
+    const DeletePair* x = a;
+    const DeletePair* y = b;
+    if (x->hash != y->hash) {
+        return (x->hash > y->hash) - (x->hash < y->hash);
+    }
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+/**
+ * Build phase 1, one item per thread: generates the unique deletions of a
+ * slice of the words and counts them per partition.
+ */
+static void buildGenerate(BuildState* state, int thread)
+{
+    CandidateStore* store = state->store;
+    int begin = (int) ((long) store->size * thread / state->threadCount);
+    int end = (int) ((long) store->size * (thread + 1) / state->threadCount);
+    size_t perWord = deleteCount(state->maxLength, state->maxDistance);
+
+    size_t capacity = 0;
+    for (int id = begin; id < end; id++) {
+        capacity += deleteCount(store->lengths[id], state->maxDistance);
+    }
+    DeletePair* pairs = malloc(sizeof(DeletePair) * (capacity > 0 ? capacity : 1));
+    uint32_t* histogram = calloc(PARTITIONS, sizeof(uint32_t));
+    uint64_t* hashes = malloc(sizeof(uint64_t) * perWord);
+    char** buffers = malloc(sizeof(char*) * (state->maxDistance + 1));
+    for (int d = 0; d <= state->maxDistance; d++) {
+        buffers[d] = malloc(state->maxLength + 1);
+    }
+
+    size_t count = 0;
+    for (int id = begin; id < end; id++) {
+        int length = store->lengths[id];
+        memcpy(buffers[0], candidateStoreWord(store, id), length + 1);
+        hashes[0] = hashFunction3(buffers[0]);
+        int n = generateDeletes(buffers, length, 0, 0, state->maxDistance, hashes, 1);
+        // repeated letters give the same deletion more than once
+        qsort(hashes, n, sizeof(uint64_t), compareHashes);
+        for (int i = 0; i < n; i++) {
+            if (i == 0 || hashes[i] != hashes[i - 1]) {
+                pairs[count].hash = hashes[i];
+                pairs[count].id = (uint32_t) id;
+                histogram[hashes[i] >> (64 - SYMSPELL_PARTITION_BITS)]++;
+                count++;
+            }
+        }
+    }
+
+    for (int d = 0; d <= state->maxDistance; d++) {
+        free(buffers[d]);
+    }
+    free(buffers);
+    free(hashes);
+    state->threadPairs[thread] = pairs;
+    state->threadPairCounts[thread] = count;
+    state->threadHistograms[thread] = histogram;
+}
+
+/**
+ * Build phase 2, one item per thread: moves the thread's pairs into their
+ * partitions of the shared array. threadHistograms now holds each thread's
+ * write position in every partition.
+ */
+static void buildScatter(BuildState* state, int thread)
+{
+    uint32_t* position = state->threadHistograms[thread];
+    DeletePair* pairs = state->threadPairs[thread];
+    for (size_t i = 0; i < state->threadPairCounts[thread]; i++) {
+        int p = (int) (pairs[i].hash >> (64 - SYMSPELL_PARTITION_BITS));
+        state->pairs[state->partitionStarts[p] + position[p]++] = pairs[i];
+    }
+    free(pairs);
+    state->threadPairs[thread] = NULL;
+}
+
+/**
+ * Build phase 3, one item per partition: sorts the partition and counts its
+ * unique keys.
+ */
+static void buildSort(BuildState* state, int p)
+{
+    DeletePair* pairs = state->pairs + state->partitionStarts[p];
+    size_t count = state->partitionStarts[p + 1] - state->partitionStarts[p];
+    qsort(pairs, count, sizeof(DeletePair), comparePairs);
+    uint32_t keys = 0;
+    for (size_t i = 0; i < count; i++) {
+        keys += (i == 0 || pairs[i].hash != pairs[i - 1].hash);
+    }
+    state->partitionKeys[p] = keys;
+}
+
+/**
+ * Build phase 4, one item per partition: writes the partition's keys, posting
+ * offsets and postings into the index.
+ */
+static void buildFill(BuildState* state, int p)
+{
+    SymSpellIndex* index = state->index;
+    size_t begin = state->partitionStarts[p];
+    size_t end = state->partitionStarts[p + 1];
+    uint32_t key = index->directory[p];
+    for (size_t i = begin; i < end; i++) {
+        if (i == begin || state->pairs[i].hash != state->pairs[i - 1].hash) {
+            index->keys[key] = state->pairs[i].hash;
+            index->offsets[key] = (uint32_t) i;
+            key++;
+        }
+        index->postings[i] = state->pairs[i].id;
+    }
+}
+
+/**
+ * Returns the most memory building an index for the store would need: the
+ * temporary pairs plus the finished index, assuming no repeated deletions.
+ * @param store A finished candidate store.
+ * @param maxDistance
+ * @return Estimated peak bytes.
+ */
+size_t symSpellEstimateBytes(CandidateStore* store, int maxDistance)
+{
+    assert(store != NULL);
+
+    size_t pairs = 0;
+    for (int id = 0; id < store->size; id++) {
+        pairs += deleteCount(store->lengths[id], maxDistance);
+    }
+    // pairs are held twice while scattering, then the index needs a key, an offset and a posting per pair
+    return pairs * (2 * sizeof(DeletePair) + sizeof(uint64_t) + 2 * sizeof(uint32_t)) +
+           sizeof(uint32_t) * (PARTITIONS + 1);
+}
+
+/**
+ * Builds the deletion index for every word in the store. If the index for
+ * maxDistance would need more than maxBytes, the distance is lowered until
+ * it fits.
+ * @param store A finished candidate store.
+ * @param maxDistance Deletions to index per word.
+ * @param maxBytes Memory cap for the build.
+ * @param threadCount Threads to build with.
+ * @return The index, or NULL if not even distance 1 fits in maxBytes.
+ */
+SymSpellIndex* symSpellBuild(CandidateStore* store, int maxDistance, size_t maxBytes, int threadCount)
+{
+    assert((store != NULL) && (maxDistance >= 0));
+
+    while (maxDistance > 0 && symSpellEstimateBytes(store, maxDistance) > maxBytes) {
+        maxDistance--;
+    }
+    if (maxDistance == 0) {
+        return NULL;
+    }
+
+    BuildState state;
+    memset(&state, 0, sizeof(state));
+    state.store = store;
+    state.maxDistance = maxDistance;
+    state.threadCount = threadCount > 0 ? threadCount : 1;
+    for (int id = 0; id < store->size; id++) {
+        if (store->lengths[id] > state.maxLength) {
+            state.maxLength = store->lengths[id];
+        }
+    }
+    state.threadPairs = calloc(state.threadCount, sizeof(DeletePair*));
+    state.threadPairCounts = calloc(state.threadCount, sizeof(size_t));
+    state.threadHistograms = calloc(state.threadCount, sizeof(uint32_t*));
+    parallelFor(state.threadCount, state.threadCount, buildGenerate, &state);
+
+    // turn per-thread partition counts into partition starts and per-thread write positions
+    state.partitionStarts = malloc(sizeof(size_t) * (PARTITIONS + 1));
+    size_t total = 0;
+    for (int p = 0; p < PARTITIONS; p++) {
+        state.partitionStarts[p] = total;
+        uint32_t offset = 0;
+        for (int t = 0; t < state.threadCount; t++) {
+            uint32_t count = state.threadHistograms[t][p];
+            state.threadHistograms[t][p] = offset;
+            offset += count;
+        }
+        total += offset;
+    }
+    state.partitionStarts[PARTITIONS] = total;
+    state.pairs = malloc(sizeof(DeletePair) * (total > 0 ? total : 1));
+    parallelFor(state.threadCount, state.threadCount, buildScatter, &state);
+    for (int t = 0; t < state.threadCount; t++) {
+        free(state.threadHistograms[t]);
+    }
+
+    state.partitionKeys = malloc(sizeof(uint32_t) * PARTITIONS);
+    parallelFor(state.threadCount, PARTITIONS, buildSort, &state);
+
+    SymSpellIndex* index = calloc(1, sizeof(SymSpellIndex));
+    index->maxDistance = maxDistance;
+    index->wordCount = store->size;
+    index->postingCount = total;
+    index->directory = malloc(sizeof(uint32_t) * (PARTITIONS + 1));
+    for (int p = 0; p < PARTITIONS; p++) {
+        index->directory[p] = (uint32_t) index->keyCount;
+        index->keyCount += state.partitionKeys[p];
+    }
+    index->directory[PARTITIONS] = (uint32_t) index->keyCount;
+    index->keys = malloc(sizeof(uint64_t) * (index->keyCount > 0 ? index->keyCount : 1));
+    index->offsets = malloc(sizeof(uint32_t) * (index->keyCount + 1));
+    index->postings = malloc(sizeof(uint32_t) * (total > 0 ? total : 1));
+    index->offsets[index->keyCount] = (uint32_t) total;
+    state.index = index;
+    parallelFor(state.threadCount, PARTITIONS, buildFill, &state);
+
+    free(state.partitionKeys);
+    free(state.pairs);
+    free(state.partitionStarts);
+    free(state.threadHistograms);
+    free(state.threadPairCounts);
+    free(state.threadPairs);
+    return index;
+}
+
+/**
+ * Frees the index.
+ * @param index
+ */
+void symSpellDelete(SymSpellIndex* index)
+{
+    if (index == NULL) {
+        return;
+    }
+    free(index->keys);
+    free(index->offsets);
+    free(index->postings);
+    free(index->directory);
+    free(index);
+}
+
+/**
+ * Returns the number of bytes the finished index holds.
+ * @param index
+ * @return Bytes allocated by the index.
+ */
+size_t symSpellMemoryUsage(SymSpellIndex* index)
+{
+    assert(index != NULL);
+    return sizeof(SymSpellIndex) + sizeof(uint64_t) * index->keyCount +
+           sizeof(uint32_t) * (index->keyCount + 1) + sizeof(uint32_t) * index->postingCount +
+           sizeof(uint32_t) * (PARTITIONS + 1);
+}
+
+/**
+ * Finds the key for a deletion hash.
+ * @param index
+ * @param hash
+ * @return Key index, or -1 if no dictionary word has this deletion.
+ */
+static long findKey(SymSpellIndex* index, uint64_t hash)
+{
+    int p = (int) (hash >> (64 - SYMSPELL_PARTITION_BITS));
+    long lo = index->directory[p];
+    long hi = (long) index->directory[p + 1] - 1;
+    while (lo <= hi) {
+        long mid = (lo + hi) / 2;
+        if (index->keys[mid] == hash) {
+            return mid;
+        }
+        if (index->keys[mid] < hash) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Orders word ids for qsort.
+ */
+static int compareIds(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*) a;
+    uint32_t y = *(const uint32_t*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Fills table with the closest words within the index's distance: generates
+ * the query's deletions, collects the words sharing any of them and verifies
+ * each with the distance kernel.
+ *
+ * Every word within maxDistance is found, so when that yields a full table it
+ * is exactly what a full scan would return. Otherwise table is left untouched
+ * and the caller has to fall back to a scan for the farther words.
+ *
+ * @param index
+ * @param store The candidate store the index was built from.
+ * @param query Prepared query.
+ * @param table Suggestion table to update.
+ * @return 1 if table was filled, 0 if a full scan is still needed.
+ */
+int symSpellSearch(SymSpellIndex* index, CandidateStore* store, DistanceQuery* query, TopK* table)
+{
+    assert((index != NULL) && (store != NULL) && (query != NULL) && (table != NULL));
+
+    int length = query->length;
+    size_t deleteTotal = deleteCount(length, index->maxDistance);
+    uint64_t* hashes = malloc(sizeof(uint64_t) * deleteTotal);
+    char* storage = malloc((size_t) (index->maxDistance + 1) * (length + 1));
+    char* buffers[index->maxDistance + 1];
+    for (int d = 0; d <= index->maxDistance; d++) {
+        buffers[d] = storage + d * (length + 1);
+    }
+    memcpy(buffers[0], query->word, length);
+    buffers[0][length] = '\0';
+    hashes[0] = hashFunction3(buffers[0]);
+    int n = generateDeletes(buffers, length, 0, 0, index->maxDistance, hashes, 1);
+
+    // gather the words behind every deletion
+    size_t idCount = 0;
+    size_t idCapacity = 256;
+    uint32_t* ids = malloc(sizeof(uint32_t) * idCapacity);
+    for (int i = 0; i < n; i++) {
+        long key = findKey(index, hashes[i]);
+        if (key < 0) {
+            continue;
+        }
+        uint32_t begin = index->offsets[key];
+        uint32_t end = index->offsets[key + 1];
+        while (idCount + (end - begin) > idCapacity) {
+            idCapacity *= 2;
+            ids = realloc(ids, sizeof(uint32_t) * idCapacity);
+        }
+        memcpy(ids + idCount, index->postings + begin, sizeof(uint32_t) * (end - begin));
+        idCount += end - begin;
+    }
+
+    // verify each word once, into a table of our own until we know it is complete
+    TopK found;
+    topKInit(&found, table->k);
+    qsort(ids, idCount, sizeof(uint32_t), compareIds);
+    for (size_t i = 0; i < idCount; i++) {
+        if (i > 0 && ids[i] == ids[i - 1]) {
+            continue;
+        }
+        int bound = topKThreshold(&found, index->maxDistance);
+        if (bound > index->maxDistance) {
+            bound = index->maxDistance;
+        }
+        int id = (int) ids[i];
+        int distance = distanceQueryScore(query, candidateStoreWord(store, id), store->lengths[id], bound);
+        if (distance <= bound) {
+            topKOffer(&found, candidateStoreWord(store, id), distance, store->frequencies[id]);
+        }
+    }
+    free(ids);
+    free(storage);
+    free(hashes);
+
+    if (!topKFull(&found)) {
+        return 0;
+    }
+    topKMerge(table, &found);
+    return 1;
+}
@@ -0,0 +1,51 @@
+#ifndef SYM_SPELL_H
+#define SYM_SPELL_H
+
+/*
+ * Symmetric deletion index (SymSpell) over a candidate store.
+ *
+ * Every string obtained by deleting up to maxDistance characters from a
+ * dictionary word is hashed and mapped to the words that produce it. Two words
+ * within edit distance maxDistance always share such a deletion, so a query
+ * only has to generate its own deletions, look each one up, and verify the
+ * few words found with the distance kernel. The cost depends on the query's
+ * length, not on the size of the dictionary.
+ *
+ * Only deletion hashes are stored, never the strings. A hash collision only
+ * adds a candidate that verification then rejects.
+ */
+
+#include "candidateStore.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define SYMSPELL_DEFAULT_DISTANCE 2
+#define SYMSPELL_DEFAULT_MAX_BYTES ((size_t) 512 * 1024 * 1024)
+// Keys are split by their top bits into this many sorted partitions.
+#define SYMSPELL_PARTITION_BITS 16
+
+typedef struct SymSpellIndex SymSpellIndex;
+
+struct SymSpellIndex
+{
+    int maxDistance;
+    int wordCount;
+    size_t keyCount;
+    size_t postingCount;
+    // Unique deletion hashes, sorted.
+    uint64_t* keys;
+    // Postings of keys[i] are postings[offsets[i] .. offsets[i + 1]).
+    uint32_t* offsets;
+    // Word ids in the candidate store.
+    uint32_t* postings;
+    // Index of the first key of every partition, plus one past the last.
+    uint32_t* directory;
+};
+
+SymSpellIndex* symSpellBuild(CandidateStore* store, int maxDistance, size_t maxBytes, int threadCount);
+void symSpellDelete(SymSpellIndex* index);
+size_t symSpellEstimateBytes(CandidateStore* store, int maxDistance);
+size_t symSpellMemoryUsage(SymSpellIndex* index);
+int symSpellSearch(SymSpellIndex* index, CandidateStore* store, DistanceQuery* query, TopK* table);
+
+#endif
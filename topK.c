@@ -0,0 +1,167 @@
+/*
+ * The k closest words seen so far by a suggestion search.
+ */
+
+#include "topK.h"
+#include <assert.h>
+#include <stddef.h>
+
+/**
+ * Empties a table and sets how many words it keeps.
+ * @param top
+ * @param k Capacity, 1 to TOPK_MAX.
+ */
+void topKInit(TopK* top, int k)
+{
+    assert((top != NULL) && (k >= 1) && (k <= TOPK_MAX));
+    top->k = k;
+    top->count = 0;
+}
+
+/**
+ * Moves the entry at i down until neither child ranks after it.
+ */
+static void siftDown(TopK* top, int i)
+{
+    Suggestion* entries = top->entries;
+    Suggestion moving = entries[i];
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= top->count) {
+            break;
+        }
+        if (child + 1 < top->count && suggestionRanksBefore(&entries[child], &entries[child + 1])) {
+            child++;
+        }
+        if (!suggestionRanksBefore(&moving, &entries[child])) {
+            break;
+        }
+        entries[i] = entries[child];
+        i = child;
+    }
+    entries[i] = moving;
+}
+
+/**
+ * Offers a word to the table. It is kept if the table has room or it ranks
+ * before the last entry, which it then replaces.
+ * @param top
+ * @param word Dictionary word; the table keeps the pointer.
+ * @param distance
+ * @param frequency Frequency class of word.
+ * @return 1 if the word was kept, 0 otherwise.
+ */
+int topKOffer(TopK* top, const char* word, int distance, int frequency)
+{
+    Suggestion candidate = { word, distance, frequency };
+    Suggestion* entries = top->entries;
+    if (top->count < top->k) {
+        // sift up from the end
+        int i = top->count++;
+        while (i > 0) {
+            int parent = (i - 1) / 2;
+            if (!suggestionRanksBefore(&entries[parent], &candidate)) {
+                break;
+            }
+            entries[i] = entries[parent];
+            i = parent;
+        }
+        entries[i] = candidate;
+        return 1;
+    }
+    if (!suggestionRanksBefore(&candidate, &entries[0])) {
+        return 0;
+    }
+    entries[0] = candidate;
+    siftDown(top, 0);
+    return 1;
+}
+
+/**
+ * Returns 1 once the table holds k words.
+ * @param top
+ * @return 1 if full, 0 otherwise.
+ */
+int topKFull(const TopK* top)
+{
+    return top->count == top->k;
+}
+
+/**
+ * Returns the entry that ranks last, the one the next better word would
+ * replace.
+ * @param top
+ * @return Last entry, or NULL while the table is not full.
+ */
+const Suggestion* topKLast(const TopK* top)
+{
+    return (top->count == top->k) ? &top->entries[0] : NULL;
+}
+
+/**
+ * Returns the largest distance a word could have and still get into the
+ * table. Once the table is full anything past the last entry's distance is
+ * useless; a word at exactly that distance can still get in on the frequency
+ * or alphabetical tie-break.
+ * @param top
+ * @param fallback Bound to use while the table is not full.
+ * @return Distance bound for the next candidate.
+ */
+int topKThreshold(const TopK* top, int fallback)
+{
+    return (top->count == top->k) ? top->entries[0].distance : fallback;
+}
+
+/**
+ * Like topKThreshold, for a candidate known to be no more common than the
+ * given frequency class. Once the table is full such a word can only tie the
+ * last entry's distance if it is at least as common as that entry, so a
+ * scan of words in falling frequency order can tighten its bound by one as
+ * soon as it passes that entry's class.
+ * @param top
+ * @param fallback Bound to use while the table is not full.
+ * @param frequency Highest frequency class the candidate can have.
+ * @return Distance bound for the next candidate.
+ */
+int topKFrequencyThreshold(const TopK* top, int fallback, int frequency)
+{
+    if (top->count < top->k) {
+        return fallback;
+    }
+    return top->entries[0].distance - (frequency < top->entries[0].frequency);
+}
+
+/**
+ * Offers every word of one table to another, as when combining the tables of
+ * searches over disjoint parts of a dictionary. If from is at least as large
+ * as into, into ends up exactly as if it had been offered everything from was.
+ * @param into
+ * @param from
+ */
+void topKMerge(TopK* into, const TopK* from)
+{
+    for (int i = 0; i < from->count; i++) {
+        topKOffer(into, from->entries[i].word, from->entries[i].distance, from->entries[i].frequency);
+    }
+}
+
+/**
+ * Copies the table's words into out, best first. The table is unchanged.
+ * @param top
+ * @param out Room for top->k suggestions.
+ * @return Number of suggestions written.
+ */
+int topKSorted(const TopK* top, Suggestion* out)
+{
+    // insertion sort; k is small
+    for (int i = 0; i < top->count; i++) {
+        Suggestion entry = top->entries[i];
+        int j = i;
+        while (j > 0 && suggestionRanksBefore(&entry, &out[j - 1])) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = entry;
+    }
+    return top->count;
+}
@@ -0,0 +1,45 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+/*
+ * The k closest words seen so far by a suggestion search.
+ *
+ * A fixed-capacity max-heap on suggestionRanksBefore: entries[0] is the
+ * entry that ranks last, so a candidate is checked against it once and,
+ * when it wins, replaces it in O(log k) instead of shifting the rest down.
+ * Ties on distance are broken by frequency and then alphabetically, so the
+ * set kept does not depend on the order candidates are offered in.
+ *
+ * Searches prune with topKThreshold: once k words are held, a candidate
+ * farther than the last one cannot get in, so every kernel can stop as soon
+ * as it proves a word is past it. The smaller k, the sooner that bound
+ * tightens. A TopK holds no pointers of its own and can be copied with
+ * memcpy; words point into whatever index offered them.
+ */
+
+#include "suggestion.h"
+
+// Most suggestions a TopK can hold.
+#define TOPK_MAX 20
+
+typedef struct TopK TopK;
+
+struct TopK
+{
+    // Capacity, 1 to TOPK_MAX, and entries held.
+    int k;
+    int count;
+    // Max-heap: no entry ranks after entries[0].
+    Suggestion entries[TOPK_MAX];
+};
+
+void topKInit(TopK* top, int k);
+int topKOffer(TopK* top, const char* word, int distance, int frequency);
+int topKFull(const TopK* top);
+const Suggestion* topKLast(const TopK* top);
+int topKThreshold(const TopK* top, int fallback);
+int topKFrequencyThreshold(const TopK* top, int fallback, int frequency);
+void topKMerge(TopK* into, const TopK* from);
+int topKSorted(const TopK* top, Suggestion* out);
+
+#endif